@@ -0,0 +1,96 @@
+/****************************************************************************
+**
+** Benchmarks for image conversion and scaling
+**
+** This file is part of the benchmark suite for Qt.  It may be used,
+** distributed and modified without limitation.
+**
+*****************************************************************************/
+
+#include "qbench.h"
+#include <qimage.h>
+
+
+/*
+  A 256x256 32-bit image with smooth gradients and some noise, always
+  the same.
+*/
+
+static QImage &testImage()
+{
+    static QImage *img = 0;
+    if ( !img ) {
+	img = new QImage( 256, 256, 32 );
+	uint j = 1;
+	for ( int y=0; y<256; y++ ) {
+	    QRgb *p = (QRgb *)img->scanLine( y );
+	    for ( int x=0; x<256; x++ ) {
+		j = j*1103515245 + 12345;
+		int n = (j >> 16) & 15;
+		p[x] = qRgb( x ^ n, y, (x+y)/2 );
+	    }
+	}
+    }
+    return *img;
+}
+
+QBENCH(image,convert_32_to_8_threshold)
+{
+    while ( iterations-- )
+	qbench_sink += testImage().convertDepth( 8, ThresholdDither |
+						 AvoidDither ).width();
+}
+
+QBENCH(image,convert_32_to_8_diffuse)
+{
+    while ( iterations-- )
+	qbench_sink += testImage().convertDepth( 8, DiffuseDither )
+	    .width();
+}
+
+QBENCH(image,convert_32_to_1)
+{
+    while ( iterations-- )
+	qbench_sink += testImage().convertDepth( 1 ).width();
+}
+
+QBENCH(image,convert_8_to_32)
+{
+    static QImage *img8 = 0;
+    if ( !img8 )
+	img8 = new QImage( testImage().convertDepth(8) );
+    while ( iterations-- )
+	qbench_sink += img8->convertDepth( 32 ).width();
+}
+
+QBENCH(image,scale_box_down)
+{
+    while ( iterations-- )
+	qbench_sink += testImage().smoothScale( 100, 75 ).width();
+}
+
+QBENCH(image,scale_box_up)
+{
+    while ( iterations-- )
+	qbench_sink += testImage().smoothScale( 640, 480 ).width();
+}
+
+QBENCH(image,scale_bilinear_up)
+{
+    while ( iterations-- )
+	qbench_sink += testImage().smoothScale( 640, 480,
+					QImage::BilinearFilter ).width();
+}
+
+QBENCH(image,scale_lanczos_down)
+{
+    while ( iterations-- )
+	qbench_sink += testImage().smoothScale( 100, 75,
+					QImage::LanczosFilter ).width();
+}
+
+QBENCH(image,heuristic_mask)
+{
+    while ( iterations-- )
+	qbench_sink += testImage().createHeuristicMask().width();
+}
@@ -0,0 +1,105 @@
+/****************************************************************************
+**
+** Benchmarks for QPainter on X11
+**
+** This file is part of the benchmark suite for Qt.  It may be used,
+** distributed and modified without limitation.
+**
+*****************************************************************************/
+
+#include "qbench.h"
+#include <qpainter.h>
+#include <qpixmap.h>
+#include <qimage.h>
+#include <qwidget.h>
+#include <qpointarray.h>
+
+
+QBENCH_X11(painter,draw_line)
+{
+    QPainter p( qbench_widget );
+    int i = 0;
+    while ( iterations-- ) {
+	p.drawLine( i, 0, 511 - i, 511 );
+	i = (i + 1) & 511;
+    }
+}
+
+QBENCH_X11(painter,draw_line_pen_change)
+{
+    QPainter p( qbench_widget );
+    int i = 0;
+    while ( iterations-- ) {
+	p.setPen( (i & 1) ? red : blue );
+	p.drawLine( i, 0, 511 - i, 511 );
+	i = (i + 1) & 511;
+    }
+}
+
+QBENCH_X11(painter,fill_rect)
+{
+    QPainter p( qbench_widget );
+    int i = 0;
+    while ( iterations-- ) {
+	p.fillRect( i & 255, (i*3) & 255, 64, 64,
+		    (i & 1) ? green : yellow );
+	i++;
+    }
+}
+
+QBENCH_X11(painter,draw_text)
+{
+    QPainter p( qbench_widget );
+    int i = 0;
+    while ( iterations-- ) {
+	p.drawText( 10, 20 + (i & 255), "The quick brown fox jumps" );
+	i++;
+    }
+}
+
+QBENCH_X11(painter,draw_polygon)
+{
+    QPointArray a( 5 );
+    a.setPoints( 5, 10,10, 200,30, 150,200, 60,220, 20,120 );
+    QPainter p( qbench_widget );
+    p.setBrush( blue );
+    while ( iterations-- )
+	p.drawPolygon( a );
+}
+
+QBENCH_X11(painter,draw_pixmap)
+{
+    static QPixmap *pm = 0;
+    if ( !pm ) {
+	pm = new QPixmap( 64, 64 );
+	pm->fill( red );
+    }
+    QPainter p( qbench_widget );
+    int i = 0;
+    while ( iterations-- ) {
+	p.drawPixmap( i & 255, (i*5) & 255, *pm );
+	i++;
+    }
+}
+
+QBENCH_X11(painter,pixmap_from_image)
+{
+    QImage img( 128, 128, 32 );
+    img.fill( qRgb(10, 200, 30) );
+    while ( iterations-- ) {
+	QPixmap pm;
+	pm.convertFromImage( img );
+	qbench_sink += pm.width();
+    }
+}
+
+QBENCH_X11(painter,clipped_fill)
+{
+    QRegion rgn;
+    for ( int i=0; i<16; i++ )
+	rgn = rgn.unite( QRegion(i*32, i*32, 48, 48) );
+    QPainter p( qbench_widget );
+    p.setClipRegion( rgn );
+    while ( iterations-- )
+	p.fillRect( 0, 0, 512, 512, gray );
+}
@@ -0,0 +1,112 @@
+/****************************************************************************
+**
+** Benchmarks for region operations
+**
+** This file is part of the benchmark suite for Qt.  It may be used,
+** distributed and modified without limitation.
+**
+*****************************************************************************/
+
+#include "qbench.h"
+#include <qregion.h>
+#include <qpointarray.h>
+
+
+/*
+  200 overlapping rectangles at pseudo-random places, like the update
+  region of a busy window.
+*/
+
+static QRect *testRects()
+{
+    static QRect rects[200];
+    static bool init = FALSE;
+    if ( !init ) {
+	uint j = 3;
+	for ( int i=0; i<200; i++ ) {
+	    j = j*1103515245 + 12345;
+	    int x = (j >> 8) % 600;
+	    j = j*1103515245 + 12345;
+	    int y = (j >> 8) % 400;
+	    rects[i].setRect( x, y, 10 + i%50, 10 + (i*7)%40 );
+	}
+	init = TRUE;
+    }
+    return rects;
+}
+
+QBENCH(region,unite_200_rects)
+{
+    QRect *r = testRects();
+    while ( iterations-- ) {
+	QRegion rgn;
+	for ( int i=0; i<200; i++ )
+	    rgn = rgn.unite( QRegion(r[i]) );
+	qbench_sink += rgn.isEmpty();
+    }
+}
+
+QBENCH(region,unite_rects_200)
+{
+    QRect *r = testRects();
+    while ( iterations-- ) {
+	QRegion rgn;
+	rgn.uniteRects( r, 200 );
+	qbench_sink += rgn.isEmpty();
+    }
+}
+
+static QRegion &bigRegion( int which )
+{
+    static QRegion *rgn[2] = { 0, 0 };
+    if ( !rgn[0] ) {
+	QRect *r = testRects();
+	rgn[0] = new QRegion;
+	rgn[1] = new QRegion;
+	rgn[0]->uniteRects( r, 100 );
+	rgn[1]->uniteRects( r+100, 100 );
+    }
+    return *rgn[which];
+}
+
+QBENCH(region,intersect)
+{
+    while ( iterations-- )
+	qbench_sink += bigRegion(0).intersect( bigRegion(1) ).isEmpty();
+}
+
+QBENCH(region,subtract)
+{
+    while ( iterations-- )
+	qbench_sink += bigRegion(0).subtract( bigRegion(1) ).isEmpty();
+}
+
+QBENCH(region,eor)
+{
+    while ( iterations-- )
+	qbench_sink += bigRegion(0).eor( bigRegion(1) ).isEmpty();
+}
+
+QBENCH(region,contains_point)
+{
+    int x = 0;
+    while ( iterations-- ) {
+	qbench_sink += bigRegion(0).contains( QPoint(x, x/2) );
+	x = (x + 7) % 600;
+    }
+}
+
+QBENCH(region,translate)
+{
+    QRegion rgn = bigRegion( 0 );
+    while ( iterations-- )
+	rgn.translate( 1, -1 );
+    qbench_sink += rgn.isEmpty();
+}
+
+QBENCH(region,ellipse)
+{
+    while ( iterations-- )
+	qbench_sink += QRegion( QRect(0,0,300,200), QRegion::Ellipse )
+	    .isEmpty();
+}
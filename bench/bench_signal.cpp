@@ -0,0 +1,48 @@
+/****************************************************************************
+**
+** Benchmarks for signal emission
+**
+** This file is part of the benchmark suite for Qt.  It may be used,
+** distributed and modified without limitation.
+**
+*****************************************************************************/
+
+#include "qbench.h"
+#include "bench_signal.h"
+
+
+QBENCH(signal,emit_unconnected)
+{
+    BenchObject o;
+    while ( iterations-- )
+	o.fireUnconnected( 1 );
+    qbench_sink += o.received;
+}
+
+QBENCH(signal,emit_one_receiver)
+{
+    BenchObject o, r;
+    QObject::connect( &o, SIGNAL(fired(int)), &r, SLOT(receive(int)) );
+    while ( iterations-- )
+	o.fire( 1 );
+    qbench_sink += r.received;
+}
+
+QBENCH(signal,emit_ten_receivers)
+{
+    BenchObject o, r[10];
+    for ( int i=0; i<10; i++ )
+	QObject::connect( &o, SIGNAL(fired(int)), &r[i], SLOT(receive(int)) );
+    while ( iterations-- )
+	o.fire( 1 );
+    qbench_sink += r[0].received;
+}
+
+QBENCH(signal,connect_disconnect)
+{
+    BenchObject o, r;
+    while ( iterations-- ) {
+	QObject::connect( &o, SIGNAL(fired(int)), &r, SLOT(receive(int)) );
+	QObject::disconnect( &o, SIGNAL(fired(int)), &r, SLOT(receive(int)) );
+    }
+}
@@ -0,0 +1,35 @@
+/****************************************************************************
+**
+** Objects for the signal benchmarks
+**
+** This file is part of the benchmark suite for Qt.  It may be used,
+** distributed and modified without limitation.
+**
+*****************************************************************************/
+
+#ifndef BENCH_SIGNAL_H
+#define BENCH_SIGNAL_H
+
+#include <qobject.h>
+
+
+class BenchObject : public QObject
+{
+    Q_OBJECT
+public:
+    BenchObject() : received(0) {}
+
+    void fire( int n )		{ emit fired( n ); }
+    void fireUnconnected( int n ) { emit unconnected( n ); }
+    int	 received;
+
+signals:
+    void fired( int );
+    void unconnected( int );
+
+public slots:
+    void receive( int n )	{ received += n; }
+};
+
+
+#endif // BENCH_SIGNAL_H
@@ -0,0 +1,209 @@
+/****************************************************************************
+**
+** Benchmarks for the collection and string classes
+**
+** This file is part of the benchmark suite for Qt.  It may be used,
+** distributed and modified without limitation.
+**
+*****************************************************************************/
+
+#include "qbench.h"
+#include <qlist.h>
+#include <qdict.h>
+#include <qintdict.h>
+#include <qstring.h>
+#include <qstrlist.h>
+#include <qregexp.h>
+#include <stdio.h>
+
+
+/*****************************************************************************
+  QList (QGList)
+ *****************************************************************************/
+
+typedef Q_DECLARE(QListM,int) IntList;
+typedef Q_DECLARE(QListIteratorM,int) IntListIt;
+
+static int bench_ints[1000];
+
+QBENCH(tools,list_append_1000)
+{
+    while ( iterations-- ) {
+	IntList l;
+	for ( int i=0; i<1000; i++ )
+	    l.append( &bench_ints[i] );
+	qbench_sink += l.count();
+    }
+}
+
+QBENCH(tools,list_iterate_1000)
+{
+    static IntList *l = 0;
+    if ( !l ) {
+	l = new IntList;
+	for ( int i=0; i<1000; i++ )
+	    l->append( &bench_ints[i] );
+    }
+    while ( iterations-- ) {
+	IntListIt it( *l );
+	int *p;
+	while ( (p = it.current()) ) {
+	    qbench_sink += *p;
+	    ++it;
+	}
+    }
+}
+
+QBENCH(tools,list_at_random)
+{
+    static IntList *l = 0;
+    if ( !l ) {
+	l = new IntList;
+	for ( int i=0; i<1000; i++ )
+	    l->append( &bench_ints[i] );
+    }
+    uint j = 1;
+    while ( iterations-- ) {
+	j = j*1103515245 + 12345;
+	qbench_sink += *l->at( (j >> 8) % 1000 );
+    }
+}
+
+QBENCH(tools,strlist_insort_500)
+{
+    static char keys[500][8];
+    static bool init = FALSE;
+    if ( !init ) {
+	uint j = 7;
+	for ( int i=0; i<500; i++ ) {
+	    j = j*1103515245 + 12345;
+	    sprintf( keys[i], "k%06u", (j >> 8) % 1000000 );
+	}
+	init = TRUE;
+    }
+    while ( iterations-- ) {
+	QStrList l( FALSE );
+	for ( int i=0; i<500; i++ )
+	    l.inSort( keys[i] );
+	qbench_sink += l.count();
+    }
+}
+
+
+/*****************************************************************************
+  QDict and QIntDict (QGDict)
+ *****************************************************************************/
+
+typedef Q_DECLARE(QDictM,int) IntDict;
+typedef Q_DECLARE(QIntDictM,int) IntIntDict;
+
+static char dict_keys[1000][12];
+
+static void init_dict_keys()
+{
+    static bool init = FALSE;
+    if ( init )
+	return;
+    for ( int i=0; i<1000; i++ )
+	sprintf( dict_keys[i], "key%d", i*7919 );
+    init = TRUE;
+}
+
+QBENCH(tools,dict_insert_1000)
+{
+    init_dict_keys();
+    while ( iterations-- ) {
+	IntDict d;
+	for ( int i=0; i<1000; i++ )
+	    d.insert( dict_keys[i], &bench_ints[i] );
+	qbench_sink += d.count();
+    }
+}
+
+QBENCH(tools,dict_find)
+{
+    static IntDict *d = 0;
+    init_dict_keys();
+    if ( !d ) {
+	d = new IntDict( 1009 );
+	for ( int i=0; i<1000; i++ )
+	    d->insert( dict_keys[i], &bench_ints[i] );
+    }
+    int i = 0;
+    while ( iterations-- ) {
+	qbench_sink += d->find( dict_keys[i] ) != 0;
+	if ( ++i == 1000 )
+	    i = 0;
+    }
+}
+
+QBENCH(tools,intdict_insert_find_1000)
+{
+    while ( iterations-- ) {
+	IntIntDict d;
+	int i;
+	for ( i=0; i<1000; i++ )
+	    d.insert( i*31, &bench_ints[i] );
+	for ( i=0; i<1000; i++ )
+	    qbench_sink += d.find( i*31 ) != 0;
+    }
+}
+
+
+/*****************************************************************************
+  QString
+ *****************************************************************************/
+
+QBENCH(tools,string_append_1000)
+{
+    while ( iterations-- ) {
+	QString s;
+	for ( int i=0; i<1000; i++ )
+	    s += "abcdefgh";
+	qbench_sink += s.length();
+    }
+}
+
+QBENCH(tools,string_setnum)
+{
+    QString s;
+    int i = 0;
+    while ( iterations-- ) {
+	s.setNum( i++ );
+	qbench_sink += s.length();
+    }
+}
+
+QBENCH(tools,string_find_4k)
+{
+    static QString *s = 0;
+    if ( !s ) {
+	s = new QString;
+	for ( int i=0; i<512; i++ )
+	    *s += "abcdefg ";
+	*s += "needle";
+    }
+    while ( iterations-- )
+	qbench_sink += s->find( "needle" );
+}
+
+QBENCH(tools,string_simplify)
+{
+    QString s( "   Qt is\t a  multi-platform   C++\n GUI  toolkit   " );
+    while ( iterations-- )
+	qbench_sink += s.simplifyWhiteSpace().length();
+}
+
+QBENCH(tools,regexp_match_4k)
+{
+    static QString *s = 0;
+    if ( !s ) {
+	s = new QString;
+	for ( int i=0; i<512; i++ )
+	    *s += "abcdefg ";
+	*s += "foo123bar";
+    }
+    QRegExp r( "[0-9]+bar" );
+    while ( iterations-- )
+	qbench_sink += r.match( *s );
+}
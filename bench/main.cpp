@@ -0,0 +1,327 @@
+/****************************************************************************
+**
+** qt1-bench, micro and macro benchmarks for Qt
+**
+** This file is part of the benchmark suite for Qt.  It may be used,
+** distributed and modified without limitation.
+**
+*****************************************************************************/
+
+#include "qbench.h"
+#include <qapplication.h>
+#include <qwidget.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <X11/Xlib.h>
+
+
+QBenchmark *QBenchmark::first = 0;
+volatile int qbench_sink = 0;
+QWidget *qbench_widget = 0;
+
+/*
+  Benchmarks are kept sorted on group and name, so the order does not
+  depend on the link order.
+*/
+
+QBenchmark::QBenchmark( const char *g, const char *n, QBenchFunc f,
+			bool display )
+    : group(g), name(n), func(f), needsDisplay(display)
+{
+    QBenchmark **p = &first;
+    while ( *p ) {
+	int c = strcmp( (*p)->group, g );
+	if ( c > 0 || (c == 0 && strcmp((*p)->name, n) > 0) )
+	    break;
+	p = &(*p)->next;
+    }
+    next = *p;
+    *p = this;
+}
+
+
+static double now()				// in nanoseconds
+{
+    struct timeval tv;
+    gettimeofday( &tv, 0 );
+    return tv.tv_sec*1e9 + tv.tv_usec*1e3;
+}
+
+/*
+  Runs \a b for \a iterations and returns the time it took in ns.
+  Painter benchmarks wait for the X server to finish too.
+*/
+
+static double timeRun( QBenchmark *b, int iterations )
+{
+    double t = now();
+    b->func( iterations );
+    if ( b->needsDisplay )
+	QApplication::syncX();
+    return now() - t;
+}
+
+static int cmpDouble( const void *a, const void *b )
+{
+    double d = *(const double *)a - *(const double *)b;
+    return d < 0 ? -1 : (d > 0 ? 1 : 0);
+}
+
+struct Result {
+    const char *group;
+    const char *name;
+    int		iterations;
+    double	median;				// ns per iteration
+    double	min;
+};
+
+/*
+  Finds the number of iterations that takes at least \a minTime ns and
+  takes \a samples samples of that.
+*/
+
+static void measure( QBenchmark *b, int samples, double minTime, Result *r )
+{
+    int n = 1;
+    b->func( 1 );				// warm up caches and lazy init
+    for ( ;; ) {
+	double t = timeRun( b, n );
+	if ( t >= minTime || n >= (1<<30) )
+	    break;
+	if ( t < minTime/100 )
+	    n *= 10;
+	else
+	    n *= 2;
+    }
+    double *times = new double[samples];
+    for ( int i=0; i<samples; i++ )
+	times[i] = timeRun( b, n ) / n;
+    qsort( times, samples, sizeof(double), cmpDouble );
+    r->group = b->group;
+    r->name = b->name;
+    r->iterations = n;
+    r->median = times[samples/2];
+    r->min = times[0];
+    delete [] times;
+}
+
+
+/*
+  A baseline is the JSON written by an earlier run.  Each result is on a
+  line of its own, so it is enough to pick the fields out of each line.
+*/
+
+struct Baseline {
+    char    name[128];
+    double  median;
+};
+
+static bool jsonString( const char *line, const char *key, char *buf, int len )
+{
+    char pat[64];
+    sprintf( pat, "\"%s\": \"", key );
+    const char *p = strstr( line, pat );
+    if ( !p )
+	return FALSE;
+    p += strlen( pat );
+    int i = 0;
+    while ( *p && *p != '"' && i < len-1 )
+	buf[i++] = *p++;
+    buf[i] = '\0';
+    return TRUE;
+}
+
+static bool jsonNumber( const char *line, const char *key, double *d )
+{
+    char pat[64];
+    sprintf( pat, "\"%s\": ", key );
+    const char *p = strstr( line, pat );
+    if ( !p )
+	return FALSE;
+    *d = atof( p + strlen(pat) );
+    return TRUE;
+}
+
+static Baseline *readBaseline( const char *file, int *count )
+{
+    FILE *f = fopen( file, "r" );
+    *count = 0;
+    if ( !f ) {
+	fprintf( stderr, "qt1-bench: Cannot read baseline %s\n", file );
+	return 0;
+    }
+    int size = 64;
+    Baseline *b = (Baseline *)malloc( size*sizeof(Baseline) );
+    char line[512];
+    while ( fgets(line, sizeof(line), f) ) {
+	char group[64], name[64];
+	double median;
+	if ( !jsonString(line, "group", group, sizeof(group)) ||
+	     !jsonString(line, "name", name, sizeof(name)) ||
+	     !jsonNumber(line, "median_ns", &median) )
+	    continue;
+	if ( *count == size ) {
+	    size *= 2;
+	    b = (Baseline *)realloc( b, size*sizeof(Baseline) );
+	}
+	sprintf( b[*count].name, "%s.%s", group, name );
+	b[*count].median = median;
+	(*count)++;
+    }
+    fclose( f );
+    return b;
+}
+
+
+static void usage()
+{
+    fprintf( stderr,
+	"Usage: qt1-bench [options] [filter]\n"
+	"  --list             list the benchmarks and exit\n"
+	"  --samples n        samples per benchmark (default 7)\n"
+	"  --min-time ms      minimum time per sample (default 20)\n"
+	"  --json file        write the results as JSON to file\n"
+	"  --baseline file    compare with the JSON of an earlier run\n"
+	"  --threshold pct    slowdown reported as a regression (default 10)\n"
+	"Only benchmarks whose group.name contains filter are run.  The\n"
+	"painter benchmarks need an X display and are skipped without one.\n" );
+}
+
+int main( int argc, char **argv )
+{
+    const char *filter = 0;
+    const char *jsonFile = 0;
+    const char *baselineFile = 0;
+    int samples = 7;
+    double minTime = 20;
+    double threshold = 10;
+    bool list = FALSE;
+    int i;
+    for ( i=1; i<argc; i++ ) {
+	const char *a = argv[i];
+	bool more = i+1 < argc;
+	if ( strcmp(a, "--list") == 0 ) {
+	    list = TRUE;
+	} else if ( strcmp(a, "--samples") == 0 && more ) {
+	    samples = atoi( argv[++i] );
+	    if ( samples < 1 )
+		samples = 1;
+	} else if ( strcmp(a, "--min-time") == 0 && more ) {
+	    minTime = atof( argv[++i] );
+	} else if ( strcmp(a, "--json") == 0 && more ) {
+	    jsonFile = argv[++i];
+	} else if ( strcmp(a, "--baseline") == 0 && more ) {
+	    baselineFile = argv[++i];
+	} else if ( strcmp(a, "--threshold") == 0 && more ) {
+	    threshold = atof( argv[++i] );
+	} else if ( a[0] != '-' && !filter ) {
+	    filter = a;
+	} else {
+	    usage();
+	    return 2;
+	}
+    }
+
+    QBenchmark *b;
+    char full[160];
+    int n = 0;
+    bool display = FALSE;
+    for ( b=QBenchmark::first; b; b=b->next ) {
+	sprintf( full, "%s.%s", b->group, b->name );
+	if ( filter && !strstr(full, filter) )
+	    continue;
+	if ( list )
+	    printf( "%s\n", full );
+	display |= b->needsDisplay;
+	n++;
+    }
+    if ( list )
+	return 0;
+
+    QApplication *app = 0;
+    if ( display ) {				// only if there is a server
+	Display *dpy = XOpenDisplay( 0 );
+	if ( dpy ) {
+	    XCloseDisplay( dpy );
+	    app = new QApplication( argc, argv );
+	    qbench_widget = new QWidget;
+	    qbench_widget->setGeometry( 0, 0, 512, 512 );
+	    qbench_widget->show();
+	    QApplication::syncX();
+	}
+    }
+
+    Result *results = new Result[n];
+    int nresults = 0;
+    for ( b=QBenchmark::first; b; b=b->next ) {
+	sprintf( full, "%s.%s", b->group, b->name );
+	if ( filter && !strstr(full, filter) )
+	    continue;
+	if ( b->needsDisplay && !app ) {
+	    printf( "%-36s skipped, no display\n", full );
+	    continue;
+	}
+	Result *r = &results[nresults++];
+	measure( b, samples, minTime*1e6, r );
+	printf( "%-36s %12.1f ns %12.1f ns min %10d iterations\n",
+		full, r->median, r->min, r->iterations );
+	fflush( stdout );
+    }
+
+    if ( jsonFile ) {
+	FILE *f = fopen( jsonFile, "w" );
+	if ( !f ) {
+	    fprintf( stderr, "qt1-bench: Cannot write %s\n", jsonFile );
+	} else {
+	    fprintf( f, "{\n  \"samples\": %d,\n  \"benchmarks\": [\n",
+		     samples );
+	    for ( i=0; i<nresults; i++ ) {
+		Result *r = &results[i];
+		fprintf( f, "    { \"group\": \"%s\", \"name\": \"%s\", "
+			 "\"iterations\": %d, \"median_ns\": %.3f, "
+			 "\"min_ns\": %.3f }%s\n",
+			 r->group, r->name, r->iterations, r->median, r->min,
+			 i < nresults-1 ? "," : "" );
+	    }
+	    fprintf( f, "  ]\n}\n" );
+	    fclose( f );
+	}
+    }
+
+    int regressions = 0;
+    if ( baselineFile ) {
+	int nbase;
+	Baseline *base = readBaseline( baselineFile, &nbase );
+	printf( "\nCompared with %s:\n", baselineFile );
+	for ( i=0; i<nresults; i++ ) {
+	    Result *r = &results[i];
+	    sprintf( full, "%s.%s", r->group, r->name );
+	    int j = 0;
+	    while ( j < nbase && strcmp(base[j].name, full) != 0 )
+		j++;
+	    if ( j == nbase || base[j].median <= 0 ) {
+		printf( "%-36s new\n", full );
+		continue;
+	    }
+	    double change = (r->median - base[j].median)*100/base[j].median;
+	    const char *verdict = "";
+	    if ( change > threshold ) {
+		verdict = "  REGRESSION";
+		regressions++;
+	    } else if ( change < -threshold ) {
+		verdict = "  improvement";
+	    }
+	    printf( "%-36s %+8.1f%%%s\n", full, change, verdict );
+	}
+	free( base );
+    }
+
+    delete [] results;
+    if ( app ) {
+	delete qbench_widget;
+	delete app;
+    }
+    return regressions ? 1 : 0;
+}
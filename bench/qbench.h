@@ -0,0 +1,63 @@
+/****************************************************************************
+**
+** Definition of the benchmark registry used by qt1-bench
+**
+** This file is part of the benchmark suite for Qt.  It may be used,
+** distributed and modified without limitation.
+**
+*****************************************************************************/
+
+#ifndef QBENCH_H
+#define QBENCH_H
+
+#include <qglobal.h>
+
+
+typedef void (*QBenchFunc)( int iterations );
+
+class QBenchmark					// a registered benchmark
+{
+public:
+    QBenchmark( const char *group, const char *name, QBenchFunc func,
+		bool needsDisplay=FALSE );
+
+    const char *group;
+    const char *name;
+    QBenchFunc	func;
+    bool	needsDisplay;
+    QBenchmark *next;
+
+    static QBenchmark *first;
+};
+
+/*
+  Results are stored here so that the compiler cannot throw the
+  benchmarked code away.
+*/
+
+extern volatile int qbench_sink;
+
+/*
+  Defines a benchmark.  The body runs the benchmarked operation
+  \a iterations times; the setup it needs should be done in static data
+  or before the loop, the time for it is not subtracted.
+*/
+
+#define QBENCH(group,name) \
+    static void bench_##group##_##name( int ); \
+    static QBenchmark bench_reg_##group##_##name( #group, #name, \
+						   bench_##group##_##name ); \
+    static void bench_##group##_##name( int iterations )
+
+#define QBENCH_X11(group,name) \
+    static void bench_##group##_##name( int ); \
+    static QBenchmark bench_reg_##group##_##name( #group, #name, \
+						   bench_##group##_##name, \
+						   TRUE ); \
+    static void bench_##group##_##name( int iterations )
+
+class QWidget;
+extern QWidget *qbench_widget;			// target for painter benchmarks
+
+
+#endif // QBENCH_H
@@ -29,36 +29,33 @@ Directory::Directory( QListView * parent )
 }
 
 
-void Directory::setOpen( bool o )
+void Directory::populate()
 {
-    if ( o && !childCount() ) {
-	QString s( fullName() );
-	QDir thisDir( s );
-	if ( !thisDir.isReadable() ) {
-	    readable = FALSE;
-	    return;
-	}
+    QString s( fullName() );
+    QDir thisDir( s );
+    if ( !thisDir.isReadable() ) {
+	readable = FALSE;
+	return;
+    }
 
-	const QFileInfoList * files = thisDir.entryInfoList();
-	if ( files ) {
-	    QFileInfoListIterator it( *files );
-	    QFileInfo * f;
-	    while( (f=it.current()) != 0 ) {
-		++it;
-		if ( f->fileName() == "." || f->fileName() == ".." )
-		    ; // nothing
-		else if ( f->isSymLink() )
-		    new QListViewItem( this, (const char *)f->fileName(),
-				       "Symbolic Link", 0 );
-		else if ( f->isDir() )
-		    new Directory( this, f->fileName() );
-		else
-		    new QListViewItem( this, (const char *)f->fileName(),
-				       f->isFile() ? "File" : "Special", 0 );
-	    }
+    const QFileInfoList * files = thisDir.entryInfoList();
+    if ( files ) {
+	QFileInfoListIterator it( *files );
+	QFileInfo * f;
+	while( (f=it.current()) != 0 ) {
+	    ++it;
+	    if ( f->fileName() == "." || f->fileName() == ".." )
+		; // nothing
+	    else if ( f->isSymLink() )
+		new QListViewItem( this, (const char *)f->fileName(),
+				   "Symbolic Link", 0 );
+	    else if ( f->isDir() )
+		new Directory( this, f->fileName() );
+	    else
+		new QListViewItem( this, (const char *)f->fileName(),
+				   f->isFile() ? "File" : "Special", 0 );
 	}
     }
-    QListViewItem::setOpen( o );
 }
 
 
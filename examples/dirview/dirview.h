@@ -25,9 +25,11 @@ public:
 
     QString fullName();
 
-    void setOpen( bool );
     void setup();
 
+protected:
+    void populate();
+
 private:
     QFile f;
     Directory * p;
@@ -254,6 +254,7 @@ static void np_do_timers( void*, void* )
     qt_np_timerid = 0; // It's us, and we just expired, that's why we are here.
 
     qt_activate_timers();
+    qt_x11SendPostedEvents();			// paint what the timers updated
 
     timeval *tm = qt_wait_timer();
 
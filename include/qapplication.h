@@ -121,6 +121,9 @@ public:
     static void	    setDoubleClickInterval( int );
     static int      doubleClickInterval();
 
+    static void	    setTimerTolerance( int );
+    static int      timerTolerance();
+
 #if defined(_WS_WIN_)
     static WindowsVersion winVersion();
 #endif
@@ -31,6 +31,7 @@
 
 class QDir;
 struct QFileInfoCache;
+struct QFileInfoDirCache;
 
 
 class Q_EXPORT QFileInfo				   // file information class
@@ -93,11 +94,22 @@ public:
     QDateTime	lastModified()	const;
     QDateTime	lastRead()	const;
 
+    static void setGlobalCaching( bool );
+    static bool globalCaching();
+    static void clearGlobalCache();
+
 private:
     void	doStat() const;
+    void	setTypeHint( bool isDir );
+    bool	fromDirCache( QFileInfoDirCache *, const char *fileName );
+    void	toDirCache( QFileInfoDirCache *, const char *fileName ) const;
+    static QFileInfoDirCache *dirCache( const char *dirPath );
+    static void statAll( QFileInfo **, int );
     QString	fn;
     QFileInfoCache *fic;
     bool	cache;
+
+    friend class QDir;
 };
 
 
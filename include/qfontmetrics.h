@@ -83,6 +83,7 @@ private:
 #elif defined(_WS_X11_)
     void *fontStruct() const;
     int printerAdjusted(int) const;
+    QFontInternal *fontInternal() const;
 #endif
 
     enum Type { FontInternal, Widget, Painter };
@@ -104,6 +105,10 @@ private:
 
     friend class QWidget;
     friend class QPainter;
+    friend void qt_format_text( const QFontMetrics& fm, int x, int y, int w, int h,
+		     int tf, const char *str, int len, QRect *brect,
+		     int tabstops, int* tabarray, int tabarraylen,
+		     char **internal, QPainter* painter );
 };
 
 
@@ -75,6 +75,9 @@ private:
     QGDItList  *iterators;
     QBucket    *unlink( const char *, GCI item = 0 );
     void        init( uint );
+    uint	hashOf( const char * );
+    bool	match( QBucket *, const char *, uint ) const;
+    void	rehash( uint );
 };
 
 
@@ -49,6 +49,7 @@
 #define IO_Append		0x0004		// append
 #define IO_Truncate		0x0008		// truncate device
 #define IO_Translate		0x0010		// translate CR+LF
+#define IO_Mapped		0x0020		// map file into memory
 #define IO_ModeMask		0x00ff
 
 // IO device state
@@ -113,6 +114,8 @@ public:
     virtual int	 readBlock( char *data, uint len ) = 0;
     virtual int	 writeBlock( const char *data, uint len ) = 0;
     virtual int	 readLine( char *data, uint maxlen );
+    virtual const char *peekBlock( uint *len );
+    virtual void skipBlock( uint len );
 
     virtual int	 getch() = 0;
     virtual int	 putch( int ) = 0;
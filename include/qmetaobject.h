@@ -58,6 +58,9 @@ public:
     QMetaData	*slot( int index, bool=FALSE )	    const;
     QMetaData	*signal( int index, bool=FALSE )    const;
 
+    int		 signalOffset()			    const;
+    int		 signalIndex( const char *, bool=FALSE ) const;
+
 private:
     QMemberDict *init( QMetaData *, int );
     QMetaData	*mdata( int code, const char *, bool ) const;
@@ -70,6 +73,7 @@ private:
     QMemberDict *slotDict;			// slot dictionary
     QMetaData	*signalData;			// signal meta data
     QMemberDict *signalDict;			// signal dictionary
+    int		 signaloffset;			// number of inherited signals
 
 private:	// Disabled copy constructor and operator=
 #if defined(Q_DISABLE_COPY)
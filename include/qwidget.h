@@ -189,6 +189,8 @@ public:
   // Update/refresh functions
 
     bool	 isUpdatesEnabled() const;
+    bool	 isPaintBuffered() const;
+    void	 setPaintBuffered( bool );
 public slots:
     void	 setUpdatesEnabled( bool enable );
     void	 update();
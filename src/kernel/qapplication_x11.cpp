@@ -35,7 +35,7 @@
 #include "qobjectdict.h"
 #include "qwidgetlist.h"
 #include "qwidgetintdict.h"
-#include "qbitarray.h"
+#include "qptrdict.h"
 #include "qpainter.h"
 #include "qpixmapcache.h"
 #include "qdatetime.h"
@@ -79,6 +79,24 @@ typedef char *XPointer;
 #include <sys/select.h>
 #endif
 
+#if defined(_OS_WIN32_)
+#define QT_NO_POLL				// use select()
+#endif
+
+#if defined(_OS_LINUX_) && !defined(QT_NO_POLL) && !defined(QT_NO_EPOLL)
+#define QT_EPOLL
+#endif
+
+#if !defined(QT_NO_POLL)
+#include <poll.h>
+#endif
+
+#if defined(QT_EPOLL)
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
 #if defined(_CC_MSVC_)
 #pragma warning(disable: 4018)
 #undef open
@@ -136,9 +154,6 @@ static bool	app_save_rootinfo = FALSE;	// save root info
 static bool	app_do_modal	= FALSE;	// modal mode
 static bool	app_exit_loop	= FALSE;	// flag to exit local loop
 static int	app_Xfd;			// X network socket
-static fd_set	app_readfds;			// fd set for reading
-static fd_set	app_writefds;			// fd set for writing
-static fd_set	app_exceptfds;			// fd set for exceptions
 
 static GC	app_gc_ro	= 0;		// read-only GC
 static GC	app_gc_tmp	= 0;		// temporary GC
@@ -175,6 +190,8 @@ typedef Q_DECLARE(QListM,void) QVFuncList;
 static QVFuncList *postRList = 0;		// list of post routines
 
 static void	cleanupPostedEvents();
+static void	sendDeferredPaints();
+static void	cleanupDeferredPaints();
 
 static void	initTimers();
 static void	cleanupTimers();
@@ -240,6 +257,7 @@ public:
     bool translateConfigEvent( const XEvent *);
     bool translateCloseEvent( const XEvent * );
     bool translateScrollDoneEvent( const XEvent * );
+    void sendDeferredPaint( QRegion & );
 };
 
 
@@ -685,6 +703,7 @@ void qt_init( Display *display )
 void qt_cleanup()
 {
     cleanupPostedEvents();			// remove list of posted events
+    cleanupDeferredPaints();			// remove dirty regions
     if ( postRList ) {
 	VFPTR f = (VFPTR)postRList->first();
 	while ( f ) {				// call post routines
@@ -1322,18 +1341,161 @@ public:
     void clearPostedFlag()	{ posted = FALSE; }
 };
 
+/*
+  Posted events are kept in a doubly linked queue in posting order.
+  Each event is also linked into a chain of the events for the same
+  receiver, so that finding or removing the events of one receiver
+  does not involve the whole queue.
+
+  Events of the types in compressibleEvents are idempotent: posting
+  one while the receiver still has one pending deletes the new event.
+*/
+
+static const int compressibleEvents[] = { Event_LayoutHint, 0 };
+const int numCompressibleEvents = 1;
+
 struct QPostEvent {
     QPostEvent( QObject *r, QEvent *e ) { receiver=r; event=e; }
    ~QPostEvent()			{ delete event; }
     QObject  *receiver;
     QEvent   *event;
+    QPostEvent *prev, *next;			// queue links
+    QPostEvent *rprev, *rnext;			// receiver chain links
+};
+
+struct QPostEventChain {			// posted events for one receiver
+    QPostEventChain() {
+	first = last = 0;
+	for ( int i=0; i<numCompressibleEvents; i++ )
+	    pending[i] = 0;
+    }
+    QPostEvent *first, *last;
+    QPostEvent *pending[numCompressibleEvents];
+};
+
+static int compressibleIndex( int type )
+{
+    for ( int i=0; compressibleEvents[i]; i++ ) {
+	if ( compressibleEvents[i] == type )
+	    return i;
+    }
+    return -1;
+}
+
+typedef Q_DECLARE(QPtrDictM,QPostEventChain) QPostEventChainDict;
+
+class QPostEventQueue
+{
+public:
+    QPostEventQueue();
+   ~QPostEventQueue();
+    uint	count() const	{ return n; }
+    QPostEvent *first() const	{ return head; }
+    QPostEventChain *chain( QObject *r ) { return receivers.find( r ); }
+    bool	append( QObject *, QEvent * );
+    void	take( QPostEvent * );
+private:
+    QPostEvent *head, *tail;
+    uint	n;
+    QPostEventChainDict receivers;
 };
 
-Q_DECLARE(QListM,QPostEvent);
-Q_DECLARE(QListIteratorM,QPostEvent);
-typedef QListM(QPostEvent)	   QPostEventList;
-typedef QListIteratorM(QPostEvent) QPostEventListIt;
-static QPostEventList *postedEvents = 0;	// list of posted events
+static QPostEventQueue *postedEvents = 0;	// queue of posted events
+
+QPostEventQueue::QPostEventQueue()
+    : receivers( 53 )
+{
+    head = tail = 0;
+    n = 0;
+    receivers.setAutoDelete( TRUE );
+}
+
+QPostEventQueue::~QPostEventQueue()
+{
+    register QPostEvent *pe = head;
+    while ( pe ) {
+	QPostEvent *next = pe->next;
+	if ( pe->event )
+	    ((QPEvent*)pe->event)->clearPostedFlag();
+	delete pe;
+	pe = next;
+    }
+}
+
+/*
+  Appends an event for \a r to the queue and returns TRUE, or deletes
+  the event and returns FALSE if it is compressed into a pending one.
+*/
+
+bool QPostEventQueue::append( QObject *r, QEvent *e )
+{
+    QPostEventChain *c = receivers.find( r );
+    int ci = compressibleIndex( e->type() );
+    if ( c && ci >= 0 && c->pending[ci] ) {
+	((QPEvent*)e)->clearPostedFlag();
+	delete e;
+	return FALSE;
+    }
+    if ( !c ) {
+	c = new QPostEventChain;
+	CHECK_PTR( c );
+	receivers.insert( r, c );
+    }
+    QPostEvent *pe = new QPostEvent( r, e );
+    CHECK_PTR( pe );
+    pe->next = 0;
+    pe->prev = tail;
+    if ( tail )
+	tail->next = pe;
+    else
+	head = pe;
+    tail = pe;
+    pe->rnext = 0;
+    pe->rprev = c->last;
+    if ( c->last )
+	c->last->rnext = pe;
+    else
+	c->first = pe;
+    c->last = pe;
+    if ( ci >= 0 )
+	c->pending[ci] = pe;
+    n++;
+    return TRUE;
+}
+
+/*
+  Unlinks \a pe from the queue without deleting it.
+*/
+
+void QPostEventQueue::take( QPostEvent *pe )
+{
+    if ( pe->prev )
+	pe->prev->next = pe->next;
+    else
+	head = pe->next;
+    if ( pe->next )
+	pe->next->prev = pe->prev;
+    else
+	tail = pe->prev;
+    QPostEventChain *c = receivers.find( pe->receiver );
+    ASSERT( c );
+    if ( pe->rprev )
+	pe->rprev->rnext = pe->rnext;
+    else
+	c->first = pe->rnext;
+    if ( pe->rnext )
+	pe->rnext->rprev = pe->rprev;
+    else
+	c->last = pe->rprev;
+    for ( int i=0; i<numCompressibleEvents; i++ ) {
+	if ( c->pending[i] == pe )
+	    c->pending[i] = 0;
+    }
+    if ( !c->first )
+	receivers.remove( pe->receiver );
+    pe->prev = pe->next = pe->rprev = pe->rnext = 0;
+    n--;
+}
 
 
 /*!
@@ -1345,15 +1507,17 @@ static QPostEventList *postedEvents = 0;	// list of posted events
   When control returns to the main event loop, all events that are
   stored in the queue will be sent using the notify() function.
 
+  Layout hints are compressed: if the receiver already has a pending
+  \c Event_LayoutHint, another one is deleted instead of queued.
+
   \sa sendEvent()
 */
 
 void QApplication::postEvent( QObject *receiver, QEvent *event )
 {
-    if ( !postedEvents ) {			// create list
-	postedEvents = new QListM(QPostEvent);
+    if ( !postedEvents ) {			// create queue
+	postedEvents = new QPostEventQueue;
 	CHECK_PTR( postedEvents );
-	postedEvents->setAutoDelete( TRUE );
     }
     if ( receiver == 0 ) {
 #if defined(CHECK_NULL)
@@ -1363,42 +1527,21 @@ void QApplication::postEvent( QObject *receiver, QEvent *event )
     }
     ((QPEObject*)receiver)->setPendEventFlag();
     ((QPEvent*)event)->setPostedFlag();
-    postedEvents->append( new QPostEvent(receiver,event) );
+    postedEvents->append( receiver, event );
 }
 
 void qt_x11SendPostedEvents()			// transmit posted events
 {
-    if ( !postedEvents )
-	return;
-    QPostEventListIt it(*postedEvents);
     QPostEvent *pe;
-    while ( (pe=it.current()) ) {
-	++it;
-	postedEvents->take( postedEvents->findRef( pe ) );
+    while ( postedEvents && (pe=postedEvents->first()) ) {
+	postedEvents->take( pe );
 	if ( pe->event ) {
-	    if ( pe->event->type() == Event_LayoutHint ) {
-		// layout hints are idempotent and can cause quite
-		// expensive processing, so make sure to deliver just
-		// one per receiver.
-		QPostEventListIt it2( *postedEvents );
-		it2 = it;
-		++it2;
-		QPostEvent * pe2;
-		while ( (pe2=it2.current()) != 0 ) {
-		    ++it2;
-		    if ( pe2->event &&
-			 pe2->event->type() == Event_LayoutHint &&
-			 pe2->receiver == pe->receiver ) {
-			((QPEvent*)pe2->event)->clearPostedFlag();
-			postedEvents->removeRef( pe2 );
-		    }
-		}
-	    }
 	    QApplication::sendEvent( pe->receiver, pe->event );
 	    ((QPEvent*)pe->event)->clearPostedFlag();
 	}
 	delete pe;
     }
+    sendDeferredPaints();			// then paint what was updated
 }
 
 
@@ -1414,7 +1557,7 @@ void QApplication::sendPostedEvents( QObject *receiver, int event_type )
 {
     if ( !postedEvents )
 	return;
-    QPostEventListIt it(*postedEvents);
+    QPostEventChain *c;
     QPostEvent *pe;
 
     // For accumulating compressed events
@@ -1422,35 +1565,35 @@ void QApplication::sendPostedEvents( QObject *receiver, int event_type )
     QSize oldsize, newsize;
     bool first=TRUE;
 
-    while ( (pe = it.current()) ) {
-	++it;
-	
-	if ( pe->event
-	     && pe->receiver == receiver
-	     && pe->event->type() == event_type )
-	    {
-		postedEvents->take( postedEvents->findRef( pe ) );
-		switch ( event_type ) {
-		case Event_Move:
-		    if ( first ) {
-			oldpos = ((QMoveEvent*)pe->event)->oldPos();
-			first = FALSE;
-		    }
-		    newpos = ((QMoveEvent*)pe->event)->pos();
-		    break;
-		case Event_Resize:
-		    if ( first ) {
-			oldsize = ((QResizeEvent*)pe->event)->oldSize();
-			first = FALSE;
-		    }
-		    newsize = ((QResizeEvent*)pe->event)->size();
-		    break;
-		default:
-		    sendEvent( receiver, pe->event );
-		}
-		((QPEvent*)pe->event)->clearPostedFlag();
-		delete pe;
+    // sendEvent() may post or remove events for the receiver, so
+    // start from the chain's head again after each event
+    while ( (c = postedEvents->chain(receiver)) ) {
+	pe = c->first;
+	while ( pe && !(pe->event && pe->event->type() == event_type) )
+	    pe = pe->rnext;
+	if ( !pe )
+	    break;
+	postedEvents->take( pe );
+	switch ( event_type ) {
+	case Event_Move:
+	    if ( first ) {
+		oldpos = ((QMoveEvent*)pe->event)->oldPos();
+		first = FALSE;
+	    }
+	    newpos = ((QMoveEvent*)pe->event)->pos();
+	    break;
+	case Event_Resize:
+	    if ( first ) {
+		oldsize = ((QResizeEvent*)pe->event)->oldSize();
+		first = FALSE;
 	    }
+	    newsize = ((QResizeEvent*)pe->event)->size();
+	    break;
+	default:
+	    sendEvent( receiver, pe->event );
+	}
+	((QPEvent*)pe->event)->clearPostedFlag();
+	delete pe;
     }
     if ( !first ) {
 	// Got one
@@ -1474,41 +1617,224 @@ void QApplication::sendPostedEvents( QObject *receiver, int event_type )
 }
 
 
-void qRemovePostedEvents( QObject *receiver )	// remove receiver from list
+void qRemovePostedEvents( QObject *receiver )	// remove receiver from queue
 {
     if ( !postedEvents )
 	return;
-    register QPostEvent *pe = postedEvents->first();
-    while ( pe ) {
-	if ( pe->receiver == receiver ) {	// remove this receiver
+    QPostEventChain *c;
+    while ( (c = postedEvents->chain(receiver)) ) {
+	register QPostEvent *pe = c->first;
+	postedEvents->take( pe );
+	if ( pe->event )
 	    ((QPEvent*)pe->event)->clearPostedFlag();
-	    postedEvents->remove();
-	    pe = postedEvents->current();
-	} else {
-	    pe = postedEvents->next();
-	}
+	delete pe;
     }
 }
 
-void qRemovePostedEvent( QEvent *event )	// remove event in list
+void qRemovePostedEvent( QEvent *event )	// remove event in queue
 {
     if ( !postedEvents )
 	return;
     register QPostEvent *pe = postedEvents->first();
     while ( pe ) {
-	if ( pe->event == event )		// make this event invalid
+	if ( pe->event == event ) {		// make this event invalid
 	    pe->event = 0;			//   will not be sent!
-	pe = postedEvents->next();
+	    postedEvents->take( pe );
+	    delete pe;
+	    return;
+	}
+	pe = pe->next;
     }
 }
 
-static void cleanupPostedEvents()		// cleanup list
+static void cleanupPostedEvents()		// cleanup queue
 {
     delete postedEvents;
     postedEvents = 0;
 }
 
 
+/*****************************************************************************
+  Deferred paint events for QWidget::update()
+ *****************************************************************************/
+
+/*
+  QWidget::update() does not ask the X server for Expose events.  The
+  area is added to the widget's dirty region instead, and after the
+  posted events, sendDeferredPaints() erases each dirty region and
+  sends a single paint event per widget.  Widgets in a top-level
+  widget with QWidget::setPaintBuffered() paint into an off-screen
+  pixmap which is copied to the window with one XCopyArea.
+*/
+
+typedef Q_DECLARE(QPtrDictM,QRegion)	     QRegionDict;
+typedef Q_DECLARE(QPtrDictIteratorM,QRegion) QRegionDictIt;
+typedef Q_DECLARE(QPtrDictM,QPixmap)	     QPixmapDict;
+static QRegionDict *dirtyRegions    = 0;	// areas to be repainted
+static QRegionDict *paintingRegions = 0;	// areas being repainted now
+static QPixmapDict *paintBuffers    = 0;	// pixmaps of buffered TLWs
+
+static inline bool paintsPending()
+{
+    return dirtyRegions && !dirtyRegions->isEmpty();
+}
+
+void qt_x11AddDirtyRegion( QWidget *w, const QRect &r )
+{
+    if ( !dirtyRegions ) {
+	dirtyRegions = new QRegionDict( 67 );
+	CHECK_PTR( dirtyRegions );
+	dirtyRegions->setAutoDelete( TRUE );
+    }
+    QRegion *rgn = dirtyRegions->find( w );
+    if ( rgn ) {
+	*rgn = rgn->unite( QRegion(r) );
+    } else {
+	rgn = new QRegion( r );
+	CHECK_PTR( rgn );
+	dirtyRegions->insert( w, rgn );
+    }
+}
+
+void qt_x11ScrollDirtyRegion( QWidget *w, int dx, int dy )
+{
+    QRegion *rgn = dirtyRegions ? dirtyRegions->find( w ) : 0;
+    if ( rgn )					// the dirty pixels moved
+	rgn->translate( dx, dy );
+}
+
+void qt_x11ClearDirtyRegion( QWidget *w, const QRect &r )
+{
+    QRegion *rgn = dirtyRegions ? dirtyRegions->find( w ) : 0;
+    if ( rgn ) {				// repainted directly
+	*rgn = rgn->subtract( QRegion(r) );
+	if ( rgn->isEmpty() )
+	    dirtyRegions->remove( w );
+    }
+}
+
+void qt_x11RemoveDirtyRegion( QWidget *w )
+{
+    if ( dirtyRegions )
+	dirtyRegions->remove( w );
+    if ( paintingRegions )
+	paintingRegions->remove( w );
+}
+
+void qt_x11SetPaintBuffer( QWidget *tlw, bool enable )
+{
+    if ( enable ) {
+	if ( !paintBuffers ) {
+	    paintBuffers = new QPixmapDict;
+	    CHECK_PTR( paintBuffers );
+	    paintBuffers->setAutoDelete( TRUE );
+	}
+	if ( !paintBuffers->find(tlw) ) {
+	    QPixmap *pm = new QPixmap;		// sized when first used
+	    CHECK_PTR( pm );
+	    paintBuffers->insert( tlw, pm );
+	}
+    } else if ( paintBuffers ) {
+	paintBuffers->remove( tlw );
+    }
+}
+
+bool qt_x11HasPaintBuffer( const QWidget *tlw )
+{
+    return paintBuffers && paintBuffers->find( (void *)tlw );
+}
+
+static void sendDeferredPaints()
+{
+    if ( !paintsPending() || paintingRegions )
+	return;					// nothing to do, or recursion
+    paintingRegions = dirtyRegions;
+    dirtyRegions = 0;
+    QWidgetList widgets;
+    QRegionDictIt it( *paintingRegions );
+    while ( it.current() ) {
+	widgets.append( (QWidget *)it.currentKey() );
+	++it;
+    }
+    register QWidget *w = widgets.first();
+    while ( w ) {
+	// a paint event may destroy or hide other widgets, which removes
+	// them from paintingRegions
+	QRegion *rgn = paintingRegions->take( w );
+	if ( rgn ) {
+	    if ( w->isVisible() && w->isUpdatesEnabled() )
+		((QETWidget*)w)->sendDeferredPaint( *rgn );
+	    delete rgn;
+	}
+	w = widgets.next();
+    }
+    delete paintingRegions;
+    paintingRegions = 0;
+}
+
+static void cleanupDeferredPaints()
+{
+    delete dirtyRegions;
+    dirtyRegions = 0;
+    delete paintBuffers;
+    paintBuffers = 0;
+}
+
+/*
+  Erases the region and sends a paint event for its bounding rectangle,
+  or paints it off-screen if the top-level widget is buffered.
+*/
+
+void QETWidget::sendDeferredPaint( QRegion &rgn )
+{
+    rgn = rgn.intersect( QRegion(rect()) );
+    if ( rgn.isEmpty() )
+	return;
+    QRect br = rgn.boundingRect();
+    QPixmap *buf = paintBuffers ? paintBuffers->find(topLevelWidget()) : 0;
+    if ( buf && !testWFlags(WPaintClever) ) {
+	if ( buf->width() <= br.right() || buf->height() <= br.bottom() ) {
+	    QWidget *tlw = topLevelWidget();
+	    buf->resize( QMAX(QMAX(buf->width(),tlw->width()),br.right()+1),
+			 QMAX(QMAX(buf->height(),tlw->height()),br.bottom()+1));
+	}
+	QPainter p;
+	p.begin( buf );
+	const QPixmap *bgpm = backgroundPixmap();
+	if ( bgpm && !bgpm->isNull() )
+	    p.drawTiledPixmap( br.x(), br.y(), br.width(), br.height(), *bgpm,
+			       br.x() % bgpm->width(), br.y() % bgpm->height() );
+	else
+	    p.fillRect( br, backgroundColor() );
+	p.end();
+	QPainter::redirect( this, buf );
+	QPaintEvent e( br );
+	setWFlags( WState_PaintEvent );
+	QApplication::sendEvent( this, &e );
+	clearWFlags( WState_PaintEvent );
+	QPainter::redirect( this, 0 );
+	bitBlt( this, br.x(), br.y(), buf, br.x(), br.y(),
+		br.width(), br.height() );
+    } else {
+	QArray<QRect> r = rgn.rects();
+	int i;
+	for ( i=0; i<(int)r.size(); i++ )
+	    erase( r[i] );
+	setWFlags( WState_PaintEvent );
+	if ( testWFlags(WPaintClever) ) {	// one event per rectangle
+	    for ( i=0; i<(int)r.size() && isVisible(); i++ ) {
+		QPaintEvent e( r[i] );
+		QApplication::sendEvent( this, &e );
+	    }
+	} else {
+	    QPaintEvent e( br );
+	    QApplication::sendEvent( this, &e );
+	}
+	clearWFlags( WState_PaintEvent );
+    }
+}
+
+
 /*****************************************************************************
   Special lookup functions for windows that have been recreated recently
  *****************************************************************************/
@@ -1557,38 +1883,54 @@ QETWidget *qPRFindWidget( Window oldwin )
 
   The QSocketNotifier class (qsocketnotifier.h) provides installable callbacks
   for select() throught the internal function qt_set_socket_handler().
+
+  The notifiers are kept in a table indexed by file descriptor.  The event
+  loop waits with epoll on Linux and with poll elsewhere, so that the cost
+  of a wakeup depends on the number of active descriptors rather than on
+  the value of the highest one.  If epoll refuses a descriptor (regular
+  files, for instance), we fall back to poll for good.  select() is only
+  used where poll is not available.
  *****************************************************************************/
 
 struct QSockNot {
-    QObject *obj;
-    int	     fd;
-    fd_set  *queue;
+    QObject  *obj;
+    int	      fd;
+    bool      queued;				// in activation list
+    QSockNot *next;				// next for same fd and type
 };
 
 typedef Q_DECLARE(QListM,QSockNot)	   QSNList;
 typedef Q_DECLARE(QListIteratorM,QSockNot) QSNListIt;
 
-static int	sn_highest = -1;
-static QSNList *sn_read	   = 0;
-static QSNList *sn_write   = 0;
-static QSNList *sn_except  = 0;
-
-static fd_set	sn_readfds;			// fd set for reading
-static fd_set	sn_writefds;			// fd set for writing
-static fd_set	sn_exceptfds;			// fd set for exceptions
-static fd_set	sn_queued_read;
-static fd_set	sn_queued_write;
-static fd_set	sn_queued_except;
-
-static struct SN_Type {
-    QSNList **list;
-    fd_set   *fdspec;
-    fd_set   *fdres;
-    fd_set   *queue;
-} sn_vec[3] = {
-    { &sn_read,	  &sn_readfds,	 &app_readfds,   &sn_queued_read },
-    { &sn_write,  &sn_writefds,	 &app_writefds,  &sn_queued_write },
-    { &sn_except, &sn_exceptfds, &app_exceptfds, &sn_queued_except } };
+struct QSockNotFd {				// notifiers for one fd
+    QSockNot *sn[3];				// one chain per type
+    int	      pollIndex;			// index in sn_pollfds
+};
+
+static QSockNotFd *sn_fds   = 0;		// indexed by fd
+static int	   sn_fdlen = 0;		// size of sn_fds
+static int	   sn_count = 0;		// number of notifiers
+
+struct SN_Ready {				// result of sn_wait()
+    int fd;
+    int mask;					// bit n set: type n
+};
+
+static SN_Ready *sn_ready    = 0;
+static int	 sn_readylen = 0;
+static int	 sn_nready   = 0;
+
+#if !defined(QT_NO_POLL)
+static struct pollfd *sn_pollfds   = 0;		// [0] is the X fd
+static int	      sn_npollfds  = 1;
+static int	      sn_pollfdlen = 0;
+#endif
+
+#if defined(QT_EPOLL)
+static const int sn_epoll_none	 = -1;		// not created yet
+static const int sn_epoll_failed = -2;		// use poll instead
+static int	 sn_epfd = sn_epoll_none;
+#endif
 
 
 static QSNList *sn_act_list = 0;
@@ -1598,10 +1940,34 @@ static void sn_cleanup()
 {
     delete sn_act_list;
     sn_act_list = 0;
-    for ( int i=0; i<3; i++ ) {
-	delete *sn_vec[i].list;
-	*sn_vec[i].list = 0;
-    }	
+    for ( int fd=0; fd<sn_fdlen; fd++ ) {
+	for ( int t=0; t<3; t++ ) {
+	    QSockNot *sn = sn_fds[fd].sn[t];
+	    while ( sn ) {
+		QSockNot *next = sn->next;
+		delete sn;
+		sn = next;
+	    }
+	}
+    }
+    free( sn_fds );
+    sn_fds = 0;
+    sn_fdlen = 0;
+    sn_count = 0;
+    free( sn_ready );
+    sn_ready = 0;
+    sn_readylen = 0;
+#if !defined(QT_NO_POLL)
+    free( sn_pollfds );
+    sn_pollfds = 0;
+    sn_npollfds = 1;
+    sn_pollfdlen = 0;
+#endif
+#if defined(QT_EPOLL)
+    if ( sn_epfd >= 0 )
+	::close( sn_epfd );
+    sn_epfd = sn_epoll_none;
+#endif
 }
 
 
@@ -1615,6 +1981,282 @@ static void sn_init()
 }
 
 
+/*
+  Returns the table entry for fd, growing the table if necessary.
+*/
+
+static QSockNotFd *sn_fd_entry( int fd )
+{
+    if ( fd >= sn_fdlen ) {
+	int newlen = QMAX( 64, sn_fdlen );
+	while ( newlen <= fd )
+	    newlen *= 2;
+	sn_fds = (QSockNotFd *)realloc( sn_fds, newlen*sizeof(QSockNotFd) );
+	CHECK_PTR( sn_fds );
+	for ( int i=sn_fdlen; i<newlen; i++ ) {
+	    sn_fds[i].sn[0] = sn_fds[i].sn[1] = sn_fds[i].sn[2] = 0;
+	    sn_fds[i].pollIndex = -1;
+	}
+	sn_fdlen = newlen;
+    }
+    return &sn_fds[fd];
+}
+
+static int sn_fd_mask( const QSockNotFd *e )
+{
+    return (e->sn[0] ? 1 : 0) | (e->sn[1] ? 2 : 0) | (e->sn[2] ? 4 : 0);
+}
+
+static void sn_add_ready( int fd, int mask )
+{
+    if ( sn_nready == sn_readylen ) {
+	sn_readylen = QMAX( 32, 2*sn_readylen );
+	sn_ready = (SN_Ready *)realloc( sn_ready,
+					sn_readylen*sizeof(SN_Ready) );
+	CHECK_PTR( sn_ready );
+    }
+    sn_ready[sn_nready].fd = fd;
+    sn_ready[sn_nready].mask = mask;
+    sn_nready++;
+}
+
+#if !defined(QT_NO_POLL)
+
+/*
+  Adds, changes or removes fd in the poll set.  Removal moves the last
+  entry into the hole, so the set is always dense.
+*/
+
+static void sn_poll_update( int fd, int mask )
+{
+    QSockNotFd *e = &sn_fds[fd];
+    if ( mask ) {
+	if ( e->pollIndex < 0 ) {
+	    if ( sn_npollfds >= sn_pollfdlen ) {
+		sn_pollfdlen = QMAX( 32, 2*sn_pollfdlen );
+		sn_pollfds = (struct pollfd *)
+		    realloc( sn_pollfds, sn_pollfdlen*sizeof(struct pollfd) );
+		CHECK_PTR( sn_pollfds );
+	    }
+	    e->pollIndex = sn_npollfds++;
+	    sn_pollfds[e->pollIndex].fd = fd;
+	}
+	short events = 0;
+	if ( mask & 1 )
+	    events |= POLLIN;
+	if ( mask & 2 )
+	    events |= POLLOUT;
+	if ( mask & 4 )
+	    events |= POLLPRI;
+	sn_pollfds[e->pollIndex].events = events;
+    } else if ( e->pollIndex >= 0 ) {
+	int last = --sn_npollfds;
+	if ( e->pollIndex != last ) {
+	    sn_pollfds[e->pollIndex] = sn_pollfds[last];
+	    sn_fds[sn_pollfds[last].fd].pollIndex = e->pollIndex;
+	}
+	e->pollIndex = -1;
+    }
+}
+
+static int sn_poll_wait( int timeout )
+{
+    if ( !sn_pollfdlen ) {			// room for the X fd
+	sn_pollfdlen = 32;
+	sn_pollfds = (struct pollfd *)
+	    malloc( sn_pollfdlen*sizeof(struct pollfd) );
+	CHECK_PTR( sn_pollfds );
+    }
+    sn_pollfds[0].fd = app_Xfd;
+    sn_pollfds[0].events = POLLIN;
+    int nsel = ::poll( sn_pollfds, sn_npollfds, timeout );
+    if ( nsel <= 0 )
+	return nsel;
+    for ( int i=1; i<sn_npollfds; i++ ) {
+	short r = sn_pollfds[i].revents;
+	if ( !r )
+	    continue;
+	int mask = 0;				// same as select() would say
+	if ( r & (POLLIN|POLLHUP|POLLERR|POLLNVAL) )
+	    mask |= 1;
+	if ( r & (POLLOUT|POLLHUP|POLLERR|POLLNVAL) )
+	    mask |= 2;
+	if ( r & POLLPRI )
+	    mask |= 4;
+	sn_add_ready( sn_pollfds[i].fd, mask );
+    }
+    return nsel;
+}
+
+#endif // !QT_NO_POLL
+
+#if defined(QT_EPOLL)
+
+/*
+  Gives up on epoll and puts all descriptors into the poll set.
+*/
+
+static void sn_use_poll()
+{
+    if ( sn_epfd >= 0 )
+	::close( sn_epfd );
+    sn_epfd = sn_epoll_failed;
+    for ( int fd=0; fd<sn_fdlen; fd++ )
+	sn_poll_update( fd, sn_fd_mask(&sn_fds[fd]) );
+}
+
+static bool sn_epoll_ctl( int fd, int mask, bool known )
+{
+    struct epoll_event ev;
+    memset( &ev, 0, sizeof(ev) );
+    ev.data.fd = fd;
+    if ( mask & 1 )
+	ev.events |= EPOLLIN;
+    if ( mask & 2 )
+	ev.events |= EPOLLOUT;
+    if ( mask & 4 )
+	ev.events |= EPOLLPRI;
+    if ( !mask ) {				// the fd may be closed already
+	epoll_ctl( sn_epfd, EPOLL_CTL_DEL, fd, &ev );
+	return TRUE;
+    }
+    int op = known ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if ( epoll_ctl(sn_epfd, op, fd, &ev) == 0 )
+	return TRUE;
+    if ( errno == ENOENT )			// closed and reopened
+	op = EPOLL_CTL_ADD;
+    else if ( errno == EEXIST )
+	op = EPOLL_CTL_MOD;
+    else
+	return FALSE;
+    return epoll_ctl( sn_epfd, op, fd, &ev ) == 0;
+}
+
+static int sn_epoll_wait( int timeout )
+{
+    if ( sn_epfd == sn_epoll_none ) {		// create on first use
+	sn_epfd = epoll_create( 64 );
+	if ( sn_epfd < 0 ) {
+	    sn_use_poll();
+	    return sn_poll_wait( timeout );
+	}
+	fcntl( sn_epfd, F_SETFD, FD_CLOEXEC );	// not for child processes
+	bool ok = sn_epoll_ctl( app_Xfd, 1, FALSE );
+	for ( int fd=0; ok && fd<sn_fdlen; fd++ ) {
+	    int mask = sn_fd_mask( &sn_fds[fd] );
+	    if ( mask && fd != app_Xfd )
+		ok = sn_epoll_ctl( fd, mask, FALSE );
+	}
+	if ( !ok ) {
+	    sn_use_poll();
+	    return sn_poll_wait( timeout );
+	}
+    }
+    const int maxevents = 256;			// the rest comes next time
+    struct epoll_event events[maxevents];
+    int nsel = epoll_wait( sn_epfd, events, maxevents, timeout );
+    for ( int i=0; i<nsel; i++ ) {
+	int fd = events[i].data.fd;
+	if ( fd >= sn_fdlen )			// no notifiers, e.g. X fd
+	    continue;
+	uint r = events[i].events;
+	int mask = 0;
+	if ( r & (EPOLLIN|EPOLLHUP|EPOLLERR) )
+	    mask |= 1;
+	if ( r & (EPOLLOUT|EPOLLHUP|EPOLLERR) )
+	    mask |= 2;
+	if ( r & EPOLLPRI )
+	    mask |= 4;
+	mask &= sn_fd_mask( &sn_fds[fd] );
+	if ( mask )
+	    sn_add_ready( fd, mask );
+    }
+    return nsel;
+}
+
+#endif // QT_EPOLL
+
+/*
+  Tells the backend that the notifier types for fd changed from oldmask
+  to the current ones.
+*/
+
+static void sn_fd_changed( int fd, int oldmask )
+{
+    int mask = sn_fd_mask( &sn_fds[fd] );
+    if ( mask == oldmask )
+	return;
+#if defined(QT_EPOLL)
+    if ( sn_epfd >= 0 ) {
+	if ( fd != app_Xfd && !sn_epoll_ctl(fd, mask, oldmask != 0) )
+	    sn_use_poll();
+	return;
+    }
+    if ( sn_epfd == sn_epoll_none )		// registered at creation
+	return;
+#endif
+#if !defined(QT_NO_POLL)
+    sn_poll_update( fd, mask );
+#endif
+}
+
+/*
+  Waits for the X connection or any of the socket notifier fds to become
+  ready, or until the timeout tm expires (0 means wait forever).
+  Returns the same as select() and fills sn_ready with the fds that can
+  be activated.
+*/
+
+static int sn_wait( timeval *tm )
+{
+    sn_nready = 0;
+#if defined(QT_NO_POLL)
+    fd_set readfds, writefds, exceptfds;
+    FD_ZERO( &readfds );
+    FD_ZERO( &writefds );
+    FD_ZERO( &exceptfds );
+    int highest = app_Xfd;
+    for ( int fd=0; fd<sn_fdlen; fd++ ) {
+	int mask = sn_fd_mask( &sn_fds[fd] );
+	if ( !mask )
+	    continue;
+	if ( mask & 1 )
+	    FD_SET( fd, &readfds );
+	if ( mask & 2 )
+	    FD_SET( fd, &writefds );
+	if ( mask & 4 )
+	    FD_SET( fd, &exceptfds );
+	highest = QMAX( highest, fd );
+    }
+    FD_SET( app_Xfd, &readfds );
+    int nsel = select( highest+1, (void *)&readfds, (void *)&writefds,
+		       (void *)&exceptfds, tm );
+    for ( int fd=0; nsel > 0 && fd<sn_fdlen; fd++ ) {
+	int mask = (FD_ISSET(fd,&readfds)   ? 1 : 0) |
+		   (FD_ISSET(fd,&writefds)  ? 2 : 0) |
+		   (FD_ISSET(fd,&exceptfds) ? 4 : 0);
+	mask &= sn_fd_mask( &sn_fds[fd] );
+	if ( mask )
+	    sn_add_ready( fd, mask );
+    }
+    return nsel;
+#else
+    int timeout = -1;
+    if ( tm ) {					// round up, don't spin
+	if ( tm->tv_sec > 1000000 )
+	    timeout = 1000000000;
+	else
+	    timeout = tm->tv_sec*1000 + (tm->tv_usec+999)/1000;
+    }
+#if defined(QT_EPOLL)
+    if ( sn_epfd != sn_epoll_failed )
+	return sn_epoll_wait( timeout );
+#endif
+    return sn_poll_wait( timeout );
+#endif
+}
+
+
 bool qt_set_socket_handler( int sockfd, int type, QObject *obj, bool enable )
 {
     if ( sockfd < 0 || type < 0 || type > 2 || obj == 0 ) {
@@ -1624,68 +2266,46 @@ bool qt_set_socket_handler( int sockfd, int type, QObject *obj, bool enable )
 	return FALSE;
     }
 
-    QSNList  *list = *sn_vec[type].list;
-    fd_set   *fds  =  sn_vec[type].fdspec;
     QSockNot *sn;
 
     if ( enable ) {				// enable notifier
-	if ( !list ) {
-	    sn_init();
-	    list = new QSNList;			// create new list
-	    CHECK_PTR( list );
-	    list->setAutoDelete( TRUE );
-	    *sn_vec[type].list = list;
-	    FD_ZERO( fds );
-	    FD_ZERO( sn_vec[type].queue );
+	sn_init();
+	QSockNotFd *e = sn_fd_entry( sockfd );
+#if defined(DEBUG)
+	if ( e->sn[type] ) {
+	    static const char *t[] = { "read", "write", "exception" };
+	    warning( "QSocketNotifier: Multiple socket notifiers for "
+		     "same socket %d and type %s", sockfd, t[type] );
 	}
+#endif
+	int oldmask = sn_fd_mask( e );
 	sn = new QSockNot;
 	CHECK_PTR( sn );
 	sn->obj = obj;
 	sn->fd	= sockfd;
-	sn->queue = sn_vec[type].queue;
-	if ( list->isEmpty() ) {
-	    list->insert( 0, sn );
-	} else {				// sort list by fd, decreasing
-	    QSockNot *p = list->first();
-	    while ( p && p->fd > sockfd )
-		p = list->next();
-#if defined(DEBUG)
-	    if ( p && p->fd == sockfd ) {
-		static const char *t[] = { "read", "write", "exception" };
-		warning( "QSocketNotifier: Multiple socket notifiers for "
-			 "same socket %d and type %s", sockfd, t[type] );
-	    }
-#endif	
-	    if ( p )
-		list->insert( list->at(), sn );
-	    else
-		list->append( sn );
-	}
-	FD_SET( sockfd, fds );
-	sn_highest = QMAX(sn_highest,sockfd);
+	sn->queued = FALSE;
+	sn->next = e->sn[type];
+	e->sn[type] = sn;
+	sn_count++;
+	sn_fd_changed( sockfd, oldmask );
 
     } else {					// disable notifier
 
-	if ( list == 0 )
-	    return FALSE;			// no such fd set
-	QSockNot *sn = list->first();
-	while ( sn && !(sn->obj == obj && sn->fd == sockfd) )
-	    sn = list->next();
+	if ( sockfd >= sn_fdlen )
+	    return FALSE;			// no such fd
+	QSockNotFd *e = &sn_fds[sockfd];
+	QSockNot **prev = &e->sn[type];
+	while ( (sn=*prev) && sn->obj != obj )
+	    prev = &sn->next;
 	if ( !sn )				// not found
 	    return FALSE;
-	FD_CLR( sockfd, fds );			// clear fd bit
-	FD_CLR( sockfd, sn->queue );
-	if ( sn_act_list )
+	int oldmask = sn_fd_mask( e );
+	*prev = sn->next;			// unlink notifier
+	if ( sn->queued && sn_act_list )
 	    sn_act_list->removeRef( sn );	// remove from activation list
-	list->remove();				// remove notifier found above
-	if ( sn_highest == sockfd ) {		// find highest fd
-	    sn_highest = -1;
-	    for ( int i=0; i<3; i++ ) {
-		if ( *sn_vec[i].list && (*sn_vec[i].list)->count() )
-		    sn_highest = QMAX(sn_highest,  // list is fd-sorted
-				      (*sn_vec[i].list)->getFirst()->fd);
-	    }
-	}
+	delete sn;
+	sn_count--;
+	sn_fd_changed( sockfd, oldmask );
     }
 
     return TRUE;
@@ -1706,23 +2326,22 @@ static int sn_activate()
     if ( !sn_act_list )
 	sn_init();
     int i, n_act = 0;
-    for ( i=0; i<3; i++ ) {			// for each list...
-	if ( *sn_vec[i].list ) {		// any entries?
-	    QSNList  *list = *sn_vec[i].list;
-	    fd_set   *fds  = sn_vec[i].fdres;
-	    QSockNot *sn   = list->first();
-	    while ( sn ) {
-		if ( FD_ISSET( sn->fd, fds ) &&	// store away for activation
-		     !FD_ISSET( sn->fd, sn->queue ) ) {
+    for ( i=0; i<sn_nready; i++ ) {		// for each ready fd...
+	QSockNotFd *e = &sn_fds[sn_ready[i].fd];
+	for ( int t=0; t<3; t++ ) {
+	    if ( !(sn_ready[i].mask & (1 << t)) )
+		continue;
+	    for ( QSockNot *sn=e->sn[t]; sn; sn=sn->next ) {
+		if ( !sn->queued ) {		// store away for activation
 		    sn_act_list->insert( (rand() & 0xff) %
 					 (sn_act_list->count()+1),
 					 sn );
-		    FD_SET( sn->fd, sn->queue );
+		    sn->queued = TRUE;
 		}
-		sn = list->next();
 	    }
 	}
     }
+    sn_nready = 0;
     if ( sn_act_list->count() > 0 ) {		// activate entries
 	QEvent event( Event_SockAct );
 	QSNListIt it( *sn_act_list );
@@ -1730,8 +2349,8 @@ static int sn_activate()
 	while ( (sn=it.current()) ) {
 	    ++it;
 	    sn_act_list->removeRef( sn );
-	    if ( FD_ISSET(sn->fd, sn->queue) ) {
-		FD_CLR( sn->fd, sn->queue );
+	    if ( sn->queued ) {
+		sn->queued = FALSE;
 		QApplication::sendEvent( sn->obj, &event );
 		n_act++;
 	    }
@@ -1791,7 +2410,7 @@ bool QApplication::processNextEvent( bool canWait )
     XEvent event;
     int	   nevents = 0;
 
-    if ( postedEvents && postedEvents->count() )
+    if ( postedEvents && postedEvents->count() || paintsPending() )
 	qt_x11SendPostedEvents();
 
     while ( XPending(appDpy) ) {		// also flushes output buffer
@@ -1809,33 +2428,15 @@ bool QApplication::processNextEvent( bool canWait )
 
     static timeval zerotm;
     timeval *tm = qt_wait_timer();		// wait for timer or X event
-    if ( !canWait || postedEvents && postedEvents->count() ) {
+    if ( !canWait || postedEvents && postedEvents->count() ||
+	 paintsPending() ) {
 	if ( !tm )
 	    tm = &zerotm;
 	tm->tv_sec  = 0;			// no time to wait
 	tm->tv_usec = 0;
     }
-    if ( sn_highest >= 0 ) {			// has socket notifier(s)
-	if ( sn_read )
-	    app_readfds = sn_readfds;
-	else
-	    FD_ZERO( &app_readfds );
-	if ( sn_write )
-	    app_writefds = sn_writefds;
-	if ( sn_except )
-	    app_exceptfds = sn_exceptfds;
-    } else {
-	FD_ZERO( &app_readfds );
-    }
-    FD_SET( app_Xfd, &app_readfds );
 
-    int nsel;
-    nsel = select( QMAX(app_Xfd,sn_highest)+1,
-		   (void *) (&app_readfds),
-		   (void *) (sn_write  ? &app_writefds  : 0),
-		   (void *) (sn_except ? &app_exceptfds : 0),
-		   tm );
-#undef FDCAST
+    int nsel = sn_wait( tm );			// wait for X or sockets
 
     if ( nsel == -1 ) {
 	if ( errno == EINTR || errno == EAGAIN ) {
@@ -1844,7 +2445,7 @@ bool QApplication::processNextEvent( bool canWait )
 	} else {
 	    ; // select error
 	}
-    } else if ( nsel > 0 && sn_highest >= 0 ) {
+    } else if ( nsel > 0 && sn_count > 0 ) {
 	nevents += sn_activate();
     }
 
@@ -1867,6 +2468,10 @@ bool QApplication::processNextEvent( bool canWait )
 */
 int QApplication::x11ProcessEvent( XEvent* event )
 {
+    bool qt_x11_shm_event( XEvent * );	// in qpixmap_x11.cpp
+    if ( qt_x11_shm_event(event) )		// pixmap upload completed
+	return 1;
+
     if ( x11EventFilter(event) )		// send through app filter
 	return 1;
 
@@ -2445,18 +3050,36 @@ QWidget *QApplication::activeModalWidget()
 //
 // Internal data structure for timers
 //
+// The timers are kept in a binary heap ordered by timeout, so starting,
+// killing and activating a timer are O(log n).  Timer identifiers index
+// a table of timers; freed identifiers are kept on a stack and reused.
+// The timers of each object are chained, so that qKillTimer(obj) does
+// not have to look at the timers of other objects.
+//
 
 struct TimerInfo {				// internal timer info
     int	     id;				// - timer identifier
     timeval  interval;				// - timer interval
     timeval  timeout;				// - when to sent event
     QObject *obj;				// - object to receive event
+    uint     seq;				// - breaks ties in the heap
+    int	     heapIndex;				// - position in timerHeap
+    TimerInfo *nextForObj;			// - next timer of same object
 };
 
-typedef Q_DECLARE(QListM,TimerInfo) TimerList;	// list of TimerInfo structs
+typedef Q_DECLARE(QPtrDictM,TimerInfo) TimerDict; // first timer of object
 
-static QBitArray *timerBitVec;			// timer bit vector
-static TimerList *timerList	= 0;		// timer list
+static TimerInfo **timerHeap	= 0;		// heap ordered by timeout
+static int	   timerCount	= 0;		// number of active timers
+static int	   timerHeapLen = 0;		// allocated size of timerHeap
+static uint	   timerSeq	= 0;		// next sequence number
+static TimerInfo **timerIds	= 0;		// timers indexed by id-1
+static int	   timerIdLen	= 0;		// allocated size of timerIds
+static int	   timerIdHigh	= 0;		// ids in use are <= this
+static int	  *timerFreeIds = 0;		// stack of released ids
+static int	   timerFreeCount = 0;
+static TimerDict  *timerObjDict = 0;	// timers for each object
+static timeval	   timerSlack;			// timer tolerance
 
 
 //
@@ -2504,33 +3127,123 @@ static inline timeval operator-( const timeval &t1, const timeval &t2 )
 
 //
 // Internal functions for manipulating timer data structures.
-// The timerBitVec array is used for keeping track of timer identifiers.
 //
 
 static int allocTimerId()			// find avail timer identifier
 {
-    int i = timerBitVec->size()-1;
-    while ( i >= 0 && (*timerBitVec)[i] )
-	i--;
-    if ( i < 0 ) {
-	i = timerBitVec->size();
-	timerBitVec->resize( 4 * i );
-	for( int j=timerBitVec->size()-1; j > i; j-- )
-	    timerBitVec->clearBit( j );
+    if ( timerFreeCount > 0 )			// reuse a released id
+	return timerFreeIds[--timerFreeCount];
+    if ( timerIdHigh == timerIdLen ) {		// grow id table
+	int newlen = QMAX( 128, 2*timerIdLen );
+	timerIds = (TimerInfo **)realloc( timerIds,
+					  newlen*sizeof(TimerInfo*) );
+	CHECK_PTR( timerIds );
+	timerFreeIds = (int *)realloc( timerFreeIds, newlen*sizeof(int) );
+	CHECK_PTR( timerFreeIds );
+	memset( (char*)&timerIds[timerIdLen], 0,
+		(newlen-timerIdLen)*sizeof(TimerInfo*) );
+	timerIdLen = newlen;
+    }
+    return ++timerIdHigh;
+}
+
+static inline bool timerBefore( const TimerInfo *t1, const TimerInfo *t2 )
+{
+    if ( t1->timeout < t2->timeout )
+	return TRUE;
+    if ( t2->timeout < t1->timeout )
+	return FALSE;
+    return (int)(t1->seq - t2->seq) < 0;	// first come, first served
+}
+
+static inline void heapSet( int i, TimerInfo *t )
+{
+    timerHeap[i] = t;
+    t->heapIndex = i;
+}
+
+static void heapUp( int i )			// move timer towards the top
+{
+    TimerInfo *t = timerHeap[i];
+    while ( i > 0 ) {
+	int parent = (i-1)/2;
+	if ( !timerBefore(t, timerHeap[parent]) )
+	    break;
+	heapSet( i, timerHeap[parent] );
+	i = parent;
     }
-    timerBitVec->setBit( i );
-    return i+1;
+    heapSet( i, t );
 }
 
-static void insertTimer( const TimerInfo *ti )	// insert timer info into list
+static void heapDown( int i )			// move timer towards the bottom
 {
-    TimerInfo *t = timerList->first();
-    int index = 0;
-    while ( t && t->timeout < ti->timeout ) {	// list is sorted by timeout
-	t = timerList->next();
-	index++;
+    TimerInfo *t = timerHeap[i];
+    for ( ;; ) {
+	int child = 2*i+1;
+	if ( child >= timerCount )
+	    break;
+	if ( child+1 < timerCount &&
+	     timerBefore(timerHeap[child+1], timerHeap[child]) )
+	    child++;
+	if ( !timerBefore(timerHeap[child], t) )
+	    break;
+	heapSet( i, timerHeap[child] );
+	i = child;
+    }
+    heapSet( i, t );
+}
+
+static void insertTimer( TimerInfo *ti )	// insert timer info into heap
+{
+    if ( timerCount == timerHeapLen ) {
+	timerHeapLen = QMAX( 64, 2*timerHeapLen );
+	timerHeap = (TimerInfo **)realloc( timerHeap,
+					   timerHeapLen*sizeof(TimerInfo*) );
+	CHECK_PTR( timerHeap );
+    }
+    ti->seq = timerSeq++;
+    heapSet( timerCount, ti );
+    heapUp( timerCount++ );
+}
+
+static void unlinkTimer( TimerInfo *ti )	// remove timer info from heap
+{
+    int i = ti->heapIndex;
+    TimerInfo *last = timerHeap[--timerCount];
+    if ( last != ti ) {
+	heapSet( i, last );
+	if ( i > 0 && timerBefore(last, timerHeap[(i-1)/2]) )
+	    heapUp( i );
+	else
+	    heapDown( i );
+    }
+    ti->heapIndex = -1;
+}
+
+/*
+  Rounds the timeout of a timer up to a multiple of the timer tolerance,
+  so that timers that expire at about the same time are activated in one
+  wakeup.  Timers with intervals shorter than the tolerance are not
+  touched.
+*/
+
+static void coalesceTimer( TimerInfo *ti )
+{
+    if ( (timerSlack.tv_sec == 0 && timerSlack.tv_usec == 0) ||
+	 ti->interval < timerSlack )
+	return;
+    // An hour in microseconds still fits in an unsigned 32-bit long
+    unsigned long tol = timerSlack.tv_sec >= 3600 ? 3600000000UL :
+			timerSlack.tv_sec*1000000UL + timerSlack.tv_usec;
+    unsigned long usec = (ti->timeout.tv_sec % 3600)*1000000UL +
+			 ti->timeout.tv_usec;
+    unsigned long rest = usec % tol;
+    if ( rest ) {
+	timeval d;
+	d.tv_sec  = (tol-rest) / 1000000;
+	d.tv_usec = (tol-rest) % 1000000;
+	ti->timeout += d;
     }
-    timerList->insert( index, ti );		// inserts sorted
 }
 
 static inline void getTime( timeval &t )	// get time of day
@@ -2553,13 +3266,12 @@ static inline void getTime( timeval &t )	// get time of day
 
 static void repairTimer( const timeval &time )	// repair broken timer
 {
-    if ( !timerList )				// not initialized
+    if ( !timerHeap )				// not initialized
 	return;
     timeval diff = watchtime - time;
-    register TimerInfo *t = timerList->first();
-    while ( t ) {				// repair all timers
+    for ( int i=0; i<timerCount; i++ ) {	// repair all timers; the
+	TimerInfo *t = timerHeap[i];		//   heap order is unchanged
 	t->timeout = t->timeout - diff;
-	t = timerList->next();
     }
 }
 
@@ -2578,7 +3290,7 @@ timeval *qt_wait_timer()
     static timeval tm;
     bool first = TRUE;
     timeval currentTime;
-    if ( timerList && timerList->count() ) {	// there are waiting timers
+    if ( timerCount ) {				// there are waiting timers
 	getTime( currentTime );
 	if ( first ) {
 	    if ( currentTime < watchtime )	// clock was turned back
@@ -2586,7 +3298,7 @@ timeval *qt_wait_timer()
 	    first = FALSE;
 	    watchtime = currentTime;
 	}
-	TimerInfo *t = timerList->first();	// first waiting timer
+	TimerInfo *t = timerHeap[0];		// first waiting timer
 	if ( currentTime < t->timeout ) {	// time to wait
 	    tm = t->timeout - currentTime;
 	} else {
@@ -2605,11 +3317,11 @@ timeval *qt_wait_timer()
 
 int qt_activate_timers()
 {
-    if ( !timerList || !timerList->count() )	// no timers
+    if ( !timerCount )				// no timers
 	return 0;
     bool first = TRUE;
     timeval currentTime;
-    int maxcount = timerList->count();
+    int maxcount = timerCount;
     int n_act = 0;
     register TimerInfo *t;
     while ( maxcount-- ) {			// avoid starvation
@@ -2620,13 +3332,16 @@ int qt_activate_timers()
 	    first = FALSE;
 	    watchtime = currentTime;
 	}
-	t = timerList->first();
-	if ( !t || currentTime < t->timeout )	// no timer has expired
+	if ( !timerCount )
 	    break;
-	timerList->take();			// unlink from list
+	t = timerHeap[0];
+	if ( currentTime < t->timeout )		// no timer has expired
+	    break;
+	unlinkTimer( t );			// unlink from heap
 	t->timeout += t->interval;
 	if ( t->timeout < currentTime )
 	    t->timeout = currentTime + t->interval;
+	coalesceTimer( t );
 	insertTimer( t );			// relink timer
 	if ( t->interval.tv_usec > 0 || t->interval.tv_sec > 0 )
 	    n_act++;
@@ -2643,26 +3358,49 @@ int qt_activate_timers()
 
 static void initTimers()			// initialize timers
 {
-    timerBitVec = new QBitArray( 128 );
-    CHECK_PTR( timerBitVec );
-    int i = timerBitVec->size();
-    while( i-- > 0 )
-	timerBitVec->clearBit( i );
-    timerList = new TimerList;
-    CHECK_PTR( timerList );
-    timerList->setAutoDelete( TRUE );
+    timerObjDict = new TimerDict( 101 );
+    CHECK_PTR( timerObjDict );
 }
 
 static void cleanupTimers()			// cleanup timer data structure
 {
-    if ( timerList ) {
-	delete timerList;
-	timerList = 0;
-	delete timerBitVec;
-	timerBitVec = 0;
+    if ( timerObjDict ) {
+	for ( int i=0; i<timerCount; i++ )
+	    delete timerHeap[i];
+	free( timerHeap );
+	timerHeap = 0;
+	timerCount = timerHeapLen = 0;
+	free( timerIds );
+	timerIds = 0;
+	timerIdLen = timerIdHigh = 0;
+	free( timerFreeIds );
+	timerFreeIds = 0;
+	timerFreeCount = 0;
+	delete timerObjDict;
+	timerObjDict = 0;
     }
 }
 
+static void removeTimer( TimerInfo *t )		// unlink and delete timer
+{
+    unlinkTimer( t );
+    TimerInfo *first = timerObjDict->find( t->obj );
+    if ( first == t ) {				// unlink from object's chain
+	if ( t->nextForObj )
+	    timerObjDict->replace( t->obj, t->nextForObj );
+	else
+	    timerObjDict->remove( t->obj );
+    } else {
+	while ( first && first->nextForObj != t )
+	    first = first->nextForObj;
+	if ( first )
+	    first->nextForObj = t->nextForObj;
+    }
+    timerIds[t->id-1] = 0;			// release id
+    timerFreeIds[timerFreeCount++] = t->id;
+    delete t;
+}
+
 
 //
 // Main timer functions for starting and killing timers
@@ -2670,13 +3408,11 @@ static void cleanupTimers()			// cleanup timer data structure
 
 int qStartTimer( int interval, QObject *obj )
 {
-    if ( !timerList )				// initialize timer data
+    if ( !timerObjDict )			// initialize timer data
 	initTimers();
-    int id = allocTimerId();			// get free timer id
-    if ( id <= 0 ||
-	 id > (int)timerBitVec->size() || !obj )// cannot create timer
+    if ( !obj )					// cannot create timer
 	return 0;
-    timerBitVec->setBit( id-1 );		// set timer active
+    int id = allocTimerId();			// get free timer id
     TimerInfo *t = new TimerInfo;		// create timer
     CHECK_PTR( t );
     t->id = id;
@@ -2686,46 +3422,68 @@ int qStartTimer( int interval, QObject *obj )
     getTime( currentTime );
     t->timeout = currentTime + t->interval;
     t->obj = obj;
-    insertTimer( t );				// put timer in list
+    coalesceTimer( t );
+    insertTimer( t );				// put timer in heap
+    timerIds[id-1] = t;
+    t->nextForObj = timerObjDict->find( obj );	// put timer first in chain
+    timerObjDict->replace( obj, t );
     return id;
 }
 
 bool qKillTimer( int id )
 {
-    register TimerInfo *t;
-    if ( !timerList || id <= 0 ||
-	 id > (int)timerBitVec->size() || !timerBitVec->testBit( id-1 ) )
+    if ( !timerObjDict || id <= 0 || id > timerIdHigh || !timerIds[id-1] )
 	return FALSE;				// not init'd or invalid timer
-    t = timerList->first();
-    while ( t && t->id != id )			// find timer info in list
-	t = timerList->next();
-    if ( t ) {					// id found
-	timerBitVec->clearBit( id-1 );		// set timer inactive
-	return timerList->remove();
-    }
-    else					// id not found
-	return FALSE;
+    removeTimer( timerIds[id-1] );
+    return TRUE;
 }
 
 bool qKillTimer( QObject *obj )
 {
-    register TimerInfo *t;
-    if ( !timerList )				// not initialized
+    if ( !timerObjDict )			// not initialized
 	return FALSE;
-    t = timerList->first();
-    while ( t ) {				// check all timers
-	if ( t->obj == obj ) {			// object found
-	    timerBitVec->clearBit( t->id-1 );
-	    timerList->remove();
-	    t = timerList->current();
-	} else {
-	    t = timerList->next();
-	}
-    }
+    TimerInfo *t;
+    while ( (t=timerObjDict->find(obj)) )	// kill all timers of obj
+	removeTimer( t );
     return TRUE;
 }
 
 
+/*!
+  Sets the timer tolerance to \a ms milliseconds.
+
+  If the tolerance is larger than zero, timers with intervals of at
+  least \a ms milliseconds may be activated up to \a ms milliseconds
+  late, so that timers which expire at about the same time are
+  activated together and the application wakes up less often.  Timers
+  with shorter intervals are not affected.
+
+  The default value is 0, which means that timers are activated as soon
+  as they expire.
+
+  \sa timerTolerance()
+*/
+
+void QApplication::setTimerTolerance( int ms )
+{
+    if ( ms < 0 )
+	ms = 0;
+    timerSlack.tv_sec  = ms/1000;
+    timerSlack.tv_usec = (ms%1000)*1000;
+}
+
+/*!
+  Returns the timer tolerance in milliseconds.
+
+  \sa setTimerTolerance()
+*/
+
+int QApplication::timerTolerance()
+{
+    return timerSlack.tv_sec*1000 + timerSlack.tv_usec/1000;
+}
+
+
 /*****************************************************************************
   Event translation; translates X11 events to Qt events
  *****************************************************************************/
@@ -3310,6 +4068,12 @@ bool QETWidget::translatePaintEvent( const XEvent *event )
 	    return TRUE;
     }
 
+    if ( dirtyRegions && dirtyRegions->find(this) ||
+	 paintBuffers && paintBuffers->find(topLevelWidget()) ) {
+	qt_x11AddDirtyRegion( this, paintRect );	// paint it together
+	return TRUE;					// with the updates
+    }
+
     QPaintEvent e( paintRect );
     setWFlags( WState_PaintEvent );
     QApplication::sendEvent( this, &e );
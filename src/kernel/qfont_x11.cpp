@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <unistd.h>
 #define GC GC_QQQ
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -57,6 +58,7 @@ enum FontFieldNames {				// X LFD fields
 
 // Internal functions
 
+static bool	parseXFontName( char *fontName, char **tokens );
 static bool	parseXFontName( QString &fontName, char **tokens );
 static char   **getXFontNames( const char *pattern, int *count );
 static bool	smoothlyScalable( const char *fontName );
@@ -69,13 +71,13 @@ static int	getWeight( const char *weightString, bool adjustScore=FALSE );
 class QFont_Private : public QFont
 {
 public:
-    int	    fontMatchScore( char *fontName, QString &buffer,
+    int	    fontMatchScore( char **tokens,
 			    float *pointSizeDiff, int *weightDiff,
 			    bool *scalable, bool *polymorphic,
 			    int *resx, int *resy );
     QString bestMatch( const char *pattern, int *score );
     QString bestFamilyMember( const char *family, int *score );
-    QString findFont( bool *exact );
+    QString findFont( bool *exact, bool *substituted );
 };
 
 #undef	PRIV
@@ -101,6 +103,7 @@ public:
     XFontStruct	   *fontStruct() const;
     const QFontDef *spec()  const;
     int		    lineWidth() const;
+    const short	   *charWidths();
     void	    reset();
 private:
     QFontInternal( const QString & );
@@ -108,6 +111,7 @@ private:
 
     QString	    n;
     XFontStruct	   *f;
+    short	   *cw;
     QFontDef	    s;
     int		    lw;
     int		    xres;
@@ -116,7 +120,7 @@ private:
 };
 
 inline QFontInternal::QFontInternal( const QString &name )
-    : n(name), f(0)
+    : n(name), f(0), cw(0)
 {
     s.dirty = TRUE;
 }
@@ -157,6 +161,10 @@ inline void QFontInternal::reset()
 	XFreeFont( QPaintDevice::x__Display(), f );
 	f = 0;
     }
+    if ( cw ) {
+	delete [] cw;
+	cw = 0;
+    }
 }
 
 inline QFontInternal::~QFontInternal()
@@ -192,20 +200,184 @@ void QFontCache::deleteItem( GCI d )
 
 struct QXFontName
 {
-    QXFontName( const QString &n, bool e ) : name(n), exactMatch(e) {}
+    QXFontName( const QString &n, bool e, bool c=FALSE, bool p=TRUE )
+	: name(n), exactMatch(e), fromFile(c), persistent(p) {}
     QString name;
     bool    exactMatch;
+    bool    fromFile;				// read from font name file
+    bool    persistent;				// may be written to the file
 };
 
 typedef Q_DECLARE(QDictM,QXFontName) QFontNameDict;
+typedef Q_DECLARE(QDictIteratorM,QXFontName) QFontNameDictIt;
+
+
+/*
+  QXFontList holds the result of XListFonts() for a pattern, with each
+  name split into its XLFD fields, so that matching many fonts against
+  the same family does not ask the X server or parse the names again.
+*/
+
+struct QXFontList
+{
+    QXFontList( const char *pattern );
+   ~QXFontList();
+    char **tokens( int i ) const { return fields + i*fontFields; }
+    int	    count;
+    char  **names;				// from XListFonts()
+    char  **fields;				// fontFields per name
+    char   *buf;				// parsed copies of the names
+    bool   *valid;				// name is an XLFD name
+};
+
+QXFontList::QXFontList( const char *pattern )
+{
+    names = getXFontNames( pattern, &count );
+    if ( !names )
+	count = 0;
+    int len = 0;
+    int i;
+    for ( i=0; i<count; i++ )
+	len += strlen( names[i] ) + 1;
+    buf	   = new char[len+1];
+    fields = new char*[count*fontFields+1];
+    valid  = new bool[count+1];
+    CHECK_PTR( buf );
+    CHECK_PTR( fields );
+    CHECK_PTR( valid );
+    char *p = buf;
+    for ( i=0; i<count; i++ ) {
+	strcpy( p, names[i] );
+	valid[i] = parseXFontName( p, tokens(i) );
+	p += strlen( names[i] ) + 1;
+    }
+}
+
+QXFontList::~QXFontList()
+{
+    if ( names )
+	XFreeFontNames( names );
+    delete [] buf;
+    delete [] fields;
+    delete [] valid;
+}
+
+typedef Q_DECLARE(QDictM,QXFontList) QXFontListDict;
 
 
 static QFontCache    *fontCache	     = 0;	// cache of loaded fonts
 static QFontDict     *fontDict	     = 0;	// dict of all loaded fonts
 static QFontNameDict *fontNameDict   = 0;	// dict of matched font names
+static QXFontListDict *fontListDict  = 0;	// dict of listed font names
+static int	      fontNamesAdded = 0;	// new names since file was read
 QFont		     *QFont::defFont = 0;	// default font
 
 
+/*****************************************************************************
+  The font name file remembers which X font was chosen for each font
+  request, so that a new process can skip XListFonts() and the matching.
+  The first line identifies the X server and its font path; the file is
+  ignored when they change.  The other lines hold a font key, a 0/1
+  exact match flag and the X font name, separated by tabs.
+
+  The file is shared by all applications, so names that depend on this
+  application's QFont::insertSubstitution() table or that were asked for
+  in raw mode are not written to it.
+ *****************************************************************************/
+
+static const int maxFileFontNames = 1000;
+
+static QString fontNameFile()
+{
+    QString f;
+    const char *home = getenv( "HOME" );
+    if ( home && *home ) {
+	f = home;
+	f += "/.qtfontcache";
+    }
+    return f;
+}
+
+static QString fontNameFileHeader()
+{
+    Display *dpy = QPaintDevice::x__Display();
+    QString h;
+    h.sprintf( "QtFontCache 1\t%s\t%d\t", ServerVendor(dpy),
+	       VendorRelease(dpy) );
+    int npaths;
+    char **paths = XGetFontPath( dpy, &npaths );
+    for ( int i=0; i<npaths; i++ ) {
+	if ( i )
+	    h += ',';
+	h += paths[i];
+    }
+    if ( paths )
+	XFreeFontPath( paths );
+    h += '\n';
+    return h;
+}
+
+static void readFontNameFile()
+{
+    QString fn = fontNameFile();
+    if ( fn.isEmpty() )
+	return;
+    FILE *f = fopen( fn, "r" );
+    if ( !f )
+	return;
+    char line[4096];
+    if ( fgets(line, sizeof(line), f) && fontNameFileHeader() == line ) {
+	while ( fgets(line, sizeof(line), f) ) {
+	    char *key = line;
+	    char *exact = strchr( key, '\t' );
+	    char *name = exact ? strchr( exact+1, '\t' ) : 0;
+	    char *end = name ? strchr( name+1, '\n' ) : 0;
+	    if ( !end || exact == key || end == name+1 )
+		continue;			// malformed or truncated
+	    *exact++ = '\0';
+	    *name++ = '\0';
+	    *end = '\0';
+	    if ( fontNameDict->find(key) )
+		continue;
+	    QXFontName *xfn = new QXFontName( name, *exact == '1', TRUE );
+	    CHECK_PTR( xfn );
+	    fontNameDict->insert( key, xfn );
+	}
+    }
+    fclose( f );
+    fontNamesAdded = 0;
+}
+
+static void writeFontNameFile()
+{
+    QString fn = fontNameFile();
+    if ( fn.isEmpty() || !fontNamesAdded )
+	return;
+    QString tmp;
+    tmp.sprintf( "%s.%d", (const char *)fn, (int)getpid() );
+    FILE *f = fopen( tmp, "w" );
+    if ( !f )
+	return;
+    fputs( fontNameFileHeader(), f );
+    QFontNameDictIt it( *fontNameDict );
+    int n = 0;
+    while ( it.current() && n < maxFileFontNames ) {
+	QXFontName *xfn = it.current();
+	if ( xfn->persistent ) {
+	    fprintf( f, "%s\t%d\t%s\n", it.currentKey(),
+		     xfn->exactMatch ? 1 : 0, (const char *)xfn->name );
+	    n++;
+	}
+	++it;
+    }
+    if ( fclose(f) == 0 )			// replace the file in one go
+	rename( tmp, fn );
+    else
+	remove( tmp );
+    fontNamesAdded = 0;
+}
+
+
 //
 // This function returns the X font struct for a QFontData.
 // It is called from QPainter::drawText().
@@ -240,6 +412,10 @@ void QFont::initialize()
     fontNameDict = new QFontNameDict( 29, TRUE, TRUE );
     CHECK_PTR( fontNameDict );
     fontNameDict->setAutoDelete( TRUE );
+    fontListDict = new QXFontListDict( 29, TRUE, TRUE );
+    CHECK_PTR( fontListDict );
+    fontListDict->setAutoDelete( TRUE );
+    readFontNameFile();
     if ( !defFont )
 	defFont = new QFont( TRUE );		// create the default font
 }
@@ -256,7 +432,10 @@ void QFont::cleanup()
     fontCache = 0;
     fontDict->setAutoDelete( TRUE );
     delete fontDict;
+    writeFontNameFile();
     delete fontNameDict;
+    delete fontListDict;
+    fontListDict = 0;
 }
 
 /*!
@@ -532,17 +711,20 @@ void QFont::load( HANDLE ) const
     if ( !fn ) {
 	QString name;
 	bool match;
+	bool substituted = TRUE;
 	if ( d->req.rawMode ) {
 	    name = substitute( family() );
 	    match = fontExists( name );
 	    if ( !match )
 		name = lastResortFont();
 	} else {
-	    name = PRIV->findFont( &match );
+	    name = PRIV->findFont( &match, &substituted );
 	}
-	fn = new QXFontName( name, match );
+	fn = new QXFontName( name, match, FALSE, !substituted );
 	CHECK_PTR( fn );
 	fontNameDict->insert( k, fn );
+	if ( fn->persistent )
+	    fontNamesAdded++;
     }
 
     QString n = fn->name;
@@ -558,6 +740,12 @@ void QFont::load( HANDLE ) const
     XFontStruct *f = d->fin->f;
     if ( !f ) {					// font not loaded
 	f = XLoadQueryFont( QPaintDevice::x__Display(), n );
+	if ( !f && fn->fromFile ) {		// font file has gone away
+	    fontNameDict->remove( k );
+	    fontNamesAdded++;
+	    load();				// match again
+	    return;
+	}
 	if ( !f ) {
 	    f = XLoadQueryFont( QPaintDevice::x__Display(), lastResortFont());
 	    fn->exactMatch = FALSE;
@@ -600,16 +788,15 @@ void QFont::load( HANDLE ) const
 #define WidthScore	 0x01
 
 //
-// Returns a score describing how well a font name matches the contents
-// of a font.
+// Returns a score describing how well a font name, split into its XLFD
+// fields, matches the contents of a font.
 //
 
-int QFont_Private::fontMatchScore( char	 *fontName,	 QString &buffer,
+int QFont_Private::fontMatchScore( char	**tokens,
 				   float *pointSizeDiff, int  *weightDiff,
 				   bool	 *scalable     , bool *polymorphic,
 				   int	 *resx	       , int  *resy )
 {
-    char *tokens[fontFields];
     bool   exactMatch = TRUE;
     int	   score      = 0;
     *scalable	      = FALSE;
@@ -617,10 +804,6 @@ int QFont_Private::fontMatchScore( char	 *fontName,	 QString &buffer,
     *weightDiff	      = 0;
     *pointSizeDiff    = 0;
 
-    strcpy( buffer.data(), fontName );	// NOTE: buffer must be large enough
-    if ( !parseXFontName( buffer, tokens ) )
-	return 0;	// Name did not conform to X Logical Font Description
-
     if ( strncmp( tokens[CharsetRegistry], "ksc", 3 ) == 0 &&
 		  isdigit( tokens[CharsetRegistry][3] )	  ||
 	 strncmp( tokens[CharsetRegistry], "jisx", 4 ) == 0  &&
@@ -805,9 +988,7 @@ QString QFont_Private::bestMatch( const char *pattern, int *score )
     MatchData	best;
     MatchData	bestScalable;
 
-    QString	matchBuffer( 256 );	// X font name always <= 255 chars
-    char **	xFontNames;
-    int		count;
+    QXFontList *xFontNames;
     int		sc;
     float	pointDiff;	// difference in % from requested point size
     int		weightDiff;	// difference from requested weight
@@ -817,10 +998,17 @@ QString QFont_Private::bestMatch( const char *pattern, int *score )
     bool	polymorphic = FALSE;
     int		i;
 
-    xFontNames = getXFontNames( pattern, &count );
+    xFontNames = fontListDict->find( pattern );
+    if ( !xFontNames ) {			// ask the server only once
+	xFontNames = new QXFontList( pattern );
+	CHECK_PTR( xFontNames );
+	fontListDict->insert( pattern, xFontNames );
+    }
 
-    for( i = 0; i < count; i++ ) {
-	sc = fontMatchScore( xFontNames[i], matchBuffer,
+    for( i = 0; i < xFontNames->count; i++ ) {
+	if ( !xFontNames->valid[i] )
+	    continue;		// name did not conform to X LFD
+	sc = fontMatchScore( xFontNames->tokens(i),
 			     &pointDiff, &weightDiff,
 			     &scalable, &polymorphic, &resx, &resy );
 	if ( sc > best.score ||
@@ -832,13 +1020,13 @@ QString QFont_Private::bestMatch( const char *pattern, int *score )
 		     sc == bestScalable.score &&
 			   weightDiff < bestScalable.weightDiff ) {
 		    bestScalable.score	    = sc;
-		    bestScalable.name	    = xFontNames[i];
+		    bestScalable.name	    = xFontNames->names[i];
 		    bestScalable.pointDiff  = pointDiff;
 		    bestScalable.weightDiff = weightDiff;
 		}
 	    } else {
 		best.score	= sc;
-		best.name	= xFontNames[i];
+		best.name	= xFontNames->names[i];
 		best.pointDiff	= pointDiff;
 		best.weightDiff = weightDiff;
 	    }
@@ -857,6 +1045,7 @@ QString QFont_Private::bestMatch( const char *pattern, int *score )
 		resy = 75;
 	    }
 	    best.score = bestScalable.score;
+	    QString matchBuffer( 256 );	// X font name always <= 255 chars
 	    strcpy( matchBuffer.data(), bestScalable.name );
 	    if ( parseXFontName( matchBuffer, tokens ) ) {
 		bestName.sprintf( "-%s-%s-%s-%s-%s-%s-*-%i-%i-%i-%s-*-%s-%s",
@@ -877,7 +1066,6 @@ QString QFont_Private::bestMatch( const char *pattern, int *score )
     }
     *score = best.score;
     bestName = best.name;
-    XFreeFontNames( xFontNames );
 
     return bestName;
 }
@@ -891,10 +1079,11 @@ QString QFont_Private::bestFamilyMember( const char *family, int *score )
 }
 
 
-QString QFont_Private::findFont( bool *exact )
+QString QFont_Private::findFont( bool *exact, bool *substituted )
 {
     QString familyName = family();
     *exact = TRUE;				// assume exact match
+    *substituted = FALSE;
     if ( familyName.isEmpty() ) {
 	familyName = defaultFamily();
 	*exact = FALSE;
@@ -907,7 +1096,8 @@ QString QFont_Private::findFont( bool *exact )
 
     if( score == 0 )
     {
-       QString f = substitute( family() );
+       *substituted = TRUE;		       // result depends on the
+       QString f = substitute( family() );     //   substitution table
        if( familyName != f ) {
            familyName = f;                     // try substitution
            bestName = bestFamilyMember( familyName, &score );
@@ -980,6 +1170,26 @@ void *QFontMetrics::fontStruct() const
     }
 }
 
+QFontInternal *QFontMetrics::fontInternal() const
+{
+    if ( type() == FontInternal ) {
+	return u.f;
+    } else if ( type() == Widget && u.w ) {
+	QFont *f = (QFont *)&u.w->font();
+	f->handle();
+	return f->d->fin;
+    } else if ( type() == Painter && u.p ) {
+	QFont *f = (QFont *)&u.p->font();
+	f->handle();
+	return f->d->fin;
+    } else {
+#if defined(CHECK_NULL)
+	warning( "QFontMetrics: Invalid font metrics" );
+#endif
+	return 0;
+    }
+}
+
 #undef	FS
 #define FS (type() == FontInternal ? u.f->fontStruct() : (XFontStruct*)fontStruct())
 
@@ -1226,7 +1436,15 @@ int QFontMetrics::width( const char *str, int len ) const
 {
     if ( len < 0 )
 	len = strlen( str );
-    return printerAdjusted(XTextWidth( FS, str, len ));
+    QFontInternal *fin = fontInternal();
+    const short *cw = fin ? fin->charWidths() : 0;
+    if ( !cw )
+	return printerAdjusted(XTextWidth( FS, str, len ));
+    register const uchar *p = (const uchar *)str;
+    register int w = 0;
+    while ( len-- )
+	w += cw[*p++];
+    return printerAdjusted(w);
 }
 
 
@@ -1419,12 +1637,21 @@ const QFontDef *QFontInfo::spec() const
 
 static bool parseXFontName( QString &fontName, char **tokens )
 {
-    if ( fontName.isEmpty() || fontName[0] != '-' ) {
+    if ( fontName.isEmpty() ) {
+	tokens[0] = 0;
+	return FALSE;
+    }
+    return parseXFontName( fontName.data(), tokens );
+}
+
+static bool parseXFontName( char *fontName, char **tokens )
+{
+    if ( fontName[0] != '-' ) {
 	tokens[0] = 0;
 	return FALSE;
     }
     int	  i;
-    char *f = fontName.data() + 1;
+    char *f = fontName + 1;
     for ( i=0; i<fontFields && f && f[0]; i++ ) {
 	tokens[i] = f;
 	f = strchr( f, '-' );
@@ -1483,6 +1710,27 @@ static bool fontExists( const char *fontName )
 }
 
 
+//
+// Returns the advance widths of the 256 8-bit characters, computed the
+// first time they are needed.  Characters that are not in the font get
+// the same width as XTextWidth() would give them.
+//
+
+const short *QFontInternal::charWidths()
+{
+    if ( !cw && f ) {
+	cw = new short[256];
+	CHECK_PTR( cw );
+	char c;
+	for ( int i=0; i<256; i++ ) {
+	    c = (char)i;
+	    cw[i] = XTextWidth( f, &c, 1 );
+	}
+    }
+    return cw;
+}
+
+
 //
 // Computes the line width (underline,strikeout) for the X font
 // and fills in the X resolution of the font.
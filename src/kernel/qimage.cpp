@@ -34,6 +34,14 @@
 #include "qasyncimageio.h"
 #include <stdlib.h>
 #include <ctype.h>
+#include <math.h>
+#if defined(QT_THREAD_SUPPORT)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /*!
   \class QImage qimage.h
@@ -824,15 +832,524 @@ void QImage::freeBits()
 }
 
 
+/*****************************************************************************
+  Row band dispatching for the image scaling and conversion functions
+ *****************************************************************************/
+
+typedef void (*QImageRowFunc)( void *arg, int from, int to );
+
+#if defined(QT_THREAD_SUPPORT)
+
+struct QImageRowJob {
+    QImageRowFunc func;
+    void *arg;
+    int	  from;
+    int	  to;
+};
+
+static void *qt_image_row_thread( void *arg )
+{
+    QImageRowJob *job = (QImageRowJob *)arg;
+    (*job->func)( job->arg, job->from, job->to );
+    return 0;
+}
+
+static int qt_image_threads()
+{
+    static int nthreads = 0;
+    if ( nthreads == 0 ) {
+	long n = 1;
+#if defined(_SC_NPROCESSORS_ONLN)
+	n = sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+	if ( n < 1 )
+	    n = 1;
+	if ( n > 8 )				// memory bound beyond that
+	    n = 8;
+	nthreads = (int)n;
+    }
+    return nthreads;
+}
+
+#endif // QT_THREAD_SUPPORT
+
+/*
+  Calls \a func for consecutive bands of the rows [0,rows).  \a cost is
+  a rough measure of the work needed for a single row (in pixel
+  operations).  Large jobs are split across the available processors
+  when Qt is built with thread support, the calling thread takes the
+  first band.  \a func must not touch any shared state except the rows
+  it is given.
+*/
+
+static void qt_image_rows( QImageRowFunc func, void *arg, int rows, int cost )
+{
+    if ( rows <= 0 )
+	return;
+#if defined(QT_THREAD_SUPPORT)
+    const int minwork = 128*1024;		// not worth a thread below this
+    int n = qt_image_threads();
+    if ( cost < 1 )
+	cost = 1;
+    if ( n > 1 && (long)rows*cost >= 2*minwork ) {
+	if ( (long)rows*cost/minwork < n )
+	    n = (int)((long)rows*cost/minwork);
+	if ( n > rows )
+	    n = rows;
+	QImageRowJob jobs[8];
+	pthread_t    tids[8];
+	bool	     started[8];
+	int i;
+	for ( i=0; i<n; i++ ) {
+	    jobs[i].func = func;
+	    jobs[i].arg	 = arg;
+	    jobs[i].from = (int)((long)rows*i/n);
+	    jobs[i].to	 = (int)((long)rows*(i+1)/n);
+	    started[i] = FALSE;
+	}
+	for ( i=1; i<n; i++ )
+	    started[i] = pthread_create( &tids[i], 0, qt_image_row_thread,
+					 &jobs[i] ) == 0;
+	qt_image_row_thread( &jobs[0] );
+	for ( i=1; i<n; i++ ) {
+	    if ( started[i] )
+		pthread_join( tids[i], 0 );
+	    else				// could not start, do it here
+		qt_image_row_thread( &jobs[i] );
+	}
+	return;
+    }
+#endif
+    (*func)( arg, 0, rows );
+}
+
+
 /*****************************************************************************
   Internal routines for converting image depth.
  *****************************************************************************/
 
+/*****************************************************************************
+  Palette quantization for convert_32_to_8()
+
+  Images with too many colors for an 8-bit image are mapped to a palette
+  of at most 256 colors.  The palette is either the one given to
+  convertDepthWithPalette(), the fixed 6x6x6 color cube (when dithering
+  is preferred, as for 8-bit displays, so that all pixmaps share the
+  same colors) or an adaptive palette found by median cut.
+
+  A median cut works on a histogram of 5 bits per channel, so both
+  building the histogram and mapping the pixels are linear in the number
+  of pixels.  Pixels are mapped through an inverse color cube of the
+  same resolution, which holds the nearest palette entry of each cell.
+  Everything except error diffusion is done in bands of scanlines that
+  may run in parallel.
+ *****************************************************************************/
+
+#define QT_QCUBE_CELLS 32768			// 5 bits per channel
+#define QT_QCUBE_CHUNKS	8			// histogram bands
+
+static inline int qt_qcube_index( int r, int g, int b )
+{
+    return (r << 10) | (g << 5) | b;
+}
+
+static inline int qt_qcube_cell( QRgb rgb )
+{
+    return qt_qcube_index( qRed(rgb) >> 3, qGreen(rgb) >> 3, qBlue(rgb) >> 3 );
+}
+
+struct QImageQuant {
+    const QImage *src;
+    QImage	 *dst;
+    const QRgb	 *pal;				// the palette
+    int		  ncols;
+    uchar	 *cube;				// inverse color cube
+    uint	 *hist;				// QT_QCUBE_CHUNKS histograms
+    int		  spread;			// ordered dither amplitude
+    uint	(*bm)[16];			// Bayer matrix
+};
+
+static void qt_quant_hist_rows( void *arg, int from, int to )
+{
+    QImageQuant *q = (QImageQuant *)arg;
+    int h = q->src->height();
+    int w = q->src->width();
+    for ( int c=from; c<to; c++ ) {		// "rows" are chunks here
+	uint *hist = q->hist + c*QT_QCUBE_CELLS;
+	int y1 = h*c/QT_QCUBE_CHUNKS;
+	int y2 = h*(c+1)/QT_QCUBE_CHUNKS;
+	for ( int y=y1; y<y2; y++ ) {
+	    register const QRgb *p = (const QRgb *)q->src->scanLine( y );
+	    register const QRgb *end = p + w;
+	    while ( p < end ) {
+		hist[qt_qcube_cell(*p)]++;
+		p++;
+	    }
+	}
+    }
+}
+
+struct QQuantBox {
+    int	 lo[3];					// cell bounds, r, g, b
+    int	 hi[3];
+    uint count;
+};
+
+/*
+  Shrinks the box to the cells actually used and counts its pixels.
+*/
+
+static void qt_quant_shrink( QQuantBox *box, const uint *hist )
+{
+    int lo[3] = { 32, 32, 32 };
+    int hi[3] = { -1, -1, -1 };
+    uint count = 0;
+    for ( int r=box->lo[0]; r<=box->hi[0]; r++ )
+	for ( int g=box->lo[1]; g<=box->hi[1]; g++ )
+	    for ( int b=box->lo[2]; b<=box->hi[2]; b++ ) {
+		uint n = hist[qt_qcube_index(r,g,b)];
+		if ( !n )
+		    continue;
+		count += n;
+		if ( r < lo[0] ) lo[0] = r;
+		if ( r > hi[0] ) hi[0] = r;
+		if ( g < lo[1] ) lo[1] = g;
+		if ( g > hi[1] ) hi[1] = g;
+		if ( b < lo[2] ) lo[2] = b;
+		if ( b > hi[2] ) hi[2] = b;
+	    }
+    box->count = count;
+    if ( count ) {
+	for ( int i=0; i<3; i++ ) {
+	    box->lo[i] = lo[i];
+	    box->hi[i] = hi[i];
+	}
+    }
+}
+
+/*
+  Finds at most \a maxcols colors representing the histogram \a hist
+  and stores them in \a pal.  Returns the number of colors found.
+*/
+
+static int qt_median_cut( const uint *hist, QRgb *pal, int maxcols )
+{
+    QQuantBox boxes[256];
+    int nboxes = 1;
+    boxes[0].lo[0] = boxes[0].lo[1] = boxes[0].lo[2] = 0;
+    boxes[0].hi[0] = boxes[0].hi[1] = boxes[0].hi[2] = 31;
+    qt_quant_shrink( &boxes[0], hist );
+    if ( boxes[0].count == 0 )
+	return 0;
+
+    uint slice[32];
+    while ( nboxes < maxcols ) {
+	int best = -1;				// most populated splittable box
+	int i;
+	for ( i=0; i<nboxes; i++ ) {
+	    QQuantBox *b = &boxes[i];
+	    if ( b->lo[0] == b->hi[0] && b->lo[1] == b->hi[1] &&
+		 b->lo[2] == b->hi[2] )
+		continue;
+	    if ( best < 0 || b->count > boxes[best].count )
+		best = i;
+	}
+	if ( best < 0 )
+	    break;				// every box is a single cell
+	QQuantBox *b = &boxes[best];
+	int axis = 0;				// split along the longest side
+	for ( i=1; i<3; i++ ) {
+	    if ( b->hi[i] - b->lo[i] > b->hi[axis] - b->lo[axis] )
+		axis = i;
+	}
+	for ( i=b->lo[axis]; i<=b->hi[axis]; i++ )
+	    slice[i] = 0;
+	int c[3];
+	for ( c[0]=b->lo[0]; c[0]<=b->hi[0]; c[0]++ )
+	    for ( c[1]=b->lo[1]; c[1]<=b->hi[1]; c[1]++ )
+		for ( c[2]=b->lo[2]; c[2]<=b->hi[2]; c[2]++ )
+		    slice[c[axis]] += hist[qt_qcube_index(c[0],c[1],c[2])];
+	uint sum = 0;
+	int split = b->lo[axis];
+	while ( split < b->hi[axis]-1 ) {	// find the median slice
+	    sum += slice[split];
+	    if ( sum >= b->count/2 )
+		break;
+	    split++;
+	}
+	QQuantBox *n = &boxes[nboxes++];
+	*n = *b;
+	b->hi[axis] = split;
+	n->lo[axis] = split+1;
+	qt_quant_shrink( b, hist );
+	qt_quant_shrink( n, hist );
+    }
+
+    for ( int i=0; i<nboxes; i++ ) {		// mean color of each box
+	QQuantBox *b = &boxes[i];
+	double r = 0, g = 0, bl = 0;
+	for ( int cr=b->lo[0]; cr<=b->hi[0]; cr++ )
+	    for ( int cg=b->lo[1]; cg<=b->hi[1]; cg++ )
+		for ( int cb=b->lo[2]; cb<=b->hi[2]; cb++ ) {
+		    uint n = hist[qt_qcube_index(cr,cg,cb)];
+		    r  += (double)n * ((cr << 3) | 4);
+		    g  += (double)n * ((cg << 3) | 4);
+		    bl += (double)n * ((cb << 3) | 4);
+		}
+	pal[i] = qRgb( (int)(r/b->count + 0.5), (int)(g/b->count + 0.5),
+		       (int)(bl/b->count + 0.5) );
+    }
+    return nboxes;
+}
+
+/*
+  Fills the red slices [from,to) of the inverse color cube.
+*/
+
+static void qt_quant_cube_rows( void *arg, int from, int to )
+{
+    QImageQuant *q = (QImageQuant *)arg;
+    for ( int r=from; r<to; r++ ) {
+	int rv = (r << 3) | 4;
+	for ( int g=0; g<32; g++ ) {
+	    int gv = (g << 3) | 4;
+	    for ( int b=0; b<32; b++ ) {
+		int bv = (b << 3) | 4;
+		int best = 0;
+		int bestdist = 3*256*256;		// more than any distance
+		for ( int i=0; i<q->ncols; i++ ) {
+		    QRgb c = q->pal[i];
+		    int dr = qRed(c) - rv;
+		    int dg = qGreen(c) - gv;
+		    int db = qBlue(c) - bv;
+		    int dist = dr*dr + dg*dg + db*db;
+		    if ( dist < bestdist ) {
+			bestdist = dist;
+			best = i;
+		    }
+		}
+		q->cube[qt_qcube_index(r,g,b)] = best;
+	    }
+	}
+    }
+}
+
+static inline int qt_quant_clamp( int v )
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+/*
+  Maps the rows [from,to) through the inverse color cube, with threshold
+  or ordered dithering.
+*/
+
+static void qt_quant_map_rows( void *arg, int from, int to )
+{
+    QImageQuant *q = (QImageQuant *)arg;
+    int w = q->src->width();
+    bool ordered = q->bm != 0;
+    for ( int y=from; y<to; y++ ) {
+	register const QRgb *p = (const QRgb *)q->src->scanLine( y );
+	register uchar *b = q->dst->scanLine( y );
+	if ( !ordered ) {
+	    for ( int x=0; x<w; x++ )
+		b[x] = q->cube[qt_qcube_cell(p[x])];
+	    continue;
+	}
+	for ( int x=0; x<w; x++ ) {
+	    int d = (((int)(q->bm[y&15][x&15] >> 8) - 128) * q->spread) >> 8;
+	    int r = qt_quant_clamp( qRed(p[x]) + d );
+	    int g = qt_quant_clamp( qGreen(p[x]) + d );
+	    int bl = qt_quant_clamp( qBlue(p[x]) + d );
+	    b[x] = q->cube[qt_qcube_index(r >> 3, g >> 3, bl >> 3)];
+	}
+    }
+}
+
+/*
+  Maps the image through the inverse color cube with bi-directional
+  error diffusion.  This one cannot be split into bands.
+*/
+
+static void qt_quant_diffuse( QImageQuant *q )
+{
+    int w = q->src->width();
+    int h = q->src->height();
+    int n = 3*(w+2);				// one pixel of border each side
+    int *cur = new int[n];
+    int *nxt = new int[n];
+    memset( cur, 0, n*sizeof(int) );
+    for ( int y=0; y<h; y++ ) {
+	const QRgb *p = (const QRgb *)q->src->scanLine( y );
+	uchar *b = q->dst->scanLine( y );
+	memset( nxt, 0, n*sizeof(int) );
+	int dir = (y & 1) ? -1 : 1;
+	int x = (y & 1) ? w-1 : 0;
+	for ( int i=0; i<w; i++, x+=dir ) {
+	    int *e = cur + 3*(x+1);
+	    int *f = nxt + 3*(x+1);
+	    int v[3];
+	    v[0] = qt_quant_clamp( qRed(p[x]) + e[0] );
+	    v[1] = qt_quant_clamp( qGreen(p[x]) + e[1] );
+	    v[2] = qt_quant_clamp( qBlue(p[x]) + e[2] );
+	    int pix = q->cube[qt_qcube_index(v[0] >> 3, v[1] >> 3, v[2] >> 3)];
+	    b[x] = pix;
+	    QRgb c = q->pal[pix];
+	    int err[3];
+	    err[0] = v[0] - qRed( c );
+	    err[1] = v[1] - qGreen( c );
+	    err[2] = v[2] - qBlue( c );
+	    for ( int k=0; k<3; k++ ) {		// spread the error around...
+		e[3*dir+k] += (err[k]*7) >> 4;
+		f[3*dir+k] += err[k] >> 4;
+		f[k]	   += (err[k]*5) >> 4;
+		f[k-3*dir] += (err[k]*3) >> 4;
+	    }
+	}
+	int *t = cur;
+	cur = nxt;
+	nxt = t;
+    }
+    delete [] cur;
+    delete [] nxt;
+}
+
+/*
+  Converts \a src to \a dst, which has the \a ncols colors \a pal, using
+  the dither method in \a conversion_flags.
+*/
+
+static void qt_quantize( const QImage *src, QImage *dst, int conversion_flags,
+			 const QRgb *pal, int ncols, uint (*bm)[16] )
+{
+    QImageQuant q;
+    q.src = src;
+    q.dst = dst;
+    q.pal = pal;
+    q.ncols = ncols;
+    q.hist = 0;
+    q.bm = 0;
+    q.cube = new uchar[QT_QCUBE_CELLS];
+    CHECK_PTR( q.cube );
+    qt_image_rows( qt_quant_cube_rows, &q, 32, 1024*ncols );
+    switch ( conversion_flags & Dither_Mask ) {
+	case OrderedDither:
+	    q.bm = bm;
+	    q.spread = 256;
+	    while ( q.spread > 16 &&
+		    (256/q.spread+1)*(256/q.spread+1)*(256/q.spread+1) <= ncols )
+		q.spread /= 2;			// about the palette spacing
+	    // fall through
+	case ThresholdDither:
+	    qt_image_rows( qt_quant_map_rows, &q, src->height(), src->width() );
+	    break;
+	default:
+	    qt_quant_diffuse( &q );
+	    break;
+    }
+    delete [] q.cube;
+}
+
+/*
+  Finds an adaptive palette of at most 256 colors for \a src.
+*/
+
+static int qt_adaptive_palette( const QImage *src, QRgb *pal )
+{
+    QImageQuant q;
+    q.src = src;
+    q.hist = new uint[QT_QCUBE_CHUNKS*QT_QCUBE_CELLS];
+    CHECK_PTR( q.hist );
+    memset( q.hist, 0, QT_QCUBE_CHUNKS*QT_QCUBE_CELLS*sizeof(uint) );
+    qt_image_rows( qt_quant_hist_rows, &q, QT_QCUBE_CHUNKS,
+		   src->width()*src->height()/QT_QCUBE_CHUNKS );
+    uint *hist = q.hist;			// merge the bands
+    for ( int c=1; c<QT_QCUBE_CHUNKS; c++ ) {
+	uint *h = q.hist + c*QT_QCUBE_CELLS;
+	for ( int i=0; i<QT_QCUBE_CELLS; i++ )
+	    hist[i] += h[i];
+    }
+    int n = qt_median_cut( hist, pal, 256 );
+    delete [] q.hist;
+    return n;
+}
+
+#undef QT_QCUBE_CHUNKS
+
+
+/*
+  Threshold and ordered dithering of the rows [from,to) to the fixed
+  6x6x6 color cube.
+*/
+
+static void qt_cube_dither_rows( void *arg, int from, int to )
+{
+#define MAX_R 5
+#define MAX_G 5
+#define MAX_B 5
+#define INDEXOF(r,g,b) (((r)*(MAX_G+1)+(g))*(MAX_B+1)+(b))
+    QImageQuant *q = (QImageQuant *)arg;
+    int sw = q->src->width();
+    int rc, gc, bc;
+    for ( int y=from; y<to; y++ ) {
+	register QRgb *p = (QRgb *)q->src->scanLine(y);
+	uchar *b = q->dst->scanLine(y);
+	QRgb *end = p + sw;
+
+	if ( !q->bm ) {
+#define DITHER(p,m) ((uchar) ((p * (m) + 127) / 255))
+	    while ( p < end ) {
+		rc = qRed( *p );
+		gc = qGreen( *p );
+		bc = qBlue( *p );
+
+		*b++ =
+		    INDEXOF(
+			DITHER(rc, MAX_R),
+			DITHER(gc, MAX_G),
+			DITHER(bc, MAX_B)
+		    );
+
+		p++;
+	    }
+#undef DITHER
+	} else {
+#define DITHER(p,d,m) ((uchar) ((((256 * (m) + (m) + 1)) * (p) + (d)) / 65536 ))
+
+	    int x = 0;
+	    while ( p < end ) {
+		uint d = q->bm[y&15][x&15];
+
+		rc = qRed( *p );
+		gc = qGreen( *p );
+		bc = qBlue( *p );
+
+		*b++ =
+		    INDEXOF(
+			DITHER(rc, d, MAX_R),
+			DITHER(gc, d, MAX_G),
+			DITHER(bc, d, MAX_B)
+		    );
+
+		p++;
+		x++;
+	    }
+#undef DITHER
+	}
+    }
+#undef MAX_R
+#undef MAX_G
+#undef MAX_B
+#undef INDEXOF
+}
+
 //
 // convert_32_to_8:  Converts a 32 bits depth (true color) to an 8 bit
 // image with a colormap.  If the 32 bit image has more than 256 colors,
-// we convert the red,green and blue bytes into a single byte encoded
-// as 6 shades of each of red, green and blue.
+// we quantize it to the given palette, or to an adaptive palette.  When
+// dithering is preferred we convert the red,green and blue bytes into a
+// single byte encoded as 6 shades of each of red, green and blue.
 //
 
 Q_DECLARE(QIntDictM,char);
@@ -889,6 +1406,7 @@ static bool convert_32_to_8( const QImage *src, QImage *dst, int conversion_flag
 	    p++;
 	}
     }
+    int npal = pix;
 
     if ( (conversion_flags & DitherMode_Mask) == PreferDither ) {
 	do_quant = TRUE;
@@ -958,6 +1476,24 @@ static bool convert_32_to_8( const QImage *src, QImage *dst, int conversion_flag
 		bm[i][j]<<=8;
     }
 
+    if ( do_quant && ( (palette && npal > 0) ||
+		       (conversion_flags & DitherMode_Mask) != PreferDither ) ) {
+	QRgb pal[256];				// quantize to a palette
+	if ( palette && npal > 0 ) {
+	    ncols = npal;
+	    for ( int i=0; i<ncols; i++ )
+		pal[i] = dst->color( i );
+	    dst->setNumColors( ncols );
+	} else {
+	    ncols = qt_adaptive_palette( src, pal );
+	    dst->setNumColors( ncols );
+	    for ( int i=0; i<ncols; i++ )
+		dst->setColor( i, pal[i] );
+	}
+	qt_quantize( src, dst, conversion_flags, pal, ncols, bm );
+	return TRUE;
+    }
+
     dst->setNumColors( ncols );
 
     if ( do_quant ) {				// quantization needed
@@ -993,52 +1529,15 @@ static bool convert_32_to_8( const QImage *src, QImage *dst, int conversion_flag
 	    pv[2] = new int[sw];
 	}
 
-	for ( y=0; y < src->height(); y++ ) {
-	    p = (QRgb *)src->scanLine(y);
-	    b = dst->scanLine(y);
-	    QRgb *end = p + sw;
-
-	    // perform quantization
-	    if ( ( conversion_flags & Dither_Mask ) == ThresholdDither ) {
-#define DITHER(p,m) ((uchar) ((p * (m) + 127) / 255))
-		while ( p < end ) {
-		    rc = qRed( *p );
-		    gc = qGreen( *p );
-		    bc = qBlue( *p );
-
-		    *b++ =
-			INDEXOF(
-			    DITHER(rc, MAX_R),
-			    DITHER(gc, MAX_G),
-			    DITHER(bc, MAX_B)
-			);
-
-		    p++;
-		}
-#undef DITHER
-	    } else if ( ( conversion_flags & Dither_Mask ) == OrderedDither ) {
-#define DITHER(p,d,m) ((uchar) ((((256 * (m) + (m) + 1)) * (p) + (d)) / 65536 ))
-
-		int x = 0;
-		while ( p < end ) {
-		    uint d = bm[y&15][x&15];
-
-		    rc = qRed( *p );
-		    gc = qGreen( *p );
-		    bc = qBlue( *p );
-
-		    *b++ =
-			INDEXOF(
-			    DITHER(rc, d, MAX_R),
-			    DITHER(gc, d, MAX_G),
-			    DITHER(bc, d, MAX_B)
-			);
-
-		    p++;
-		    x++;
-		}
-#undef DITHER
-	    } else { // Diffuse
+	if ( ( conversion_flags & Dither_Mask ) == ThresholdDither ||
+	     ( conversion_flags & Dither_Mask ) == OrderedDither ) {
+	    QImageQuant q;			// perform quantization in bands
+	    q.src = src;
+	    q.dst = dst;
+	    q.bm = ( conversion_flags & Dither_Mask ) == OrderedDither ? bm : 0;
+	    qt_image_rows( qt_cube_dither_rows, &q, src->height(), sw );
+	} else {				// Diffuse
+	    for ( y=0; y < src->height(); y++ ) {
 		int endian = (QImage::systemByteOrder() == QImage::BigEndian);
 		int x;
 		uchar* q = src->scanLine(y);
@@ -1770,8 +2269,15 @@ inline QRgb qRgba(int r, int g, int b, int a)
     return qRgb(r,g,b) | (a<<24);
 }
 
+/*
+  Scales the rows [from,to) of dst from src.  The state of the vertical
+  accumulation at row \a from is computed without touching any pixels,
+  so that bands of rows can be scaled independently and give exactly
+  the same result as scaling the whole image in one go.
+*/
+
 static
-void pnmscale(const QImage& src, QImage& dst)
+void pnmscale(const QImage& src, QImage& dst, int from, int to)
 {
 #define SCALE 4096
 #define HALFSCALE 2048
@@ -1790,7 +2296,7 @@ void pnmscale(const QImage& src, QImage& dst)
     long* rs;
     long* gs;
     long* bs;
-    int rowswritten = 0;
+    int rowswritten = from;
 
     cols = src.width();
     rows = src.height();
@@ -1807,7 +2313,6 @@ void pnmscale(const QImage& src, QImage& dst)
 	tempxelrow = new QRgb[cols];
 
     if ( src.hasAlphaBuffer() ) {
-	dst.setAlphaBuffer(TRUE);
 	as = new long[cols];
 	for ( col = 0; col < cols; ++col )
 	    as[col] = HALFSCALE;
@@ -1824,7 +2329,33 @@ void pnmscale(const QImage& src, QImage& dst)
 	rs[col] = gs[col] = bs[col] = HALFSCALE;
     fracrowtofill = SCALE;
 
-    for ( row = 0; row < newrows; ++row ) {
+    for ( row = 0; row < from; ++row ) {	// skip rows of other bands
+	if ( newrows == rows ) {
+	    rowsread++;
+	    continue;
+	}
+	while ( fracrowleft < fracrowtofill ) {
+	    if ( needtoreadrow && rowsread < rows )
+		rowsread++;
+	    fracrowtofill -= fracrowleft;
+	    fracrowleft = syscale;
+	    needtoreadrow = 1;
+	}
+	if ( needtoreadrow && rowsread < rows ) {
+	    rowsread++;
+	    needtoreadrow = 0;
+	}
+	fracrowleft -= fracrowtofill;
+	if ( fracrowleft == 0 ) {
+	    fracrowleft = syscale;
+	    needtoreadrow = 1;
+	}
+	fracrowtofill = SCALE;
+    }
+    if ( rowsread > 0 )				// last row read before band
+	xelrow = (QRgb*)src.scanLine(rowsread-1);
+
+    for ( row = from; row < to; ++row ) {
 	/* First scale Y from xelrow into tempxelrow. */
 	if ( newrows == rows ) {
 	    /* shortcut Y scaling if possible */
@@ -1978,6 +2509,256 @@ void pnmscale(const QImage& src, QImage& dst)
 #undef HALFSCALE
 }
 
+/*
+  Band entry point of the box filter (see pnmscale() above).
+*/
+
+struct QImageBoxScale {
+    const QImage *src;
+    QImage	 *dst;
+};
+
+static void qt_box_scale_rows( void *arg, int from, int to )
+{
+    QImageBoxScale *s = (QImageBoxScale *)arg;
+    pnmscale( *s->src, *s->dst, from, to );
+}
+
+
+/*****************************************************************************
+  Separable bilinear and Lanczos scaling
+
+  The filter weights for every destination column and row are computed
+  once and stored as 14-bit fixed-point numbers that sum up to exactly
+  1.0, so a constant area stays constant.  The image is first scaled
+  horizontally into a temporary image of the destination width, then
+  vertically.  All four channels are filtered independently, like
+  pnmscale() does.
+ *****************************************************************************/
+
+#define QT_SCALE_BITS	14
+#define QT_SCALE_ONE	(1 << QT_SCALE_BITS)
+
+struct QImageScaleWeights {
+    int	   taps;			// number of weights per sample
+    int	  *first;			// first source pixel of sample i
+    short *w;				// weights, taps per sample
+};
+
+static double qt_scale_kernel( QImage::ScaleFilter filter, double x )
+{
+    if ( x < 0 )
+	x = -x;
+    if ( filter == QImage::BilinearFilter )
+	return x < 1.0 ? 1.0 - x : 0.0;
+    if ( x < 1e-8 )				// Lanczos, a = 3
+	return 1.0;
+    if ( x >= 3.0 )
+	return 0.0;
+    const double pi = 3.14159265358979323846;
+    double px = pi * x;
+    return 3.0 * sin(px) * sin(px/3.0) / (px*px);
+}
+
+static void qt_scale_weights( QImageScaleWeights *sw, int src, int dst,
+			      QImage::ScaleFilter filter )
+{
+    double scale   = (double)dst / (double)src;
+    double support = filter == QImage::BilinearFilter ? 1.0 : 3.0;
+    double stretch = scale < 1.0 ? 1.0/scale : 1.0; // widen when shrinking
+    double radius  = support * stretch;
+    int	   ntaps   = (int)ceil( radius ) * 2 + 1;
+    int	   taps	   = QMIN( ntaps, src );
+    double *fw	   = new double[taps];
+    sw->taps  = taps;
+    sw->first = new int[dst];
+    sw->w     = new short[dst*taps];
+    CHECK_PTR( sw->w );
+    for ( int i=0; i<dst; i++ ) {
+	double center = (i + 0.5) / scale - 0.5;
+	int left = (int)floor( center - radius ) + 1;
+	int lo	 = left < 0 ? 0 : left;		// clamp window to image
+	if ( lo > src - taps )
+	    lo = src - taps;
+	int j;
+	for ( j=0; j<taps; j++ )
+	    fw[j] = 0.0;
+	double sum = 0.0;
+	for ( j=left; j<left+ntaps; j++ ) {
+	    double v = qt_scale_kernel( filter, (j - center) / stretch );
+	    int jj = j < 0 ? 0 : (j >= src ? src-1 : j); // replicate edges
+	    fw[jj-lo] += v;
+	    sum += v;
+	}
+	short *w = sw->w + i*taps;
+	int total = 0, big = 0;
+	for ( j=0; j<taps; j++ ) {
+	    double v = sum != 0.0 ? fw[j] / sum : (j == 0 ? 1.0 : 0.0);
+	    w[j] = (short)floor( v*QT_SCALE_ONE + 0.5 );
+	    total += w[j];
+	    if ( w[j] > w[big] )
+		big = j;
+	}
+	w[big] += QT_SCALE_ONE - total;		// sum must be exactly 1.0
+	sw->first[i] = lo;
+    }
+    delete [] fw;
+}
+
+static void qt_free_scale_weights( QImageScaleWeights *sw )
+{
+    delete [] sw->first;
+    delete [] sw->w;
+}
+
+static inline uint qt_scale_clamp( int v )
+{
+    v = (v + QT_SCALE_ONE/2) >> QT_SCALE_BITS;
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+struct QImageFilterScale {
+    const QImage *src;
+    QImage	 *dst;
+    QRgb	 *tmp;			// src height rows of dst width
+    QImageScaleWeights xw;
+    QImageScaleWeights yw;
+};
+
+/*
+  Horizontal pass: source rows [from,to) into the temporary image.
+*/
+
+static void qt_filter_scale_x( void *arg, int from, int to )
+{
+    QImageFilterScale *s = (QImageFilterScale *)arg;
+    int w    = s->dst->width();
+    int taps = s->xw.taps;
+    for ( int y=from; y<to; y++ ) {
+	const QRgb *sl = (const QRgb *)s->src->scanLine( y );
+	QRgb *dl = s->tmp + y*w;
+	for ( int x=0; x<w; x++ ) {
+	    const QRgb  *p  = sl + s->xw.first[x];
+	    const short *wt = s->xw.w + x*taps;
+	    int k;
+#if defined(__SSE2__)
+	    __m128i z	= _mm_setzero_si128();
+	    __m128i acc = _mm_set1_epi32( QT_SCALE_ONE/2 );
+	    for ( k=0; k+1<taps; k+=2 ) {	// two taps per madd
+		__m128i a = _mm_unpacklo_epi8( _mm_cvtsi32_si128(p[k]), z );
+		__m128i b = _mm_unpacklo_epi8( _mm_cvtsi32_si128(p[k+1]), z );
+		__m128i c = _mm_set1_epi32( (ushort)wt[k] | ((uint)(ushort)wt[k+1] << 16) );
+		acc = _mm_add_epi32( acc,
+				     _mm_madd_epi16(_mm_unpacklo_epi16(a,b),c) );
+	    }
+	    if ( k < taps ) {
+		__m128i a = _mm_unpacklo_epi8( _mm_cvtsi32_si128(p[k]), z );
+		__m128i c = _mm_set1_epi32( (ushort)wt[k] );
+		acc = _mm_add_epi32( acc,
+				     _mm_madd_epi16(_mm_unpacklo_epi16(a,z),c) );
+	    }
+	    acc = _mm_srai_epi32( acc, QT_SCALE_BITS );
+	    acc = _mm_packs_epi32( acc, acc );
+	    dl[x] = _mm_cvtsi128_si32( _mm_packus_epi16(acc, acc) );
+#else
+	    int c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+	    for ( k=0; k<taps; k++ ) {
+		QRgb v = p[k];
+		c0 += wt[k] * (int)(v & 0xff);
+		c1 += wt[k] * (int)((v >> 8) & 0xff);
+		c2 += wt[k] * (int)((v >> 16) & 0xff);
+		c3 += wt[k] * (int)(v >> 24);
+	    }
+	    dl[x] = qt_scale_clamp(c0) | (qt_scale_clamp(c1) << 8) |
+		    (qt_scale_clamp(c2) << 16) | (qt_scale_clamp(c3) << 24);
+#endif
+	}
+    }
+}
+
+/*
+  Vertical pass: destination rows [from,to) from the temporary image.
+*/
+
+static void qt_filter_scale_y( void *arg, int from, int to )
+{
+    QImageFilterScale *s = (QImageFilterScale *)arg;
+    int w    = s->dst->width();
+    int taps = s->yw.taps;
+    for ( int y=from; y<to; y++ ) {
+	const QRgb  *col = s->tmp + s->yw.first[y]*w;
+	const short *wt	 = s->yw.w + y*taps;
+	QRgb *dl = (QRgb *)s->dst->scanLine( y );
+	int x = 0;
+#if defined(__SSE2__)
+	__m128i z = _mm_setzero_si128();
+	for ( ; x+1<w; x+=2 ) {			// two pixels at a time
+	    __m128i acc0 = _mm_set1_epi32( QT_SCALE_ONE/2 );
+	    __m128i acc1 = acc0;
+	    const QRgb *p = col + x;
+	    int k;
+	    for ( k=0; k<taps; k+=2 ) {
+		__m128i a = _mm_unpacklo_epi8(
+		    _mm_loadl_epi64((const __m128i *)p), z );
+		__m128i b = z;
+		int c = (ushort)wt[k];
+		if ( k+1 < taps ) {
+		    b = _mm_unpacklo_epi8(
+			_mm_loadl_epi64((const __m128i *)(p+w)), z );
+		    c |= (uint)(ushort)wt[k+1] << 16;
+		}
+		__m128i cv = _mm_set1_epi32( c );
+		acc0 = _mm_add_epi32( acc0,
+				      _mm_madd_epi16(_mm_unpacklo_epi16(a,b),cv) );
+		acc1 = _mm_add_epi32( acc1,
+				      _mm_madd_epi16(_mm_unpackhi_epi16(a,b),cv) );
+		p += 2*w;
+	    }
+	    acc0 = _mm_srai_epi32( acc0, QT_SCALE_BITS );
+	    acc1 = _mm_srai_epi32( acc1, QT_SCALE_BITS );
+	    acc0 = _mm_packs_epi32( acc0, acc1 );
+	    _mm_storel_epi64( (__m128i *)(dl+x), _mm_packus_epi16(acc0, acc0) );
+	}
+#endif
+	for ( ; x<w; x++ ) {
+	    const QRgb *p = col + x;
+	    int c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+	    for ( int k=0; k<taps; k++, p += w ) {
+		QRgb v = *p;
+		c0 += wt[k] * (int)(v & 0xff);
+		c1 += wt[k] * (int)((v >> 8) & 0xff);
+		c2 += wt[k] * (int)((v >> 16) & 0xff);
+		c3 += wt[k] * (int)(v >> 24);
+	    }
+	    dl[x] = qt_scale_clamp(c0) | (qt_scale_clamp(c1) << 8) |
+		    (qt_scale_clamp(c2) << 16) | (qt_scale_clamp(c3) << 24);
+	}
+    }
+}
+
+static void filterscale( const QImage &src, QImage &dst,
+			 QImage::ScaleFilter filter )
+{
+    QImageFilterScale s;
+    s.src = &src;
+    s.dst = &dst;
+    qt_scale_weights( &s.xw, src.width(), dst.width(), filter );
+    qt_scale_weights( &s.yw, src.height(), dst.height(), filter );
+    s.tmp = new QRgb[dst.width()*src.height()];
+    CHECK_PTR( s.tmp );
+    qt_image_rows( qt_filter_scale_x, &s, src.height(),
+		   dst.width()*s.xw.taps );
+    qt_image_rows( qt_filter_scale_y, &s, dst.height(),
+		   dst.width()*s.yw.taps );
+    delete [] s.tmp;
+    qt_free_scale_weights( &s.xw );
+    qt_free_scale_weights( &s.yw );
+}
+
+#undef QT_SCALE_BITS
+#undef QT_SCALE_ONE
+
+
 /*!
   \fn QImage QImage::smoothScale(int width, int height) const
 
@@ -2007,7 +2788,12 @@ QImage QImage::smoothScale(int w, int h) const
     if (depth()==32) {
 	QImage img(w, h, 32);
 	// 32-bpp to 32-bpp
-	pnmscale(*this,img);
+	QImageBoxScale s;
+	s.src = this;
+	s.dst = &img;
+	if ( hasAlphaBuffer() )
+	    img.setAlphaBuffer( TRUE );
+	qt_image_rows( qt_box_scale_rows, &s, h, QMAX(w,width()) );
 	return img;
     } else if (allGray() && !hasAlphaBuffer()) {
 	// Inefficient
@@ -2018,6 +2804,42 @@ QImage QImage::smoothScale(int w, int h) const
     }
 }
 
+/*!
+  \overload
+
+  Returns a copy of the image scaled to \a width by \a height pixels
+  using the given \a filter.
+
+  QImage::BoxFilter averages all source pixels covered by a destination
+  pixel and gives the same result as smoothScale(int,int).
+  QImage::BilinearFilter interpolates linearly between the nearest
+  pixels (and averages when shrinking).  QImage::LanczosFilter uses a
+  windowed sinc with three lobes, it is the slowest but keeps edges
+  sharpest.
+
+  Large images are scaled by several threads when Qt is built with
+  thread support.
+*/
+
+QImage QImage::smoothScale( int w, int h, ScaleFilter filter ) const
+{
+    if ( filter == BoxFilter )
+	return smoothScale( w, h );
+    if ( isNull() || w <= 0 || h <= 0 )
+	return QImage();
+    if ( depth() == 32 ) {
+	QImage img( w, h, 32 );
+	if ( hasAlphaBuffer() )
+	    img.setAlphaBuffer( TRUE );
+	filterscale( *this, img, filter );
+	return img;
+    } else if ( allGray() && !hasAlphaBuffer() ) {
+	return convertDepth(32).smoothScale(w,h,filter).convertDepth(8);
+    } else {
+	return convertDepth(32).smoothScale(w,h,filter);
+    }
+}
+
 /*!
   Builds and returns a 1-bpp mask from the alpha buffer in this image.
   Returns a null image if \link setAlphaBuffer() alpha buffer mode\endlink
@@ -4197,9 +5019,10 @@ static void write_xpm_image( QImageIO * iio )
 }
 
 /*!
-  Note:  currently no closest-color search is made.  If colors are found that
-  are not in the palette, the palette may not be used at all.  This result
-  should not be considered valid, as it may change in future implementations.
+  Returns an image with depth \a d, using the \a palette_count colors
+  pointed to by \a palette.  Colors that are not in the palette are
+  mapped to the closest palette color, dithered according to \a
+  conversion_flags.
 
   Currently inefficient for non 32-bit images.
 */
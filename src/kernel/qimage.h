@@ -34,6 +34,7 @@ class Q_EXPORT QImage
 {
 public:
     enum Endian { IgnoreEndian, BigEndian, LittleEndian };
+    enum ScaleFilter { BoxFilter, BilinearFilter, LanczosFilter };
 
     QImage();
     QImage( int width, int height, int depth, int numColors=0,
@@ -94,6 +95,7 @@ public:
     QImage	convertDepth( int, int conversion_flags ) const;
     QImage	convertBitOrder( Endian ) const;
     QImage	smoothScale(int width, int height) const;
+    QImage	smoothScale(int width, int height, ScaleFilter) const;
 
 #if defined(HAS_BOOL_TYPE)
     // Needed for binary compatibility - calls createAlphaMask(int)
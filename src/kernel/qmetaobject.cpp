@@ -117,6 +117,7 @@ QMetaObject::QMetaObject( const char *class_name, const char *superclass_name,
 
     superclass =				// get super class meta object
 	objectDict->find( superclassname );
+    signaloffset = superclass ? superclass->nSignals( TRUE ) : 0;
 }
 
 QMetaObject::~QMetaObject()
@@ -180,6 +181,34 @@ QMetaData *QMetaObject::signal( int index, bool super ) const
 }
 
 
+/*
+  Signals are numbered across the class hierarchy: the signals of the
+  topmost class come first, in declaration order, followed by the signals
+  of each subclass.  The number of a signal is the same in all objects
+  that inherit the class that declares it, which lets QObject keep its
+  connections in a table indexed by signal number.
+*/
+
+int QMetaObject::signalOffset() const		// number of inherited signals
+{
+    return signaloffset;
+}
+
+int QMetaObject::signalIndex( const char *n, bool super ) const
+{
+    register QMetaObject *meta = (QMetaObject *)this;
+    while ( meta ) {
+	QMetaData *d = meta->signalDict ? meta->signalDict->find(n) : 0;
+	if ( d )
+	    return meta->signaloffset + (int)(d - meta->signalData);
+	if ( !super )
+	    break;
+	meta = meta->superclass;
+    }
+    return -1;
+}
+
+
 QMemberDict *QMetaObject::init( QMetaData *data, int n )
 {
     if ( n == 0 )				// nothing, then make no dict
@@ -242,6 +242,29 @@ static void removeObjFromList( QObjectList *objList, const QObject *obj,
     }
 }
 
+static void insertInSignalVec( QConnectionList **vec, int n,
+			       QMetaObject *meta, const char *signal,
+			       QConnectionList *clist )
+{
+    while ( meta ) {				// a subclass may redeclare
+	int i = meta->signalIndex( signal );	//   the signal
+	if ( i >= 0 && i < n )
+	    vec[i] = clist;
+	meta = meta->superClass();
+    }
+}
+
+static void removeFromSignalVec( QConnectionList **vec, int n,
+				 const QConnectionList *clist )
+{
+    if ( !vec )
+	return;
+    for ( int i=0; i<n; i++ ) {
+	if ( vec[i] == clist )
+	    vec[i] = 0;
+    }
+}
+
 
 /*!
   \relates QObject
@@ -320,6 +343,8 @@ QObject::QObject( QObject *parent, const char *name )
     parentObj = parent;				// set parent
     childObjects = 0;				// no children yet
     connections = 0;				// no connections yet
+    signalVec = 0;				// no signal table yet
+    signalVecSize = 0;
     senderObjects = 0;				// no signals connected yet
     eventFilters = 0;				// no filters installed
     sigSender = 0;				// no sender yet
@@ -383,6 +408,10 @@ QObject::~QObject()
 	delete connections;
 	connections = 0;
     }
+    if ( signalVec ) {
+	delete [] signalVec;
+	signalVec = 0;
+    }
     if ( eventFilters ) {
 	delete eventFilters;
 	eventFilters = 0;
@@ -893,6 +922,22 @@ QConnectionList *QObject::receivers( const char *signal ) const
     return 0;
 }
 
+/*!
+  \overload
+  Returns a list of objects/slot pairs that are connected to the signal
+  with the number \e signal, or 0 if nothing is connected to it.
+
+  Signal numbers are assigned by the meta object compiler; see
+  QMetaObject::signalIndex().  This function is for internal use.
+*/
+
+QConnectionList *QObject::receivers( int signal ) const
+{
+    if ( signalVec && signal >= 0 && signal < signalVecSize )
+	return signalVec[signal];
+    return 0;
+}
+
 
 #if QT_VERSION == 200
 #error "insertChild and removeChild should be virtual."
@@ -1365,12 +1410,31 @@ bool QObject::connect( const QObject *sender,	const char *signal,
 	CHECK_PTR( s->connections );
 	s->connections->setAutoDelete( TRUE );
     }
+    int nsig = smeta->nSignals( TRUE );
+    if ( nsig > s->signalVecSize ) {		// create or grow signal table
+	// A connect() in a base class constructor sees the base class meta
+	// object only; rebuild the table when the full class is known.
+	QConnectionList **vec = new QConnectionList *[nsig];
+	CHECK_PTR( vec );
+	memset( (char*)vec, 0, nsig*sizeof(QConnectionList*) );
+	QSignalDictIt it( *(s->connections) );
+	QConnectionList *l;
+	while ( (l=it.current()) ) {
+	    insertInSignalVec( vec, nsig, smeta, it.currentKey(), l );
+	    ++it;
+	}
+	delete [] s->signalVec;
+	s->signalVec = vec;
+	s->signalVecSize = nsig;
+    }
     QConnectionList *clist = s->connections->find( signal );
     if ( !clist ) {				// create receiver list
 	clist = new QConnectionList;
 	CHECK_PTR( clist );
 	clist->setAutoDelete( TRUE );
 	s->connections->insert( signal, clist );
+	insertInSignalVec( s->signalVec, s->signalVecSize, smeta, signal,
+			   clist );
     }
     QConnection *c = new QConnection(r, rm->ptr, rm->name);
     CHECK_PTR( c );
@@ -1517,8 +1581,10 @@ bool QObject::disconnect( const QObject *sender,   const char *signal,
 		    c = clist->next();
 		}
 	    }
-	    if ( r == 0 )			// disconnect all receivers
+	    if ( r == 0 ) {			// disconnect all receivers
+		removeFromSignalVec( s->signalVec, s->signalVecSize, clist );
 		s->connections->remove( curkey );
+	    }
 	}
 	s->disconnectNotify( 0 );
     }
@@ -1557,8 +1623,10 @@ bool QObject::disconnect( const QObject *sender,   const char *signal,
 		c = clist->next();
 	    }
 	}
-	if ( r == 0 )				// disconnect all receivers
+	if ( r == 0 ) {				// disconnect all receivers
+	    removeFromSignalVec( s->signalVec, s->signalVecSize, clist );
 	    s->connections->remove( signal );
+	}
 	s->disconnectNotify( signal_name );
     }
     return TRUE;
@@ -1648,7 +1716,26 @@ void QObject::activate_signal( const char *signal )
 {
     if ( !connections )
 	return;
-    QConnectionList *clist = connections->find( signal );
+    activate_signal_list( connections->find(signal) );
+}
+
+/*!
+  \internal Signal activation by signal number, as generated by the meta
+  object compiler.  This is an array lookup instead of a dictionary
+  lookup of the signal name.
+  \sa QMetaObject::signalIndex()
+*/
+void QObject::activate_signal( int signal )
+{
+    activate_signal_list( receivers(signal) );
+}
+
+/*!
+  \internal
+  Calls all the slots in the connection list \e clist.
+*/
+void QObject::activate_signal_list( QConnectionList *clist )
+{
     if ( !clist || signalsBlocked() )
 	return;
     typedef void (QObject::*RT)();
@@ -1682,13 +1769,38 @@ void QObject::activate_signal( const char *signal )
   \overload void QObject::activate_signal( const char *signal, const char * )
 */
 
+/*!
+  \overload void QObject::activate_signal( int signal, short )
+*/
+
+/*!
+  \overload void QObject::activate_signal( int signal, int )
+*/
+
+/*!
+  \overload void QObject::activate_signal( int signal, long )
+*/
+
+/*!
+  \overload void QObject::activate_signal( int signal, const char * )
+*/
+
 
 #define ACTIVATE_SIGNAL_WITH_PARAM(TYPE)				      \
 void QObject::activate_signal( const char *signal, TYPE param )		      \
 {									      \
     if ( !connections )							      \
 	return;								      \
-    QConnectionList *clist = connections->find( signal );		      \
+    activate_signal_list( connections->find(signal), param );		      \
+}									      \
+									      \
+void QObject::activate_signal( int signal, TYPE param )			      \
+{									      \
+    activate_signal_list( receivers(signal), param );			      \
+}									      \
+									      \
+void QObject::activate_signal_list( QConnectionList *clist, TYPE param )      \
+{									      \
     if ( !clist || signalsBlocked() )					      \
 	return;								      \
     typedef void (QObject::*RT0)();					      \
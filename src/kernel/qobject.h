@@ -98,11 +98,17 @@ public:
 protected:
     bool	activate_filters( QEvent * );
     QConnectionList *receivers( const char *signal ) const;
+    QConnectionList *receivers( int signal ) const;
     void	activate_signal( const char *signal );
     void	activate_signal( const char *signal, short );
     void	activate_signal( const char *signal, int );
     void	activate_signal( const char *signal, long );
     void	activate_signal( const char *signal, const char * );
+    void	activate_signal( int signal );
+    void	activate_signal( int signal, short );
+    void	activate_signal( int signal, int );
+    void	activate_signal( int signal, long );
+    void	activate_signal( int signal, const char * );
     const QObject *sender();
 
     virtual void initMetaObject();
@@ -129,11 +135,18 @@ private slots:
 
 private:
     QMetaObject *queryMetaObject() const;
+    void	activate_signal_list( QConnectionList * );
+    void	activate_signal_list( QConnectionList *, short );
+    void	activate_signal_list( QConnectionList *, int );
+    void	activate_signal_list( QConnectionList *, long );
+    void	activate_signal_list( QConnectionList *, const char * );
     static QMetaObject *metaObj;
     char	*objname;
     QObject	*parentObj;
     QObjectList *childObjects;
     QSignalDict *connections;
+    QConnectionList **signalVec;
+    int		signalVecSize;
     QObjectList *senderObjects;
     QObjectList *eventFilters;
     QObject	*sigSender;
@@ -28,6 +28,7 @@
 #include "qdatastream.h"
 #include "qwidget.h"
 #include "qimage.h"
+#include "qcache.h"
 #include <stdlib.h>
 
 /*!
@@ -1946,6 +1947,40 @@ void QPainter::drawText( int x, int y, int w, int h, int tf,
 }
 
 
+#if defined(_WS_X11_)
+
+/*
+  The text layout cache remembers the line breaks and tab positions that
+  qt_format_text() computed for a string, so that repeated drawText() and
+  boundingRect() calls with the same font, formatting flags and width need
+  not measure and break the text again.  The least recently used layouts
+  are thrown out when the cache is full.
+*/
+
+struct QTextLayout {
+   ~QTextLayout() { delete [] codes; }
+    int	    maxwidth;				// max text width
+    int	    nlines;				// number of lines
+    int	    codelen;				// length of encoding
+    ushort *codes;				// encoded text
+};
+
+typedef Q_DECLARE(QCacheM,QTextLayout) QTextLayoutCache;
+
+static QTextLayoutCache *textLayoutCache = 0;
+
+const int textLayoutCacheSize = 64*1024;	// max bytes of cached layouts
+const int textLayoutMaxLen    = 1024;		// don't cache longer texts
+
+static void cleanupTextLayoutCache()
+{
+    delete textLayoutCache;
+    textLayoutCache = 0;
+}
+
+#endif // _WS_X11_
+
+
 void qt_format_text( const QFontMetrics& fm, int x, int y, int w, int h,
 		     int tf, const char *str, int len, QRect *brect,
 		     int tabstops, int* tabarray, int tabarraylen,
@@ -2016,8 +2051,32 @@ void qt_format_text( const QFontMetrics& fm, int x, int y, int w, int h,
     begline = breakindex = breakwidth = maxwidth = bcwidth = tabindex = 0;
     k = tw = 0;
 
+#if defined(_WS_X11_)
+    QTextLayout *layout = 0;
+    QString	 layoutKey;
+    if ( !internal && !tabarray && len <= textLayoutMaxLen &&
+	 !memchr(str,0,len) ) {
+	// Only the flags and width that affect the encoding are part of
+	// the key; alignment is applied when the text is drawn.
+	int ltf = tf & (WordBreak | ExpandTabs | SingleLine | ShowPrefix);
+	layoutKey.sprintf( "%p %x %d %d %d ", fm.fontInternal(), ltf,
+			   wordbreak ? w : 0, tabstops,
+			   fm.printerAdjusted(1000) );
+	layoutKey += QString( str, len+1 );
+	if ( !textLayoutCache ) {
+	    textLayoutCache = new QTextLayoutCache( textLayoutCacheSize, 61 );
+	    CHECK_PTR( textLayoutCache );
+	    textLayoutCache->setAutoDelete( TRUE );
+	    qAddPostRoutine( cleanupTextLayoutCache );
+	}
+	layout = textLayoutCache->find( layoutKey );
+    }
+    if ( decode || layout )			// skip encoding
+	k = len;
+#else
     if ( decode )				// skip encoding
 	k = len;
+#endif
 
     int localTabStops = 0;	       		// tab stops
     if ( tabstops )
@@ -2139,12 +2198,39 @@ void qt_format_text( const QFontMetrics& fm, int x, int y, int w, int h,
 	nlines	 = ti->nlines;
 	codelen	 = ti->codelen;
 	codes	 = (ushort *)(data + sizeof(text_info));
+#if defined(_WS_X11_)
+    } else if ( layout ) {			// use cached layout
+	maxwidth = layout->maxwidth;
+	nlines	 = layout->nlines;
+	codelen	 = layout->codelen;
+	if ( code_alloc ) {
+	    free( codes );
+	    code_alloc = FALSE;
+	}
+	codes	 = layout->codes;
+#endif
     } else {
 	codes[begline] = BEGLINE | QMIN(tw,MAXWIDTH);
 	maxwidth = QMAX(maxwidth,tw);
 	nlines++;
 	codes[index++] = 0;
 	codelen = index;
+#if defined(_WS_X11_)
+	if ( !layoutKey.isNull() ) {		// remember the layout
+	    layout = new QTextLayout;
+	    CHECK_PTR( layout );
+	    layout->maxwidth = maxwidth;
+	    layout->nlines   = nlines;
+	    layout->codelen  = codelen;
+	    layout->codes    = new ushort[codelen];
+	    CHECK_PTR( layout->codes );
+	    memcpy( layout->codes, codes, codelen*sizeof(ushort) );
+	    int cost = sizeof(QTextLayout) + layoutKey.length() +
+		       codelen*sizeof(ushort);
+	    if ( !textLayoutCache->insert(layoutKey, layout, cost) )
+		delete layout;
+	}
+#endif
     }
 
     if ( encode ) {				// build internal data
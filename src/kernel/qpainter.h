@@ -69,6 +69,8 @@ public:
     bool	isActive() const;
 
     void	flush();
+    void	setBatching( bool );
+    bool	hasBatching() const;
     void	save();
     void	restore();
 
@@ -28,6 +28,7 @@
 #include "qpixmapcache.h"
 #include "qlist.h"
 #include "qintdict.h"
+#include "qptrdict.h"
 #include <ctype.h>
 #include <stdlib.h>
 #define	 GC GC_QQQ
@@ -127,6 +128,12 @@ inline double qcos( double a ) { return qsincos(a,TRUE); }
   The GC allocator offers two functions; alloc_gc() and free_gc() that
   reuse GC objects instead of calling XCreateGC() and XFreeGC(), which
   are a whole lot slower.
+
+  Each allocated GC carries a shadow copy of the GC attributes that the
+  painter changes most often.  The set_gc_xxx() functions below compare
+  against the shadow and only talk to the X server when the value really
+  changes.  The attributes must therefore always be set through these
+  functions for GCs from the GC array.
  *****************************************************************************/
 
 struct QGC
@@ -134,6 +141,10 @@ struct QGC
     GC	 gc;
     char in_use;
     bool mono;
+    bool clip;					// shadow: clip mask set
+    uint fg;					// shadow: foreground pixel
+    uint bg;					// shadow: background pixel
+    char *dashes;				// shadow: dash list
 };
 
 const  int  gc_array_size = 256;
@@ -187,6 +198,10 @@ static GC alloc_gc( Display *dpy, Drawable hd, bool monochrome=FALSE,
 		XSetGraphicsExposures( dpy, p->gc, FALSE );
 		p->in_use = FALSE;
 		p->mono   = monochrome;
+		p->clip   = FALSE;		// X defaults
+		p->fg	  = 0;
+		p->bg	  = 1;
+		p->dashes = 0;
 	    }
 	    if ( !p->in_use && p->mono == monochrome ) {
 		p->in_use = TRUE;		// available/compatible GC
@@ -220,7 +235,10 @@ static void free_gc( Display *dpy, GC gc, bool privateGC = FALSE )
 	    while ( i-- ) {
 		if ( p->gc == gc ) {
 		    p->in_use = FALSE;		// set available
-		    XSetClipMask( dpy, gc, None );	// make it reusable
+		    if ( p->clip ) {		// make it reusable
+			XSetClipMask( dpy, gc, None );
+			p->clip = FALSE;
+		    }
 		    XSetFunction( dpy, gc, GXcopy );
 		    XSetFillStyle( dpy, gc, FillSolid );
 		    return;
@@ -232,6 +250,193 @@ static void free_gc( Display *dpy, GC gc, bool privateGC = FALSE )
 }
 
 
+//
+// Returns the GC array entry for gc, or 0 if gc is a private GC.
+// The pen and brush GCs are looked up in turn, so the last two hits
+// are remembered.
+//
+
+static QGC *gc_entry( GC gc )
+{
+    static QGC *last[2] = { 0, 0 };
+    if ( last[0] && last[0]->gc == gc )
+	return last[0];
+    if ( last[1] && last[1]->gc == gc ) {
+	QGC *p = last[1];
+	last[1] = last[0];
+	last[0] = p;
+	return p;
+    }
+    if ( !gc_array_init )
+	return 0;
+    register QGC *p = gc_array;
+    int i = gc_array_size;
+    while ( i-- ) {
+	if ( p->gc == gc ) {
+	    last[1] = last[0];
+	    last[0] = p;
+	    return p;
+	}
+	p++;
+    }
+    return 0;
+}
+
+static void set_gc_foreground( Display *dpy, GC gc, uint pix )
+{
+    QGC *p = gc_entry( gc );
+    if ( p ) {
+	if ( p->fg == pix )
+	    return;
+	p->fg = pix;
+    }
+    XSetForeground( dpy, gc, pix );
+}
+
+static void set_gc_background( Display *dpy, GC gc, uint pix )
+{
+    QGC *p = gc_entry( gc );
+    if ( p ) {
+	if ( p->bg == pix )
+	    return;
+	p->bg = pix;
+    }
+    XSetBackground( dpy, gc, pix );
+}
+
+static void set_gc_dashes( Display *dpy, GC gc, char *dashes, int n )
+{						// dashes must be static data
+    QGC *p = gc_entry( gc );
+    if ( p ) {
+	if ( p->dashes == dashes )
+	    return;
+	p->dashes = dashes;
+    }
+    XSetDashes( dpy, gc, 0, dashes, n );
+}
+
+static void set_gc_clip_mask( Display *dpy, GC gc, Pixmap mask )
+{
+    QGC *p = gc_entry( gc );
+    if ( p ) {
+	if ( mask == None && !p->clip )
+	    return;
+	p->clip = mask != None;
+    }
+    XSetClipMask( dpy, gc, mask );
+}
+
+static void set_gc_region( Display *dpy, GC gc, Region rgn )
+{
+    QGC *p = gc_entry( gc );
+    if ( p )
+	p->clip = TRUE;
+    XSetRegion( dpy, gc, rgn );
+}
+
+
+/*****************************************************************************
+  QPainter internal primitive batching.
+
+  A painter in batching mode (see QPainter::setBatching()) does not send
+  points, lines and rectangles to the X server one at a time.  Consecutive
+  primitives of the same kind that are drawn with the same GC on the same
+  drawable are collected in the batch buffer and sent as one XDrawPoints(),
+  XDrawSegments(), XDrawRectangles() or XFillRectangles() request.
+
+  The buffer is sent before anything else is drawn, before the batched GC
+  is changed and when the painter ends.
+ *****************************************************************************/
+
+enum { BatchPoints, BatchSegments, BatchRects, BatchFillRects };
+
+const int batch_size = 512;			// max primitives in batch
+
+static struct QPaintBatch {
+    QPainter *owner;				// painter that owns the batch
+    Display  *dpy;
+    Drawable  hd;
+    GC	      gc;
+    int	      kind;
+    int	      count;
+    union {
+	XPoint	   points[batch_size];
+	XSegment   segs[batch_size];
+	XRectangle rects[batch_size];
+    } buf;
+} batch;
+
+typedef Q_DECLARE(QPtrDictM,QPainter) QPainterDict;
+static QPainterDict *batch_dict = 0;		// painters in batching mode
+
+
+static void send_batch()
+{
+    switch ( batch.kind ) {
+	case BatchPoints:
+	    XDrawPoints( batch.dpy, batch.hd, batch.gc, batch.buf.points,
+			 batch.count, CoordModeOrigin );
+	    break;
+	case BatchSegments:
+	    XDrawSegments( batch.dpy, batch.hd, batch.gc, batch.buf.segs,
+			   batch.count );
+	    break;
+	case BatchRects:
+	    XDrawRectangles( batch.dpy, batch.hd, batch.gc, batch.buf.rects,
+			     batch.count );
+	    break;
+	case BatchFillRects:
+	    XFillRectangles( batch.dpy, batch.hd, batch.gc, batch.buf.rects,
+			     batch.count );
+	    break;
+    }
+    batch.count = 0;
+}
+
+static inline void flush_batch()
+{
+    if ( batch.count )
+	send_batch();
+}
+
+//
+// Returns TRUE if the painter p is in batching mode, and makes it the
+// owner of the batch buffer.
+//
+
+static bool batching( QPainter *p )
+{
+    if ( batch.owner == p )
+	return TRUE;
+    if ( !batch_dict || !batch_dict->find(p) )
+	return FALSE;
+    flush_batch();
+    batch.owner = p;
+    return TRUE;
+}
+
+//
+// Returns the index of a free slot in the batch buffer for a primitive
+// of the given kind, sending the primitives collected so far if they
+// cannot be combined with it.
+//
+
+static int batch_slot( Display *dpy, Drawable hd, GC gc, int kind )
+{
+    if ( batch.count == batch_size ||
+	 (batch.count && (batch.kind != kind || batch.gc != gc ||
+			  batch.hd != hd)) )
+	send_batch();
+    if ( batch.count == 0 ) {
+	batch.dpy  = dpy;
+	batch.hd   = hd;
+	batch.gc   = gc;
+	batch.kind = kind;
+    }
+    return batch.count++;
+}
+
+
 /*****************************************************************************
   QPainter internal GC (Graphics Context) cache for solid pens and brushes.
 
@@ -330,10 +535,12 @@ static bool obtain_gc( void **ref, GC *gc, uint pix, Display *dpy, HANDLE hd )
 		g = gc_cache[++k];
 		if ( NOMATCH ) {
 		    if ( g->count == 0 ) {	// steal this GC
+			if ( batch.count && batch.gc == g->gc )
+			    send_batch();
 			g->pix	 = pix;
 			g->count = 1;
 			g->hits	 = 1;
-			XSetForeground( dpy, g->gc, pix );
+			set_gc_foreground( dpy, g->gc, pix );
 			gc_cache[k]   = prev;
 			gc_cache[k-1] = g;
 			*ref = (void *)g;
@@ -515,6 +722,7 @@ void QPainter::updateFont()
 	if ( !pdev->cmd(PDC_SETFONT,this,param) || !hd )
 	    return;
     }
+    flush_batch();
     setf(NoCache);
     if ( penRef )
 	updatePen();				// force a non-cached GC
@@ -541,6 +749,9 @@ void QPainter::updatePen()
 		   (ps == NoPen || ps == SolidLine) &&
 		   cpen.width() == 0 && rop == CopyROP;
 
+    if ( batch.count && batch.gc == gc && !(cacheIt && penRef) )
+	send_batch();				// gc will be modified
+
     if ( cacheIt ) {
 	if ( gc ) {
 	    if ( penRef )
@@ -592,11 +803,11 @@ void QPainter::updatePen()
 	    break;
     }
 
-    XSetForeground( dpy, gc, cpen.color().pixel() );
-    XSetBackground( dpy, gc, bg_col.pixel() );
+    set_gc_foreground( dpy, gc, cpen.color().pixel() );
+    set_gc_background( dpy, gc, bg_col.pixel() );
 
     if ( dash_len ) {				// make dash list
-	XSetDashes( dpy, gc, 0, dashes, dash_len );
+	set_gc_dashes( dpy, gc, dashes, dash_len );
 	s = bg_mode == TransparentMode ? LineOnOffDash : LineDoubleDash;
     }
     XSetLineAttributes( dpy, gc, cpen.width(), s, CapButt, JoinMiter );
@@ -662,6 +873,9 @@ static uchar *pat_tbl[] = {
 		   (bs == NoBrush || bs == SolidPattern) &&
 		   bro.x() == 0 && bro.y() == 0 && rop == CopyROP;
 
+    if ( batch.count && batch.gc == gc_brush && !(cacheIt && brushRef) )
+	send_batch();				// gc_brush will be modified
+
     if ( cacheIt ) {
 	if ( gc_brush ) {
 	    if ( brushRef )
@@ -700,8 +914,8 @@ static uchar *pat_tbl[] = {
     }
 
     XSetLineAttributes( dpy, gc_brush, 0, LineSolid, CapButt, JoinMiter );
-    XSetForeground( dpy, gc_brush, cbrush.color().pixel() );
-    XSetBackground( dpy, gc_brush, bg_col.pixel() );
+    set_gc_foreground( dpy, gc_brush, cbrush.color().pixel() );
+    set_gc_background( dpy, gc_brush, bg_col.pixel() );
 
     if ( bs == CustomPattern || pat ) {
 	QPixmap *pm;
@@ -936,6 +1150,8 @@ bool QPainter::end()				// end painting
 #endif
 	return FALSE;
     }
+    if ( batch_dict )				// send batched primitives
+	setBatching( FALSE );
     if ( testf(FontMet) )			// remove references to this
 	QFontMetrics::reset( this );
     if ( testf(FontInf) )			// remove references to this
@@ -983,12 +1199,77 @@ bool QPainter::end()				// end painting
 
 /*!
   Flushes any buffered drawing operations.
+  \sa setBatching()
 */
 
 void QPainter::flush()
 {
-    if ( isActive() && dpy )
+    if ( isActive() && dpy ) {
+	flush_batch();
 	XFlush( dpy );
+    }
+}
+
+
+/*!
+  Enables batching of drawing primitives if \e enable is TRUE, or
+  disables it if \e enable is FALSE.
+
+  In batching mode, consecutive calls to drawPoint(), drawPoints(),
+  lineTo(), drawLine(), drawLineSegments() and drawRect() that use the
+  same pen and brush are collected and sent to the window system
+  together, which is much faster when thousands of small primitives are
+  drawn.  The collected primitives are sent when any other drawing
+  function is called, when a drawing tool or attribute changes, and by
+  flush() and end().
+
+  Drawing on the paint device by other means than this painter, for
+  example with bitBlt(), may overtake the batched primitives.  Call
+  flush() first if that matters.
+
+  Batching is turned off by end().  It has no effect for printers and
+  other external devices.
+
+  \sa hasBatching(), flush()
+*/
+
+void QPainter::setBatching( bool enable )
+{
+    if ( !isActive() ) {
+#if defined(CHECK_STATE)
+	warning( "QPainter::setBatching: Call begin() first" );
+#endif
+	return;
+    }
+    if ( testf(ExtDev) )
+	return;
+    if ( enable ) {
+	if ( !batch_dict ) {
+	    batch_dict = new QPainterDict;
+	    CHECK_PTR( batch_dict );
+	}
+	batch_dict->replace( this, this );
+    } else if ( batch_dict ) {
+	if ( batch.owner == this ) {
+	    flush_batch();
+	    batch.owner = 0;
+	}
+	batch_dict->remove( this );
+	if ( batch_dict->isEmpty() ) {
+	    delete batch_dict;
+	    batch_dict = 0;
+	}
+    }
+}
+
+/*!
+  Returns TRUE if drawing primitives are batched, otherwise FALSE.
+  \sa setBatching()
+*/
+
+bool QPainter::hasBatching() const
+{
+    return batch_dict && batch_dict->find( (void *)this );
 }
 
 
@@ -1112,6 +1393,7 @@ void QPainter::setRasterOp( RasterOp r )
 	if ( !pdev->cmd(PDC_SETROP,this,param) || !hd )
 	    return;
     }
+    flush_batch();
     if ( penRef )
 	updatePen();				// get non-cached pen GC
     if ( brushRef )
@@ -1145,6 +1427,7 @@ void QPainter::setBrushOrigin( int x, int y )
 	if ( !pdev->cmd(PDC_SETBRUSHORIGIN,this,param) || !hd )
 	    return;
     }
+    flush_batch();
     if ( brushRef )
 	updateBrush();				// get non-cached brush GC
     XSetTSOrigin( dpy, gc_brush, x, y );
@@ -1172,16 +1455,17 @@ void QPainter::setClipping( bool enable )
 	if ( !pdev->cmd(PDC_SETCLIP,this,param) || !hd )
 	    return;
     }
+    flush_batch();
     if ( enable ) {
 	if ( penRef )
 	    updatePen();
-	XSetRegion( dpy, gc, crgn.handle() );
+	set_gc_region( dpy, gc, crgn.handle() );
 	if ( brushRef )
 	    updateBrush();
-	XSetRegion( dpy, gc_brush, crgn.handle() );
+	set_gc_region( dpy, gc_brush, crgn.handle() );
     } else {
-	XSetClipMask( dpy, gc, None );
-	XSetClipMask( dpy, gc_brush, None );
+	set_gc_clip_mask( dpy, gc, None );
+	set_gc_clip_mask( dpy, gc_brush, None );
     }
 }
 
@@ -1233,6 +1517,7 @@ void QPainter::drawPolyInternal( const QPointArray &a, bool close )
 {
     if ( a.size() < 2 )
 	return;
+    flush_batch();
 
     int x1, y1, x2, y2;				// connect last to first point
     a.point( a.size()-1, &x1, &y1 );
@@ -1275,8 +1560,16 @@ void QPainter::drawPoint( int x, int y )
 	}
 	map( x, y, &x, &y );
     }
-    if ( cpen.style() != NoPen )
-	XDrawPoint( dpy, hd, gc, x, y );
+    if ( cpen.style() != NoPen ) {
+	if ( batching(this) ) {
+	    XPoint *p = &batch.buf.points[batch_slot(dpy,hd,gc,BatchPoints)];
+	    p->x = x;
+	    p->y = y;
+	} else {
+	    flush_batch();
+	    XDrawPoint( dpy, hd, gc, x, y );
+	}
+    }
 }
 
 
@@ -1314,9 +1607,20 @@ void QPainter::drawPoints( const QPointArray& a, int index, int npoints )
 	    }		
 	}
     }
-    if ( cpen.style() != NoPen )
+    if ( cpen.style() == NoPen )
+	return;
+    if ( npoints < batch_size && batching(this) ) {
+	QCOORD *p = (QCOORD *)(pa.data()+index);
+	while ( npoints-- ) {
+	    XPoint *b = &batch.buf.points[batch_slot(dpy,hd,gc,BatchPoints)];
+	    b->x = *p++;
+	    b->y = *p++;
+	}
+    } else {
+	flush_batch();
 	XDrawPoints( dpy, hd, gc, (XPoint*)(pa.data()+index), npoints,
 		     CoordModeOrigin );
+    }
 }
 
 
@@ -1362,8 +1666,18 @@ void QPainter::lineTo( int x, int y )
 	}
 	map( x, y, &x, &y );
     }
-    if ( cpen.style() != NoPen )
-	XDrawLine( dpy, hd, gc, curPt.x(), curPt.y(), x, y );
+    if ( cpen.style() != NoPen ) {
+	if ( batching(this) ) {
+	    XSegment *s = &batch.buf.segs[batch_slot(dpy,hd,gc,BatchSegments)];
+	    s->x1 = curPt.x();
+	    s->y1 = curPt.y();
+	    s->x2 = x;
+	    s->y2 = y;
+	} else {
+	    flush_batch();
+	    XDrawLine( dpy, hd, gc, curPt.x(), curPt.y(), x, y );
+	}
+    }
     curPt = QPoint( x, y );
 }
 
@@ -1388,8 +1702,18 @@ void QPainter::drawLine( int x1, int y1, int x2, int y2 )
 	map( x1, y1, &x1, &y1 );
 	map( x2, y2, &x2, &y2 );
     }
-    if ( cpen.style() != NoPen )
-	XDrawLine( dpy, hd, gc, x1, y1, x2, y2 );
+    if ( cpen.style() != NoPen ) {
+	if ( batching(this) ) {
+	    XSegment *s = &batch.buf.segs[batch_slot(dpy,hd,gc,BatchSegments)];
+	    s->x1 = x1;
+	    s->y1 = y1;
+	    s->x2 = x2;
+	    s->y2 = y2;
+	} else {
+	    flush_batch();
+	    XDrawLine( dpy, hd, gc, x1, y1, x2, y2 );
+	}
+    }
     curPt = QPoint( x2, y2 );
 }
 
@@ -1426,6 +1750,26 @@ void QPainter::drawRect( int x, int y, int w, int h )
 	    return;
 	fix_neg_rect( &x, &y, &w, &h );
     }
+    if ( batching(this) ) {			// batch fill or outline only
+	XRectangle *r = 0;
+	if ( cpen.style() == NoPen ) {
+	    if ( cbrush.style() != NoBrush ) {
+		r = &batch.buf.rects[batch_slot(dpy,hd,gc_brush,BatchFillRects)];
+		r->width  = w;
+		r->height = h;
+	    }
+	} else if ( cbrush.style() == NoBrush ) {
+	    r = &batch.buf.rects[batch_slot(dpy,hd,gc,BatchRects)];
+	    r->width  = w-1;
+	    r->height = h-1;
+	}
+	if ( r ) {
+	    r->x = x;
+	    r->y = y;
+	    return;
+	}
+    }
+    flush_batch();
     if ( cbrush.style() != NoBrush ) {
 	if ( cpen.style() == NoPen ) {
 	    XFillRectangle( dpy, hd, gc_brush, x, y, w, h );
@@ -1490,6 +1834,7 @@ void QPainter::drawWinFocusRect( int x, int y, int w, int h,
 {
     if ( !isActive() || txop == TxRotShear )
 	return;
+    flush_batch();
     static char winfocus_line[] = { 1, 1 };
 
     QPen     old_pen = cpen;
@@ -1523,7 +1868,7 @@ void QPainter::drawWinFocusRect( int x, int y, int w, int h,
 	    return;
 	fix_neg_rect( &x, &y, &w, &h );
     }
-    XSetDashes( dpy, gc, 0, winfocus_line, 2 );
+    set_gc_dashes( dpy, gc, winfocus_line, 2 );
     XSetLineAttributes( dpy, gc, 0, LineOnOffDash, CapButt, JoinMiter );
 
     XDrawRectangle( dpy, hd, gc, x, y, w-1, h-1 );
@@ -1549,6 +1894,7 @@ void QPainter::drawRoundRect( int x, int y, int w, int h, int xRnd, int yRnd )
 {
     if ( !isActive() )
 	return;
+    flush_batch();
     if ( xRnd <= 0 || yRnd <= 0 ) {
 	drawRect( x, y, w, h );			// draw normal rectangle
 	return;
@@ -1676,6 +2022,7 @@ void QPainter::drawEllipse( int x, int y, int w, int h )
 {
     if ( !isActive() )
 	return;
+    flush_batch();
     if ( testf(ExtDev|VxF|WxF) ) {
 	if ( testf(ExtDev) ) {
 	    QPDevCmdParam param[1];
@@ -1735,6 +2082,7 @@ void QPainter::drawArc( int x, int y, int w, int h, int a, int alen )
 {
     if ( !isActive() )
 	return;
+    flush_batch();
     if ( testf(ExtDev|VxF|WxF) ) {
 	if ( testf(ExtDev) ) {
 	    QPDevCmdParam param[3];
@@ -1791,6 +2139,7 @@ void QPainter::drawPie( int x, int y, int w, int h, int a, int alen )
 
     if ( !isActive() )
 	return;
+    flush_batch();
     if ( testf(ExtDev|VxF|WxF) ) {
 	if ( testf(ExtDev) ) {
 	    QPDevCmdParam param[3];
@@ -1868,6 +2217,7 @@ void QPainter::drawChord( int x, int y, int w, int h, int a, int alen )
 {
     if ( !isActive() )
 	return;
+    flush_batch();
     if ( testf(ExtDev|VxF|WxF) ) {
 	if ( testf(ExtDev) ) {
 	    QPDevCmdParam param[3];
@@ -1965,8 +2315,21 @@ void QPainter::drawLineSegments( const QPointArray &a, int index, int nlines )
 	    }		
 	}
     }
-    if ( cpen.style() != NoPen )
+    if ( cpen.style() == NoPen )
+	return;
+    if ( nlines < batch_size && batching(this) ) {
+	QCOORD *p = (QCOORD *)(pa.data()+index);
+	while ( nlines-- ) {
+	    XSegment *s = &batch.buf.segs[batch_slot(dpy,hd,gc,BatchSegments)];
+	    s->x1 = *p++;
+	    s->y1 = *p++;
+	    s->x2 = *p++;
+	    s->y2 = *p++;
+	}
+    } else {
+	flush_batch();
 	XDrawSegments( dpy, hd, gc, (XSegment*)(pa.data()+index), nlines );
+    }
 }
 
 
@@ -1988,6 +2351,7 @@ void QPainter::drawPolyline( const QPointArray &a, int index, int npoints )
 	npoints = a.size() - index;
     if ( !isActive() || npoints < 2 || index < 0 )
 	return;
+    flush_batch();
     QPointArray pa = a;
     if ( testf(ExtDev|VxF|WxF) ) {
 	if ( testf(ExtDev) ) {
@@ -2042,6 +2406,7 @@ void QPainter::drawPolygon( const QPointArray &a, bool winding,
 	npoints = a.size() - index;
     if ( !isActive() || npoints < 2 || index < 0 )
 	return;
+    flush_batch();
     QPointArray pa = a;
     if ( testf(ExtDev|VxF|WxF) ) {
 	if ( testf(ExtDev) ) {
@@ -2106,6 +2471,7 @@ void QPainter::drawQuadBezier( const QPointArray &a, int index )
 {
     if ( !isActive() )
 	return;
+    flush_batch();
     if ( a.size() - index < 4 ) {
 #if defined(CHECK_RANGE)
 	warning( "QPainter::drawQuadBezier: Cubic Bezier needs 4 control "
@@ -2158,6 +2524,7 @@ void QPainter::drawPixmap( int x, int y, const QPixmap &pixmap,
 {
     if ( !isActive() || pixmap.isNull() )
 	return;
+    flush_batch();
 
     // right/bottom
     if ( sw < 0 )
@@ -2243,7 +2610,7 @@ void QPainter::drawPixmap( int x, int y, const QPixmap &pixmap,
 	    } else {
 		XSetFillStyle( dpy, gc, FillOpaqueStippled );
 		XSetStipple( dpy, gc, pixmap.handle() );
-		XSetClipMask( dpy, gc, mask->handle() );
+		set_gc_clip_mask( dpy, gc, mask->handle() );
 		XSetClipOrigin( dpy, gc, x-sx, y-sy );
 	    }
 	    XSetTSOrigin( dpy, gc, x-sx, y-sy );
@@ -2252,7 +2619,7 @@ void QPainter::drawPixmap( int x, int y, const QPixmap &pixmap,
 	    XSetFillStyle( dpy, gc, FillSolid );
 	    if ( !selfmask ) {
 		XSetClipOrigin( dpy, gc, 0, 0 );
-		XSetClipMask( dpy, gc, None );
+		set_gc_clip_mask( dpy, gc, None );
 	    }
 	} else {
 	    bitBlt( pdev, x, y, &pixmap, sx, sy, sw, sh, (RasterOp)rop );
@@ -2283,12 +2650,12 @@ void QPainter::drawPixmap( int x, int y, const QPixmap &pixmap,
 	XSetClipMask( dpy, cgc, None );
 	mask = comb;				// it's deleted below
 
-	XSetClipMask( dpy, gc, mask->handle() );
+	set_gc_clip_mask( dpy, gc, mask->handle() );
 	XSetClipOrigin( dpy, gc, x, y );
     }
 
     if ( mono ) {
-	XSetBackground( dpy, gc, bg_col.pixel() );
+	set_gc_background( dpy, gc, bg_col.pixel() );
 	XSetFillStyle( dpy, gc, FillOpaqueStippled );
 	XSetStipple( dpy, gc, pixmap.handle() );
 	XSetTSOrigin( dpy, gc, x-sx, y-sy );
@@ -2301,7 +2668,7 @@ void QPainter::drawPixmap( int x, int y, const QPixmap &pixmap,
 
     if ( mask ) {				// restore clipping
 	XSetClipOrigin( dpy, gc, 0, 0 );
-	XSetRegion( dpy, gc, crgn.handle() );
+	set_gc_region( dpy, gc, crgn.handle() );
 	delete mask;				// delete comb, created above
     }
 }
@@ -2391,6 +2758,7 @@ void QPainter::drawTiledPixmap( int x, int y, int w, int h,
 	 mask == 0 ) {
 	if ( txop == TxTranslate )
 	    map( x, y, &x, &y );
+	flush_batch();
 	XSetTile( dpy, gc, pixmap.handle() );
 	XSetFillStyle( dpy, gc, FillTiled );
 	XSetTSOrigin( dpy, gc, x-sx, y-sy );
@@ -2466,6 +2834,7 @@ void QPainter::drawText( int x, int y, const char *str, int len )
 {
     if ( !isActive() )
 	return;
+    flush_batch();
     if ( len < 0 )
 	len = strlen( str );
     if ( len == 0 )				// empty string
@@ -41,7 +41,7 @@
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xos.h>
-#ifdef MITSHM
+#if defined(MITSHM) || defined(QT_MITSHM)
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <X11/extensions/XShm.h>
@@ -146,6 +146,185 @@ bool qt_create_mitshm_buffer( QPaintDevice*, int, int )
 #endif // MITSHM
 
 
+/*****************************************************************************
+  Shared memory pool for convertFromImage()
+
+  Large TrueColor images are packed straight into one of a few MIT-SHM
+  segments and sent with XShmPutImage().  The upload is asynchronous: a
+  segment stays busy until the server reports ShmCompletion, and in the
+  meantime the next image is packed into another segment.  Only when
+  all segments are busy do we wait for the server.
+
+  The segment is reused, so no XImage is left to cache in the pixmap.
+  The pool is therefore only used for pixmaps with NoOptim; the other
+  optimization modes keep their XImage for convertToImage() and xForm().
+
+  Compiled in when QT_MITSHM is defined (the build system does that when
+  the XShm extension is found) and used only for local displays.
+ *****************************************************************************/
+
+#if defined(QT_MITSHM)
+
+const int shm_pool_size = 4;			// number of segments
+const int shm_min_bytes = 64*1024;		// smaller images use XPutImage
+
+struct QShmSegment {
+    XShmSegmentInfo info;
+    int		    size;			// 0 if not allocated
+    bool	    busy;			// waiting for ShmCompletion
+};
+
+static QShmSegment shm_pool[shm_pool_size];
+static int	   shm_state = 0;		// 0=unknown, 1=ok, -1=no shm
+static int	   shm_completion = -1;		// ShmCompletion event type
+static Display	  *shm_dpy = 0;
+
+static void qt_shm_free_segment( QShmSegment *s )
+{
+    if ( s->size == 0 )
+	return;
+    XShmDetach( shm_dpy, &s->info );
+    shmdt( s->info.shmaddr );
+    s->size = 0;
+    s->busy = FALSE;
+}
+
+static void qt_cleanup_shm_pool()
+{
+    if ( shm_state != 1 )
+	return;
+    XSync( shm_dpy, FALSE );			// let the server finish
+    for ( int i=0; i<shm_pool_size; i++ )
+	qt_shm_free_segment( &shm_pool[i] );
+    shm_state = 0;
+}
+
+static bool shm_attach_failed;
+
+static int qt_shm_errhandler( Display *, XErrorEvent * )
+{
+    shm_attach_failed = TRUE;			// e.g. remote display
+    return 0;
+}
+
+static bool qt_shm_alloc_segment( QShmSegment *s, int size )
+{
+    s->info.shmid = shmget( IPC_PRIVATE, size, IPC_CREAT | 0600 );
+    if ( s->info.shmid == -1 )
+	return FALSE;
+    s->info.shmaddr = (char *)shmat( s->info.shmid, 0, 0 );
+    if ( s->info.shmaddr == (char *)-1 ) {
+	shmctl( s->info.shmid, IPC_RMID, 0 );
+	return FALSE;
+    }
+    s->info.readOnly = TRUE;
+    shm_attach_failed = FALSE;
+    XSync( shm_dpy, FALSE );
+    int (*oldhandler)(Display*,XErrorEvent*) =
+	XSetErrorHandler( qt_shm_errhandler );
+    bool ok = XShmAttach( shm_dpy, &s->info );
+    XSync( shm_dpy, FALSE );
+    XSetErrorHandler( oldhandler );
+    shmctl( s->info.shmid, IPC_RMID, 0 );	// gone when both detach
+    if ( !ok || shm_attach_failed ) {
+	shmdt( s->info.shmaddr );
+	return FALSE;
+    }
+    s->size = size;
+    s->busy = FALSE;
+    return TRUE;
+}
+
+/*
+  Marks the segment of a ShmCompletion event as free.  Called for every
+  X event from QApplication::x11ProcessEvent().
+*/
+
+bool qt_x11_shm_event( XEvent *event )
+{
+    if ( event->type != shm_completion || shm_completion < 0 )
+	return FALSE;
+    XShmCompletionEvent *e = (XShmCompletionEvent *)event;
+    for ( int i=0; i<shm_pool_size; i++ ) {
+	if ( shm_pool[i].size && shm_pool[i].info.shmseg == e->shmseg )
+	    shm_pool[i].busy = FALSE;
+    }
+    return TRUE;
+}
+
+static Bool qt_shm_completion_pred( Display *, XEvent *event, XPointer )
+{
+    return event->type == shm_completion;
+}
+
+/*
+  Returns a free segment of at least \a size bytes, or 0 if shared
+  memory cannot be used.
+*/
+
+static QShmSegment *qt_shm_get_segment( Display *dpy, int size )
+{
+    if ( shm_state == 0 ) {
+	int major, minor;
+	Bool pixmaps;
+	shm_state = -1;
+	if ( XShmQueryVersion(dpy, &major, &minor, &pixmaps) ) {
+	    shm_dpy = dpy;
+	    shm_completion = XShmGetEventBase( dpy ) + ShmCompletion;
+	    shm_state = 1;
+	    qAddPostRoutine( qt_cleanup_shm_pool );
+	}
+    }
+    if ( shm_state != 1 || dpy != shm_dpy || size < shm_min_bytes )
+	return 0;
+
+    XEvent ev;					// collect finished uploads
+    while ( XCheckIfEvent(dpy, &ev, qt_shm_completion_pred, 0) )
+	qt_x11_shm_event( &ev );
+
+    for ( ;; ) {
+	QShmSegment *fit = 0;			// smallest free that fits
+	QShmSegment *spare = 0;			// free one to reallocate
+	int i;
+	for ( i=0; i<shm_pool_size; i++ ) {
+	    QShmSegment *s = &shm_pool[i];
+	    if ( s->busy )
+		continue;
+	    if ( s->size >= size ) {
+		if ( !fit || s->size < fit->size )
+		    fit = s;
+	    } else if ( !spare || s->size < spare->size ) {
+		spare = s;
+	    }
+	}
+	if ( fit )
+	    return fit;
+	if ( spare ) {
+	    qt_shm_free_segment( spare );
+	    if ( qt_shm_alloc_segment(spare, size) )
+		return spare;
+	    for ( i=0; i<shm_pool_size; i++ ) {
+		if ( shm_pool[i].size )
+		    return 0;
+	    }
+	    shm_state = -1;			// cannot attach at all
+	    return 0;
+	}
+	XIfEvent( dpy, &ev, qt_shm_completion_pred, 0 ); // all busy
+	qt_x11_shm_event( &ev );
+    }
+}
+
+#else
+
+bool qt_x11_shm_event( XEvent * )
+{
+    return FALSE;
+}
+
+#endif // QT_MITSHM
+
+
 /*****************************************************************************
   Internal functions
  *****************************************************************************/
@@ -183,6 +362,132 @@ static uint n_bits( uint v )
     return i;
 }
 
+/*
+  Packing of 8-bit and 32-bit images into TrueColor XImages.  The pixel
+  values of a scanline are computed first and then stored by a loop
+  dedicated to the pixel size and byte order of the XImage.
+*/
+
+struct QTrueColorPacker {
+    uint red_mask, green_mask, blue_mask;
+    int	 red_shift, green_shift, blue_shift;
+    bool d8;					// 8-bit image, use pix
+    uint pix[256];				// pixel translation table
+    int	 bpp;					// bits per pixel of XImage
+    bool msb;					// XImage is MSBFirst
+    bool native;				// XImage is in our byte order
+};
+
+static inline uint qt_truecolor_pixel( const QTrueColorPacker *pk, QRgb rgb )
+{
+    int r = qRed  ( rgb );
+    int g = qGreen( rgb );
+    int b = qBlue ( rgb );
+    r = pk->red_shift	> 0 ? r << pk->red_shift   : r >> -pk->red_shift;
+    g = pk->green_shift > 0 ? g << pk->green_shift : g >> -pk->green_shift;
+    b = pk->blue_shift	> 0 ? b << pk->blue_shift  : b >> -pk->blue_shift;
+    return (b & pk->blue_mask) | (g & pk->green_mask) | (r & pk->red_mask);
+}
+
+static void qt_init_truecolor_packer( QTrueColorPacker *pk, Visual *visual,
+				      XImage *xi, const QImage &image )
+{
+    pk->red_mask    = (uint)visual->red_mask;
+    pk->green_mask  = (uint)visual->green_mask;
+    pk->blue_mask   = (uint)visual->blue_mask;
+    pk->red_shift   = highest_bit( pk->red_mask )   - 7;
+    pk->green_shift = highest_bit( pk->green_mask ) - 7;
+    pk->blue_shift  = highest_bit( pk->blue_mask )  - 7;
+    pk->d8  = image.depth() == 8;
+    pk->bpp = xi->bits_per_pixel;
+    pk->msb = xi->byte_order == MSBFirst;
+    pk->native = pk->msb == (QImage::systemByteOrder() == QImage::BigEndian);
+    if ( pk->d8 ) {				// setup pixel translation
+	QRgb *ctable = image.colorTable();
+	for ( int i=0; i<image.numColors(); i++ )
+	    pk->pix[i] = qt_truecolor_pixel( pk, ctable[i] );
+    }
+}
+
+/*
+  Packs \a w pixels of \a src into \a dst.  \a buf has room for \a w
+  pixel values.
+*/
+
+static void qt_pack_truecolor_row( const QTrueColorPacker *pk,
+				   const uchar *src, uchar *dst, int w,
+				   uint *buf )
+{
+    register uint *pixel = pk->bpp == 32 && pk->native ? (uint *)dst : buf;
+    register int x;
+    if ( pk->d8 ) {
+	for ( x=0; x<w; x++ )
+	    pixel[x] = pk->pix[src[x]];
+    } else {
+	register const QRgb *p = (const QRgb *)src;
+	for ( x=0; x<w; x++ )
+	    pixel[x] = qt_truecolor_pixel( pk, p[x] );
+    }
+    switch ( pk->bpp ) {
+	case 8:
+	    for ( x=0; x<w; x++ )
+		dst[x] = pixel[x];
+	    break;
+	case 16:
+	    if ( pk->native ) {
+		register ushort *d = (ushort *)dst;
+		for ( x=0; x<w; x++ )
+		    d[x] = pixel[x];
+	    } else if ( pk->msb ) {
+		for ( x=0; x<w; x++ ) {
+		    *dst++ = pixel[x] >> 8;
+		    *dst++ = pixel[x];
+		}
+	    } else {
+		for ( x=0; x<w; x++ ) {
+		    *dst++ = pixel[x];
+		    *dst++ = pixel[x] >> 8;
+		}
+	    }
+	    break;
+	case 24:
+	    if ( pk->msb ) {
+		for ( x=0; x<w; x++ ) {
+		    *dst++ = pixel[x] >> 16;
+		    *dst++ = pixel[x] >> 8;
+		    *dst++ = pixel[x];
+		}
+	    } else {
+		for ( x=0; x<w; x++ ) {
+		    *dst++ = pixel[x];
+		    *dst++ = pixel[x] >> 8;
+		    *dst++ = pixel[x] >> 16;
+		}
+	    }
+	    break;
+	case 32:
+	    if ( pk->native )			// already in place
+		break;
+	    if ( pk->msb ) {
+		for ( x=0; x<w; x++ ) {
+		    *dst++ = pixel[x] >> 24;
+		    *dst++ = pixel[x] >> 16;
+		    *dst++ = pixel[x] >> 8;
+		    *dst++ = pixel[x];
+		}
+	    } else {
+		for ( x=0; x<w; x++ ) {
+		    *dst++ = pixel[x];
+		    *dst++ = pixel[x] >> 8;
+		    *dst++ = pixel[x] >> 16;
+		    *dst++ = pixel[x] >> 24;
+		}
+	    }
+	    break;
+    }
+}
+
+
 static uint *red_scale_table   = 0;
 static uint *green_scale_table = 0;
 static uint *blue_scale_table  = 0;
@@ -475,7 +780,10 @@ int QPixmap::defaultDepth()
   <ul>
   <li> \c QPixmap::NoOptim, avoid optimization. Little or no caching is
   done. Use this setting if memory is scarce and the speed of pixmap
-  operations is not critical to your application.
+  operations is not critical to your application.  On local TrueColor
+  displays this setting also lets convertFromImage() upload large
+  images through shared memory, which makes it the best choice for
+  pixmaps that get a new image for every frame.
   <li> \c QPixmap::NormalOptim, normal optimization to make pixmap drawing
   faster. This option is the default and is suitable for most purposes.
   <li> \c QPixmap::BestOptim, heavily optimized pixmap drawing. Use this
@@ -976,10 +1284,16 @@ QImage QPixmap::convertToImage() const
   Note that even though a QPixmap with depth 1 behaves much like a
   QBitmap, isQBitmap() returns FALSE.
 
+  On a local TrueColor display with the MIT-SHM extension, large images
+  are sent to the X server through shared memory if the pixmap's
+  optimization() is \c NoOptim.  Set that with setOptimization() or
+  setDefaultOptimization() for pixmaps that are converted often, like
+  the frames of a video.
+
   \bug Does not support 2 or 4 bit display hardware.
 
   \sa convertToImage(), isQBitmap(), QImage::convertDepth(), defaultDepth(),
-    hasAlphaBuffer()
+    hasAlphaBuffer(), setOptimization()
 */
 
 bool QPixmap::convertFromImage( const QImage &img, int conversion_flags )
@@ -1086,97 +1400,41 @@ bool QPixmap::convertFromImage( const QImage &img, int conversion_flags )
     int	    nbytes = image.numBytes();
     uchar  *newbits= 0;
     register uchar *p;
+#if defined(QT_MITSHM)
+    QShmSegment *shmseg = 0;
+#endif
 
     if ( trucol ) {				// truecolor display
-	QRgb  pix[256];				// pixel translation table
-	bool  d8 = d == 8;
-	uint  red_mask	  = (uint)visual->red_mask;
-	uint  green_mask  = (uint)visual->green_mask;
-	uint  blue_mask	  = (uint)visual->blue_mask;
-	int   red_shift	  = highest_bit( red_mask )   - 7;
-	int   green_shift = highest_bit( green_mask ) - 7;
-	int   blue_shift  = highest_bit( blue_mask )  - 7;
-	int   r, g, b;
-
-	if ( d8 ) {				// setup pixel translation
-	    QRgb *ctable = image.colorTable();
-	    for ( int i=0; i<image.numColors(); i++ ) {
-		r = qRed  (ctable[i]);
-		g = qGreen(ctable[i]);
-		b = qBlue (ctable[i]);
-		r = red_shift	> 0 ? r << red_shift   : r >> -red_shift;
-		g = green_shift > 0 ? g << green_shift : g >> -green_shift;
-		b = blue_shift	> 0 ? b << blue_shift  : b >> -blue_shift;
-		pix[i] = (b & blue_mask) | (g & green_mask) | (r & red_mask);
-	    }
-	}
-
-	xi = XCreateImage( dpy, visual, dd, ZPixmap, 0, 0, w, h, 32, 0 );
-	CHECK_PTR( xi );
-	newbits = (uchar *)malloc( xi->bytes_per_line*h );
-	uchar *src;
-	uchar *dst;
-	QRgb   pixel;
-	int    bppc = xi->bits_per_pixel;
-
-	if ( bppc > 8 && xi->byte_order == LSBFirst )
-	    bppc++;
-
-	for ( int y=0; y<h; y++ ) {
-	    QRgb *p;
-	    src = image.scanLine( y );
-	    dst = newbits + xi->bytes_per_line*y;
-	    p	= (QRgb *)src;
-	    for ( int x=0; x<w; x++ ) {
-		if ( d8 ) {
-		    pixel = pix[*src++];
+#if defined(QT_MITSHM)
+	if ( data->opt == NoOptim && shm_state >= 0 ) { // no XImage kept
+	    XShmSegmentInfo info;
+	    xi = XShmCreateImage( dpy, visual, dd, ZPixmap, 0, &info, w, h );
+	    if ( xi ) {
+		shmseg = qt_shm_get_segment( dpy, xi->bytes_per_line*h );
+		if ( shmseg ) {
+		    xi->obdata = (char *)&shmseg->info;
+		    xi->data = shmseg->info.shmaddr;
 		} else {
-		    r = qRed  ( *p );
-		    g = qGreen( *p );
-		    b = qBlue ( *p++ );
-		    r = red_shift   > 0 ? r << red_shift   : r >> -red_shift;
-		    g = green_shift > 0 ? g << green_shift : g >> -green_shift;
-		    b = blue_shift  > 0 ? b << blue_shift  : b >> -blue_shift;
-		    pixel = (b & blue_mask)|(g & green_mask) | (r & red_mask);
-		}
-		switch ( bppc ) {
-		    case 8:
-			*dst++ = pixel;
-			break;
-		    case 16:			// 16 bit MSB
-			*dst++ = (pixel >> 8);
-			*dst++ = pixel;
-			break;
-		    case 17:			// 16 bit LSB
-			*dst++ = pixel;
-			*dst++ = pixel >> 8;
-			break;
-		    case 24:			// 24 bit MSB
-			*dst++ = pixel >> 16;
-			*dst++ = pixel >> 8;
-			*dst++ = pixel;
-			break;
-		    case 25:			// 24 bit LSB
-			*dst++ = pixel;
-			*dst++ = pixel >> 8;
-			*dst++ = pixel >> 16;
-			break;
-		    case 32:			// 32 bit MSB
-			*dst++ = pixel >> 24;
-			*dst++ = pixel >> 16;
-			*dst++ = pixel >> 8;
-			*dst++ = pixel;
-			break;
-		    case 33:			// 32 bit LSB
-			*dst++ = pixel;
-			*dst++ = pixel >> 8;
-			*dst++ = pixel >> 16;
-			*dst++ = pixel >> 24;
-			break;
+		    XDestroyImage( xi );
+		    xi = 0;
 		}
 	    }
 	}
-	xi->data = (char *)newbits;
+#endif
+	if ( !xi ) {
+	    xi = XCreateImage( dpy, visual, dd, ZPixmap, 0, 0, w, h, 32, 0 );
+	    CHECK_PTR( xi );
+	    xi->data = (char *)malloc( xi->bytes_per_line*h );
+	    CHECK_PTR( xi->data );
+	}
+	QTrueColorPacker pk;
+	qt_init_truecolor_packer( &pk, visual, xi, image );
+	uint *buf = new uint[w];
+	for ( int y=0; y<h; y++ )
+	    qt_pack_truecolor_row( &pk, image.scanLine(y),
+				   (uchar *)xi->data + xi->bytes_per_line*y,
+				   w, buf );
+	delete [] buf;
     }
 
     if ( d == 8 && !trucol ) {			// 8 bit pixmap
@@ -1333,11 +1591,22 @@ bool QPixmap::convertFromImage( const QImage &img, int conversion_flags )
     if ( !hd )					// create new pixmap
 	hd = (HANDLE)XCreatePixmap( dpy, DefaultRootWindow(dpy), w, h, dd );
 
-    XPutImage( dpy, hd, qt_xget_readonly_gc(), xi, 0, 0, 0, 0, w, h );
-    if ( data->opt == NoOptim ) {		// throw away image
-	qSafeXDestroyImage( xi );
-    } else {					// keep ximage that we created
-	data->ximage = xi;
+#if defined(QT_MITSHM)
+    if ( shmseg ) {				// send, but don't wait for it
+	XShmPutImage( dpy, hd, qt_xget_readonly_gc(), xi, 0, 0, 0, 0, w, h,
+		      TRUE );
+	shmseg->busy = TRUE;
+	xi->data = 0;				// the segment is not ours
+	XDestroyImage( xi );
+    } else
+#endif
+    {
+	XPutImage( dpy, hd, qt_xget_readonly_gc(), xi, 0, 0, 0, 0, w, h );
+	if ( data->opt == NoOptim ) {		// throw away image
+	    qSafeXDestroyImage( xi );
+	} else {				// keep ximage that we created
+	    data->ximage = xi;
+	}
     }
     data->w = w;  data->h = h;	data->d = dd;
 
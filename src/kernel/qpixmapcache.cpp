@@ -22,7 +22,10 @@
 *****************************************************************************/
 
 #include "qpixmapcache.h"
-#include "qcache.h"
+#include "qdict.h"
+#include "qbitmap.h"
+#include "qapplication.h"
+#include <string.h>
 
 /*!
   \class QPixmapCache qpixmapcache.h
@@ -47,25 +50,402 @@
   application-global.
 
   QPixmapCache contains no member data, only static functions to access
-  the global pixmap cache.  It creates an internal QCache for caching the
-  pixmaps.
+  the global pixmap cache.
 
-  The cache associates a pixmap with a normal string (key).  If two
-  pixmaps are inserted into the cache using equal keys, then the last
-  pixmap will hide the first pixmap. The QDict and QCache classes do
-  exactly the same.
+  The cache associates a pixmap with a normal string (key).  If a pixmap
+  is inserted with the key of a pixmap that is already in the cache, the
+  old pixmap is removed, unless it is the very same pixmap.
 
   The cache becomes full when the total size of all pixmaps in the cache
   exceeds the cache limit.  The initial cache limit is 1024 KByte (1
-  MByte).  A pixmap takes roughly width*height*depth/8 bytes of memory.
+  MByte).  The size of a pixmap is the number of bytes the window system
+  needs to store it and its mask, see cost().
+
+  Two replacement policies are available, see setPolicy().  The default
+  is to throw out the least recently used pixmaps first.
+
+  The part of a key up to the first colon is its namespace, for example
+  "icons" in "icons:fileopen".  Keys without a colon are in the default
+  namespace, the empty string.  A namespace can be cleared on its own
+  and statistics() keeps hit, miss and eviction counts for each of
+  them, which tells you whether the cache is big enough for the pixmaps
+  you use.
+*/
+
+/*!
+  \enum QPixmapCache::Policy
+
+  This enum type decides which pixmaps are thrown out when the cache
+  is full:
+  <ul>
+  <li> \c LRU - the least recently used pixmap goes first.
+  <li> \c TwoQueue - pixmaps that have been used once go into a small
+  FIFO queue, and only those found again after they fell out of it are
+  kept in the LRU queue.  This keeps a stream of pixmaps that are drawn
+  only once from flushing the pixmaps that are drawn over and over.
+  </ul>
+*/
 
-  See the QCache documentation for a more details about the cache mechanism.
+/*!
+  \class QPixmapCache::Statistics qpixmapcache.h
+  \brief The Statistics struct holds the counters returned by
+  QPixmapCache::statistics().
+
+  The members are \c hits, \c misses, \c insertions, \c evictions,
+  \c count (number of pixmaps in the cache) and \c bytes (the bytes they
+  use).
 */
 
-typedef Q_DECLARE(QCacheM,QPixmap) QPMCache;
+
+/*****************************************************************************
+  The cache is a dictionary of entries which are linked into one of three
+  queues.  With the LRU policy only the main queue is used.  With the
+  TwoQueue policy new pixmaps go into the "in" FIFO; when they fall out
+  of it the pixmap is deleted but the key is remembered in the "out"
+  queue, and a pixmap which is inserted again while its key is
+  remembered goes into the main queue.
+ *****************************************************************************/
+
+struct QPMCacheSpace {				// a key namespace
+    QPixmapCache::Statistics st;
+};
+
+typedef Q_DECLARE(QDictM,QPMCacheSpace) QPMCacheSpaceDict;
+typedef Q_DECLARE(QDictIteratorM,QPMCacheSpace) QPMCacheSpaceIt;
+
+enum { QueueMain, QueueIn, QueueOut, NQueues };
+
+struct QPMCacheEntry {
+    char	   *key;
+    QPixmap	   *pm;				// 0 if only remembered
+    int		    cost;
+    int		    queue;
+    QPMCacheEntry  *prev;			// towards the newer end
+    QPMCacheEntry  *next;			// towards the older end
+    QPMCacheSpace  *space;
+};
+
+typedef Q_DECLARE(QDictM,QPMCacheEntry) QPMCacheDict;
+
+struct QPMCacheQueue {
+    QPMCacheEntry  *first;			// newest
+    QPMCacheEntry  *last;			// oldest
+    int		    bytes;
+};
+
+class QPMCache
+{
+public:
+    QPMCache( int maxCost );
+   ~QPMCache();
+
+    QPixmap *find( const char *key );
+    bool     insert( const char *key, QPixmap *, int cost );
+    bool     remove( const char *key );
+    void     clear( const char *prefix );
+    void     setMaxCost( int );
+    void     setPolicy( QPixmapCache::Policy );
+
+private:
+    void     link( QPMCacheEntry *, int queue );
+    void     unlink( QPMCacheEntry * );
+    void     deleteEntry( QPMCacheEntry * );
+    void     forget( QPMCacheEntry * );
+    void     evict( QPMCacheEntry * );
+    void     makeRoomFor( int cost );
+
+    QPMCacheDict  dict;
+    QPMCacheQueue queues[NQueues];
+    int		  mCost;
+    int		  tCost;
+};
+
 static QPMCache *pm_cache = 0;			// global pixmap cache
 const  int cache_size	  = 61;			// size of internal hash array
 static int cache_limit	  = 1024;		// 1024 KB cache limit
+static QPixmapCache::Policy cache_policy = QPixmapCache::LRU;
+
+static QPMCacheSpace	 *pm_total  = 0;	// statistics for all keys
+static QPMCacheSpaceDict *pm_spaces = 0;	// statistics per namespace
+
+static void cleanup_pm_stats()
+{
+    QPixmapCache::clear();
+    delete pm_spaces;
+    pm_spaces = 0;
+    delete pm_total;
+    pm_total = 0;
+}
+
+static void init_pm_stats()
+{
+    qAddPostRoutine( cleanup_pm_stats );
+    pm_total = new QPMCacheSpace;
+    CHECK_PTR( pm_total );
+    memset( &pm_total->st, 0, sizeof(pm_total->st) );
+    pm_spaces = new QPMCacheSpaceDict( 17 );
+    CHECK_PTR( pm_spaces );
+    pm_spaces->setAutoDelete( TRUE );
+}
+
+/*
+  Returns the namespace of \a key, creating it if \a create is TRUE.
+  A \a key without a colon is in the default namespace, unless it is a
+  \a prefix.
+*/
+
+static QPMCacheSpace *find_space( const char *key, bool create,
+				  bool prefix=FALSE )
+{
+    if ( !pm_total )
+	init_pm_stats();
+    const char *colon = strchr( key, ':' );
+    int len = colon ? (int)(colon - key) : (prefix ? (int)strlen(key) : 0);
+    char buf[64];
+    char *name = len < (int)sizeof(buf) ? buf : new char[len+1];
+    if ( len )
+	memcpy( name, key, len );
+    name[len] = '\0';
+    QPMCacheSpace *s = pm_spaces->find( name );
+    if ( !s && create ) {
+	s = new QPMCacheSpace;
+	CHECK_PTR( s );
+	memset( &s->st, 0, sizeof(s->st) );
+	pm_spaces->insert( name, s );
+    }
+    if ( name != buf )
+	delete [] name;
+    return s;
+}
+
+
+QPMCache::QPMCache( int maxCost )
+    : dict( cache_size, TRUE, FALSE )		// keys are in the entries
+{
+    for ( int i=0; i<NQueues; i++ ) {
+	queues[i].first = queues[i].last = 0;
+	queues[i].bytes = 0;
+    }
+    mCost = maxCost;
+    tCost = 0;
+}
+
+QPMCache::~QPMCache()
+{
+    clear( 0 );
+}
+
+void QPMCache::link( QPMCacheEntry *e, int queue )
+{
+    QPMCacheQueue *q = &queues[queue];
+    e->queue = queue;
+    e->prev = 0;
+    e->next = q->first;
+    if ( q->first )
+	q->first->prev = e;
+    else
+	q->last = e;
+    q->first = e;
+    q->bytes += e->cost;
+}
+
+void QPMCache::unlink( QPMCacheEntry *e )
+{
+    QPMCacheQueue *q = &queues[e->queue];
+    if ( e->prev )
+	e->prev->next = e->next;
+    else
+	q->first = e->next;
+    if ( e->next )
+	e->next->prev = e->prev;
+    else
+	q->last = e->prev;
+    q->bytes -= e->cost;
+}
+
+/*
+  Deletes the pixmap of \a e and updates the counters.
+*/
+
+void QPMCache::forget( QPMCacheEntry *e )
+{
+    if ( !e->pm )
+	return;
+    delete e->pm;
+    e->pm = 0;
+    tCost -= e->cost;
+    e->space->st.count--;
+    e->space->st.bytes -= e->cost;
+    pm_total->st.count--;
+    pm_total->st.bytes -= e->cost;
+}
+
+void QPMCache::deleteEntry( QPMCacheEntry *e )
+{
+    unlink( e );
+    forget( e );
+    dict.take( e->key );
+    delete [] e->key;
+    delete e;
+}
+
+/*
+  Throws \a e out of the cache to make room.
+*/
+
+void QPMCache::evict( QPMCacheEntry *e )
+{
+    e->space->st.evictions++;
+    pm_total->st.evictions++;
+    if ( e->queue != QueueIn ) {
+	deleteEntry( e );
+	return;
+    }
+    unlink( e );				// remember the key
+    forget( e );
+    link( e, QueueOut );
+    while ( queues[QueueOut].bytes > mCost/2 )
+	deleteEntry( queues[QueueOut].last );
+}
+
+void QPMCache::makeRoomFor( int cost )
+{
+    QPMCacheQueue *in = &queues[QueueIn];
+    QPMCacheQueue *main = &queues[QueueMain];
+    while ( tCost + cost > mCost ) {
+	if ( in->last && (in->bytes > mCost/4 || !main->last) )
+	    evict( in->last );
+	else if ( main->last )
+	    evict( main->last );
+	else
+	    break;
+    }
+}
+
+QPixmap *QPMCache::find( const char *key )
+{
+    QPMCacheEntry *e = dict.find( key );
+    QPMCacheSpace *s = e ? e->space : find_space( key, TRUE );
+    if ( !e || !e->pm ) {
+	s->st.misses++;
+	pm_total->st.misses++;
+	return 0;
+    }
+    s->st.hits++;
+    pm_total->st.hits++;
+    if ( e->queue == QueueMain && e->prev ) {	// most recently used
+	unlink( e );
+	link( e, QueueMain );
+    }
+    return e->pm;
+}
+
+bool QPMCache::insert( const char *key, QPixmap *pm, int cost )
+{
+    QPMCacheEntry *e = dict.find( key );
+    if ( e && e->pm == pm ) {			// already cached, e.g. by find()
+	unlink( e );				// so that it is not evicted
+	tCost -= e->cost;
+	e->space->st.bytes -= e->cost;
+	pm_total->st.bytes -= e->cost;
+	makeRoomFor( cost );
+	e->cost = cost;
+	link( e, QueueMain );
+	tCost += cost;
+	e->space->st.bytes += cost;
+	pm_total->st.bytes += cost;
+	return TRUE;
+    }
+    if ( cost > mCost )
+	return FALSE;
+    int queue = cache_policy == QPixmapCache::LRU ? QueueMain : QueueIn;
+    if ( e ) {
+	if ( e->queue == QueueOut )		// seen before, keep it
+	    queue = QueueMain;
+	deleteEntry( e );
+    }
+    makeRoomFor( cost );
+    e = new QPMCacheEntry;
+    CHECK_PTR( e );
+    e->key = qstrdup( key );
+    e->pm = pm;
+    e->cost = cost;
+    e->space = find_space( key, TRUE );
+    dict.insert( e->key, e );
+    link( e, queue );
+    tCost += cost;
+    e->space->st.insertions++;
+    e->space->st.count++;
+    e->space->st.bytes += cost;
+    pm_total->st.insertions++;
+    pm_total->st.count++;
+    pm_total->st.bytes += cost;
+    return TRUE;
+}
+
+bool QPMCache::remove( const char *key )
+{
+    QPMCacheEntry *e = dict.find( key );
+    if ( !e )
+	return FALSE;
+    bool cached = e->pm != 0;
+    deleteEntry( e );
+    return cached;
+}
+
+/*
+  Removes the entries in the namespace of \a prefix, or all if \a prefix
+  is 0.
+*/
+
+void QPMCache::clear( const char *prefix )
+{
+    QPMCacheSpace *s = prefix ? find_space( prefix, FALSE, TRUE ) : 0;
+    if ( prefix && !s )
+	return;
+    for ( int i=0; i<NQueues; i++ ) {
+	QPMCacheEntry *e = queues[i].first;
+	while ( e ) {
+	    QPMCacheEntry *next = e->next;
+	    if ( !s || e->space == s )
+		deleteEntry( e );
+	    e = next;
+	}
+    }
+}
+
+void QPMCache::setMaxCost( int maxCost )
+{
+    mCost = maxCost;
+    makeRoomFor( 0 );
+    while ( queues[QueueOut].bytes > mCost/2 )
+	deleteEntry( queues[QueueOut].last );
+}
+
+void QPMCache::setPolicy( QPixmapCache::Policy p )
+{
+    if ( p != QPixmapCache::LRU )
+	return;					// the main queue is an LRU queue
+    while ( queues[QueueOut].last )
+	deleteEntry( queues[QueueOut].last );
+    QPMCacheEntry *e;
+    while ( (e = queues[QueueIn].first) ) {	// oldest ones end up last
+	unlink( e );
+	link( e, QueueMain );
+    }
+}
+
+
+static QPMCache *pixmap_cache()
+{
+    if ( !pm_cache ) {				// create pixmap cache
+	if ( !pm_total )
+	    init_pm_stats();
+	pm_cache = new QPMCache( 1024*cache_limit );
+	CHECK_PTR( pm_cache );
+    }
+    return pm_cache;
+}
 
 
 /*!
@@ -96,7 +476,7 @@ static int cache_limit	  = 1024;		// 1024 KB cache limit
 
 QPixmap *QPixmapCache::find( const char *key )
 {
-    return pm_cache ? pm_cache->find(key) : 0;
+    return pixmap_cache()->find( key );
 }
 
 
@@ -118,7 +498,7 @@ QPixmap *QPixmapCache::find( const char *key )
 
 bool QPixmapCache::find( const char *key, QPixmap& pm )
 {
-    QPixmap* p = pm_cache ? pm_cache->find(key) : 0;
+    QPixmap* p = pixmap_cache()->find( key );
     if ( p ) pm = *p;
     return !!p;
 }
@@ -141,12 +521,7 @@ bool QPixmapCache::find( const char *key, QPixmap& pm )
 
 bool QPixmapCache::insert( const char *key, QPixmap *pm )
 {
-    if ( !pm_cache ) {				// create pixmap cache
-	pm_cache = new QPMCache( 1024*cache_limit, cache_size );
-	CHECK_PTR( pm_cache );
-	pm_cache->setAutoDelete( TRUE );
-    }
-    return pm_cache->insert( key, pm, pm->width()*pm->height()*pm->depth()/8 );
+    return pixmap_cache()->insert( key, pm, cost(*pm) );
 }
 
 /*!
@@ -158,25 +533,28 @@ bool QPixmapCache::insert( const char *key, QPixmap *pm )
 
   When a pixmap is inserted and the cache is about to exceed its limit, it
   removes pixmaps until there is enough room for the pixmap to be inserted.
-
-  The oldest pixmaps (least recently accessed in the cache) are deleted
-  when more space is needed.
+  Which pixmaps are removed depends on the policy().
 
   \sa setCacheLimit().
 */
 
 void QPixmapCache::insert( const char *key, const QPixmap& pm )
 {
-    if ( !pm_cache ) {				// create pixmap cache
-	pm_cache = new QPMCache( 1024*cache_limit, cache_size );
-	CHECK_PTR( pm_cache );
-	pm_cache->setAutoDelete( TRUE );
-    }
     QPixmap *p = new QPixmap(pm);
-    if ( !pm_cache->insert( key, p, p->width()*p->height()*p->depth()/8 ) )
+    if ( !pixmap_cache()->insert( key, p, cost(*p) ) )
 	delete p;
 }
 
+/*!
+  Removes the pixmap associated with \a key from the cache.  Returns
+  TRUE if there was such a pixmap.
+*/
+
+bool QPixmapCache::remove( const char *key )
+{
+    return pm_cache ? pm_cache->remove( key ) : FALSE;
+}
+
 /*!
   Returns the cache limit (in kilobytes).
 
@@ -205,6 +583,31 @@ void QPixmapCache::setCacheLimit( int n )
 	pm_cache->setMaxCost( 1024*cache_limit );
 }
 
+/*!
+  Returns the replacement policy of the cache.  The default is
+  QPixmapCache::LRU.
+*/
+
+QPixmapCache::Policy QPixmapCache::policy()
+{
+    return cache_policy;
+}
+
+/*!
+  Sets the replacement policy of the cache to \a p.
+
+  Pixmaps already in the cache stay there.
+
+  \sa policy()
+*/
+
+void QPixmapCache::setPolicy( Policy p )
+{
+    cache_policy = p;
+    if ( pm_cache )
+	pm_cache->setPolicy( p );
+}
+
 
 /*!
   Removes all pixmaps from the cache.
@@ -215,3 +618,83 @@ void QPixmapCache::clear()
     delete pm_cache;
     pm_cache = 0;
 }
+
+/*!
+  Removes all pixmaps in the namespace \a prefix from the cache.
+  If \a prefix contains a colon only the part before it is used, so you
+  can pass a full key as well.  Pass an empty string for the default
+  namespace.
+*/
+
+void QPixmapCache::clear( const char *prefix )
+{
+    if ( pm_cache )
+	pm_cache->clear( prefix ? prefix : "" );
+}
+
+/*!
+  Returns the number of bytes the cache counts for \a pm.
+
+  This is the size of the pixmap data on the server, with each scan line
+  padded to 32 bits and pixels of depth 2 to 8, 9 to 16 and 17 to 32 bits
+  stored in 1, 2 and 4 bytes, plus the size of the mask if the pixmap has
+  one.
+*/
+
+int QPixmapCache::cost( const QPixmap &pm )
+{
+    int d = pm.depth();
+    int bpp;
+    if ( d <= 1 )
+	bpp = 1;
+    else if ( d <= 8 )
+	bpp = 8;
+    else if ( d <= 16 )
+	bpp = 16;
+    else
+	bpp = 32;
+    int bytes = (pm.width()*bpp + 31)/32*4 * pm.height();
+    const QBitmap *mask = pm.mask();
+    if ( mask )
+	bytes += (mask->width() + 31)/32*4 * mask->height();
+    return bytes;
+}
+
+/*!
+  Returns the statistics for the namespace \a prefix (which is used
+  like in clear()), or for the whole cache if \a prefix is 0.
+
+  The counters are kept until resetStatistics() is called, also when
+  pixmaps are removed with clear().
+*/
+
+QPixmapCache::Statistics QPixmapCache::statistics( const char *prefix )
+{
+    if ( !pm_total )
+	init_pm_stats();
+    QPMCacheSpace *s = prefix ? find_space( prefix, FALSE, TRUE ) : pm_total;
+    if ( s )
+	return s->st;
+    Statistics st;
+    memset( &st, 0, sizeof(st) );
+    return st;
+}
+
+/*!
+  Sets the hit, miss, insertion and eviction counters of all namespaces
+  to zero.
+*/
+
+void QPixmapCache::resetStatistics()
+{
+    if ( !pm_total )
+	return;
+    QPMCacheSpaceIt it( *pm_spaces );
+    QPMCacheSpace *s = pm_total;
+    while ( s ) {
+	s->st.hits = s->st.misses = 0;
+	s->st.insertions = s->st.evictions = 0;
+	s = it.current();
+	++it;
+    }
+}
@@ -32,13 +32,31 @@
 class Q_EXPORT QPixmapCache				// global pixmap cache
 {
 public:
+    enum Policy { LRU, TwoQueue };
+
+    struct Statistics {
+	int	hits;
+	int	misses;
+	int	insertions;
+	int	evictions;
+	int	count;				// pixmaps in the cache
+	int	bytes;				// bytes used by them
+    };
+
     static  int		cacheLimit();
     static  void	setCacheLimit( int );
+    static  Policy	policy();
+    static  void	setPolicy( Policy );
     static  QPixmap    *find( const char *key );
     static  bool	find( const char *key, QPixmap& );
     static  bool	insert( const char *key, QPixmap * );
     static  void	insert( const char *key, const QPixmap& );
+    static  bool	remove( const char *key );
     static  void	clear();
+    static  void	clear( const char *prefix );
+    static  int		cost( const QPixmap & );
+    static  Statistics	statistics( const char *prefix=0 );
+    static  void	resetStatistics();
 };
 
 
@@ -833,6 +833,10 @@ QDataStream &operator<<( QDataStream &s, const QPointArray &a )
     register uint i;
     uint len = a.size();
     s << len;					// write size of array
+#if !defined(_WS_MAC_)
+    if ( sizeof(Qpnta_t) == sizeof(Q_INT16) )	// x,y pairs of INT16
+	return s.writeArray( (const Q_INT16 *)a.data(), 2*len );
+#endif
     for ( i=0; i<len; i++ )			// write each point
 	s << a.point( i );
     return s;
@@ -850,6 +854,10 @@ QDataStream &operator>>( QDataStream &s, QPointArray &a )
     s >> len;					// read size of array
     if ( !a.resize( len ) )			// no memory
 	return s;
+#if !defined(_WS_MAC_)
+    if ( sizeof(Qpnta_t) == sizeof(Q_INT16) )
+	return s.readArray( (Q_INT16 *)a.data(), 2*len );
+#endif
     QPoint p;
     for ( i=0; i<len; i++ ) {			// read each point
 	s >> p;
@@ -31,6 +31,13 @@
 #endif // QT_H
 
 
+#if defined(_WS_X11_)
+struct QRegionBox {				// internal, x2 and y2 exclusive
+    int x1, y1, x2, y2;
+};
+#endif
+
+
 class Q_EXPORT QRegion
 {
 public:
@@ -59,6 +66,12 @@ public:
 
     QRegion eor( const QRegion & )	const;
 
+    QRegion &operator|=( const QRegion & );
+    QRegion &operator&=( const QRegion & );
+    QRegion &operator-=( const QRegion & );
+    QRegion &operator^=( const QRegion & );
+    void    uniteRects( const QRect *rects, int n );
+
     QRect   boundingRect() const;
     QArray<QRect> rects() const;
 
@@ -71,7 +84,7 @@ public:
 #elif defined(_WS_PM_)
     HANDLE  handle() const { return data->rgn; }
 #elif defined(_WS_X11_)
-    Region  handle() const { return data->rgn; }
+    Region  handle() const;
 #endif
 
     friend Q_EXPORT QDataStream &operator<<( QDataStream &, const QRegion & );
@@ -86,13 +99,22 @@ private:
 #endif
     void    cmd( int id, void *, const QRegion * = 0, const QRegion * = 0 );
     void    exec( const QByteArray & );
+#if defined(_WS_X11_)
+    void    combine( const QRegion &, int op );
+    void    setRects( QRegionBox *, int n, int size );
+#endif
     struct QRegionData : public QShared {
 #if defined(_WS_WIN_)
 	HANDLE rgn;
 #elif defined(_WS_PM_)
 	HANDLE rgn;
 #elif defined(_WS_X11_)
-	Region rgn;
+	Region	    rgn;			// X region, made when needed
+	QRegionBox *rects;			// y-x banded rectangles
+	int	    numRects;
+	int	    size;			// allocated, 0 if rects == small
+	QRegionBox  extents;
+	QRegionBox  small[4];			// avoids allocating few rects
 #endif
 	bool   is_null;
     } *data;
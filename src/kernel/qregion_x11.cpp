@@ -26,11 +26,363 @@
 #include "qbuffer.h"
 #include "qimage.h"
 #include "qbitmap.h"
+#include <stdlib.h>
+#include <string.h>
 #define	 GC GC_QQQ
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xos.h>
 
+/*****************************************************************************
+  The region engine
+
+  A region is an array of non-overlapping rectangles sorted in y-x bands,
+  just like X does it: rectangles in a band have the same y1 and y2 and
+  are sorted on x, bands are sorted on y and two neighboring bands never
+  have identical x spans (they are coalesced).  The operations below are
+  all a single merge pass over the bands of both operands.
+
+  The X region is only built when someone asks for handle(), i.e. when
+  a GC is clipped.
+ *****************************************************************************/
+
+/*
+  This is how X represents regions internally.
+*/
+
+struct BOX {
+    short x1, x2, y1, y2;
+};
+
+struct _XRegion {
+    long size;
+    long numRects;
+    BOX *rects;
+    BOX  extents;
+};
+
+enum { RgnOr, RgnAnd, RgnSub, RgnXor };
+
+struct QRegionBuf {				// growing array of boxes
+    QRegionBox *rects;
+    int		n;
+    int		size;
+};
+
+static inline void initBuf( QRegionBuf *b )
+{
+    b->rects = 0;
+    b->n = b->size = 0;
+}
+
+static inline void addBox( QRegionBuf *b, int x1, int y1, int x2, int y2 )
+{
+    if ( b->n == b->size ) {
+	b->size = b->size ? b->size*2 : 8;
+	b->rects = (QRegionBox *)realloc( b->rects,
+					  b->size*sizeof(QRegionBox) );
+	CHECK_PTR( b->rects );
+    }
+    QRegionBox *r = &b->rects[b->n++];
+    r->x1 = x1;
+    r->y1 = y1;
+    r->x2 = x2;
+    r->y2 = y2;
+}
+
+/*
+  Merges the band [cur,n) into the band [prev,cur) above it if they
+  touch and have the same x spans.  Returns the start of the last band.
+*/
+
+static int coalesce( QRegionBuf *b, int prev, int cur )
+{
+    int n = b->n - cur;
+    if ( prev == cur || n != cur - prev )
+	return cur;
+    QRegionBox *p = b->rects + prev;
+    QRegionBox *c = b->rects + cur;
+    if ( p->y2 != c->y1 )
+	return cur;
+    int i;
+    for ( i=0; i<n; i++ ) {
+	if ( p[i].x1 != c[i].x1 || p[i].x2 != c[i].x2 )
+	    return cur;
+    }
+    int y2 = c->y2;
+    for ( i=0; i<n; i++ )
+	p[i].y2 = y2;
+    b->n = cur;
+    return prev;
+}
+
+typedef void (*QRegionOverlapFunc)( QRegionBuf *,
+				    const QRegionBox *, const QRegionBox *,
+				    const QRegionBox *, const QRegionBox *,
+				    int y1, int y2 );
+typedef void (*QRegionNonOverlapFunc)( QRegionBuf *,
+				       const QRegionBox *, const QRegionBox *,
+				       int y1, int y2 );
+
+/*
+  The generic band walker.  For every y range it calls \a overlap where
+  both regions have a band, and \a nonOverlap1 / \a nonOverlap2 (if not
+  0) where only one of them has.
+*/
+
+static void regionOp( QRegionBuf *b,
+		      const QRegionBox *r1, int n1,
+		      const QRegionBox *r2, int n2,
+		      QRegionOverlapFunc overlap,
+		      QRegionNonOverlapFunc nonOverlap1,
+		      QRegionNonOverlapFunc nonOverlap2 )
+{
+    const QRegionBox *r1End = r1 + n1;
+    const QRegionBox *r2End = r2 + n2;
+    const QRegionBox *r1BandEnd, *r2BandEnd;
+    int prevBand = 0;
+    int curBand;
+    int ytop, ybot, top, bot;
+
+    if ( n1 && n2 )
+	ybot = QMIN( r1->y1, r2->y1 );
+    else
+	ybot = n1 ? r1->y1 : (n2 ? r2->y1 : 0);
+    while ( r1 != r1End && r2 != r2End ) {
+	r1BandEnd = r1;
+	while ( r1BandEnd != r1End && r1BandEnd->y1 == r1->y1 )
+	    r1BandEnd++;
+	r2BandEnd = r2;
+	while ( r2BandEnd != r2End && r2BandEnd->y1 == r2->y1 )
+	    r2BandEnd++;
+
+	curBand = b->n;				// part only one has
+	if ( r1->y1 < r2->y1 ) {
+	    top = QMAX( r1->y1, ybot );
+	    bot = QMIN( r1->y2, r2->y1 );
+	    if ( top != bot && nonOverlap1 )
+		(*nonOverlap1)( b, r1, r1BandEnd, top, bot );
+	    ytop = r2->y1;
+	} else if ( r2->y1 < r1->y1 ) {
+	    top = QMAX( r2->y1, ybot );
+	    bot = QMIN( r2->y2, r1->y1 );
+	    if ( top != bot && nonOverlap2 )
+		(*nonOverlap2)( b, r2, r2BandEnd, top, bot );
+	    ytop = r1->y1;
+	} else {
+	    ytop = r1->y1;
+	}
+	if ( b->n != curBand )
+	    prevBand = coalesce( b, prevBand, curBand );
+
+	ybot = QMIN( r1->y2, r2->y2 );		// part both have
+	curBand = b->n;
+	if ( ybot > ytop )
+	    (*overlap)( b, r1, r1BandEnd, r2, r2BandEnd, ytop, ybot );
+	if ( b->n != curBand )
+	    prevBand = coalesce( b, prevBand, curBand );
+
+	if ( r1->y2 == ybot )
+	    r1 = r1BandEnd;
+	if ( r2->y2 == ybot )
+	    r2 = r2BandEnd;
+    }
+
+    const QRegionBox *r = r1, *rEnd = r1End;	// what is left of one
+    QRegionNonOverlapFunc nonOverlap = nonOverlap1;
+    if ( r1 == r1End ) {
+	r = r2;
+	rEnd = r2End;
+	nonOverlap = nonOverlap2;
+    }
+    if ( !nonOverlap )
+	return;
+    while ( r != rEnd ) {
+	const QRegionBox *rBandEnd = r;
+	while ( rBandEnd != rEnd && rBandEnd->y1 == r->y1 )
+	    rBandEnd++;
+	curBand = b->n;
+	(*nonOverlap)( b, r, rBandEnd, QMAX(r->y1, ybot), r->y2 );
+	if ( b->n != curBand )
+	    prevBand = coalesce( b, prevBand, curBand );
+	r = rBandEnd;
+    }
+}
+
+static void unionNonOverlap( QRegionBuf *b,
+			     const QRegionBox *r, const QRegionBox *rEnd,
+			     int y1, int y2 )
+{
+    for ( ; r != rEnd; r++ )
+	addBox( b, r->x1, y1, r->x2, y2 );
+}
+
+static void unionOverlap( QRegionBuf *b,
+			  const QRegionBox *r1, const QRegionBox *r1End,
+			  const QRegionBox *r2, const QRegionBox *r2End,
+			  int y1, int y2 )
+{
+    int x1 = 0, x2 = 0;
+    bool open = FALSE;
+    while ( r1 != r1End || r2 != r2End ) {
+	const QRegionBox *r;			// next span, ordered on x1
+	if ( r2 == r2End || (r1 != r1End && r1->x1 < r2->x1) )
+	    r = r1++;
+	else
+	    r = r2++;
+	if ( open && r->x1 <= x2 ) {		// overlaps or touches
+	    if ( r->x2 > x2 )
+		x2 = r->x2;
+	} else {
+	    if ( open )
+		addBox( b, x1, y1, x2, y2 );
+	    x1 = r->x1;
+	    x2 = r->x2;
+	    open = TRUE;
+	}
+    }
+    if ( open )
+	addBox( b, x1, y1, x2, y2 );
+}
+
+static void intersectOverlap( QRegionBuf *b,
+			      const QRegionBox *r1, const QRegionBox *r1End,
+			      const QRegionBox *r2, const QRegionBox *r2End,
+			      int y1, int y2 )
+{
+    while ( r1 != r1End && r2 != r2End ) {
+	int x1 = QMAX( r1->x1, r2->x1 );
+	int x2 = QMIN( r1->x2, r2->x2 );
+	if ( x1 < x2 )
+	    addBox( b, x1, y1, x2, y2 );
+	if ( r1->x2 < r2->x2 ) {
+	    r1++;
+	} else if ( r2->x2 < r1->x2 ) {
+	    r2++;
+	} else {
+	    r1++;
+	    r2++;
+	}
+    }
+}
+
+static void subtractOverlap( QRegionBuf *b,
+			     const QRegionBox *r1, const QRegionBox *r1End,
+			     const QRegionBox *r2, const QRegionBox *r2End,
+			     int y1, int y2 )
+{
+    int x1 = r1->x1;
+    while ( r1 != r1End && r2 != r2End ) {
+	if ( r2->x2 <= x1 ) {			// subtrahend left of us
+	    r2++;
+	} else if ( r2->x1 <= x1 ) {		// covers our left part
+	    x1 = r2->x2;
+	    if ( x1 >= r1->x2 ) {
+		if ( ++r1 != r1End )
+		    x1 = r1->x1;
+	    } else {
+		r2++;
+	    }
+	} else if ( r2->x1 < r1->x2 ) {		// splits us
+	    addBox( b, x1, y1, r2->x1, y2 );
+	    x1 = r2->x2;
+	    if ( x1 >= r1->x2 ) {
+		if ( ++r1 != r1End )
+		    x1 = r1->x1;
+	    } else {
+		r2++;
+	    }
+	} else {				// right of us
+	    if ( r1->x2 > x1 )
+		addBox( b, x1, y1, r1->x2, y2 );
+	    if ( ++r1 != r1End )
+		x1 = r1->x1;
+	}
+    }
+    while ( r1 != r1End ) {			// the rest is untouched
+	addBox( b, x1, y1, r1->x2, y2 );
+	if ( ++r1 != r1End )
+	    x1 = r1->x1;
+    }
+}
+
+static inline bool boxContains( const QRegionBox &a, const QRegionBox &b )
+{
+    return a.x1 <= b.x1 && a.y1 <= b.y1 && a.x2 >= b.x2 && a.y2 >= b.y2;
+}
+
+static inline bool boxOverlaps( const QRegionBox &a, const QRegionBox &b )
+{
+    return a.x1 < b.x2 && b.x1 < a.x2 && a.y1 < b.y2 && b.y1 < a.y2;
+}
+
+static void bufOp( QRegionBuf *b, int op,
+		   const QRegionBox *r1, int n1, const QRegionBox *r2, int n2 )
+{
+    switch ( op ) {
+	case RgnOr:
+	    regionOp( b, r1, n1, r2, n2,
+		      unionOverlap, unionNonOverlap, unionNonOverlap );
+	    break;
+	case RgnAnd:
+	    regionOp( b, r1, n1, r2, n2, intersectOverlap, 0, 0 );
+	    break;
+	case RgnSub:
+	    regionOp( b, r1, n1, r2, n2, subtractOverlap, unionNonOverlap, 0 );
+	    break;
+	case RgnXor: {				// (r1 - r2) | (r2 - r1)
+	    QRegionBuf s1, s2;
+	    initBuf( &s1 );
+	    initBuf( &s2 );
+	    bufOp( &s1, RgnSub, r1, n1, r2, n2 );
+	    bufOp( &s2, RgnSub, r2, n2, r1, n1 );
+	    bufOp( b, RgnOr, s1.rects, s1.n, s2.rects, s2.n );
+	    free( s1.rects );
+	    free( s2.rects );
+	    break;
+	}
+    }
+}
+
+/*
+  Unites the \a n rectangles \a r into \a b, halving the set each time
+  so that the whole thing takes about n*log(n) steps.
+*/
+
+static void uniteRectRange( QRegionBuf *b, const QRect *r, int n )
+{
+    if ( n == 1 ) {
+	QRect rr = r->normalize();
+	if ( !rr.isEmpty() )
+	    addBox( b, rr.left(), rr.top(), rr.right()+1, rr.bottom()+1 );
+	return;
+    }
+    QRegionBuf b1, b2;
+    initBuf( &b1 );
+    initBuf( &b2 );
+    uniteRectRange( &b1, r, n/2 );
+    uniteRectRange( &b2, r + n/2, n - n/2 );
+    bufOp( b, RgnOr, b1.rects, b1.n, b2.rects, b2.n );
+    free( b1.rects );
+    free( b2.rects );
+}
+
+/*
+  Copies the rectangles of an X region, used for polygons and ellipses.
+*/
+
+static void bufFromXRegion( QRegionBuf *b, Region rgn )
+{
+    BOX *r = rgn->rects;
+    for ( int i=0; i<(int)rgn->numRects; i++, r++ )
+	addBox( b, r->x1, r->y1, r->x2, r->y2 );
+}
+
+
+/*****************************************************************************
+  QRegion member functions
+ *****************************************************************************/
+
 static QRegion *empty_region = 0;
 
 static void cleanup_empty_region()
@@ -39,6 +391,14 @@ static void cleanup_empty_region()
     empty_region = 0;
 }
 
+static void freeRegionData( QRegionBox *rects, int size, Region rgn )
+{
+    if ( size )
+	free( rects );
+    if ( rgn )
+	XDestroyRegion( rgn );
+}
+
 
 /*!
   Constructs an null region.
@@ -64,7 +424,12 @@ QRegion::QRegion( bool is_null )
 {
     data = new QRegionData;
     CHECK_PTR( data );
-    data->rgn = XCreateRegion();
+    data->rgn = 0;
+    data->rects = data->small;
+    data->numRects = 0;
+    data->size = 0;
+    data->extents.x1 = data->extents.y1 = 0;
+    data->extents.x2 = data->extents.y2 = 0;
     data->is_null = is_null;
 }
 
@@ -81,19 +446,28 @@ QRegion::QRegion( const QRect &r, RegionType t )
     QRect rr = r.normalize();
     data = new QRegionData;
     CHECK_PTR( data );
+    data->rgn = 0;
+    data->rects = data->small;
+    data->numRects = 0;
+    data->size = 0;
     data->is_null = FALSE;
     if ( t == Rectangle ) {			// rectangular region
-	data->rgn = XCreateRegion();
-	XRectangle xr;
-	xr.x = rr.x();
-	xr.y = rr.y();
-	xr.width  = rr.width();
-	xr.height = rr.height();
-	XUnionRectWithRegion( &xr, data->rgn, data->rgn );
+	QRegionBox b;
+	b.x1 = rr.left();
+	b.y1 = rr.top();
+	b.x2 = rr.right()+1;
+	b.y2 = rr.bottom()+1;
+	setRects( &b, b.x1 < b.x2 && b.y1 < b.y2 ? 1 : 0, 0 );
     } else if ( t == Ellipse ) {		// elliptic region
 	QPointArray a;
 	a.makeEllipse( rr.x(), rr.y(), rr.width(), rr.height() );
-	data->rgn = XPolygonRegion( (XPoint*)a.data(), a.size(), EvenOddRule );
+	Region rgn = XPolygonRegion( (XPoint*)a.data(), a.size(),
+				     EvenOddRule );
+	QRegionBuf b;
+	initBuf( &b );
+	bufFromXRegion( &b, rgn );
+	XDestroyRegion( rgn );
+	setRects( b.rects, b.n, b.size );
     }
 }
 
@@ -110,9 +484,18 @@ QRegion::QRegion( const QPointArray &a, bool winding )
 {
     data = new QRegionData;
     CHECK_PTR( data );
+    data->rgn = 0;
+    data->rects = data->small;
+    data->numRects = 0;
+    data->size = 0;
     data->is_null = FALSE;
-    data->rgn = XPolygonRegion( (XPoint*)a.data(), a.size(),
-				winding ? WindingRule : EvenOddRule );
+    Region rgn = XPolygonRegion( (XPoint*)a.data(), a.size(),
+				 winding ? WindingRule : EvenOddRule );
+    QRegionBuf b;
+    initBuf( &b );
+    bufFromXRegion( &b, rgn );
+    XDestroyRegion( rgn );
+    setRects( b.rects, b.n, b.size );
 }
 
 
@@ -127,20 +510,19 @@ QRegion::QRegion( const QRegion &r )
     data->ref();
 }
 
-Region qt_x11_bitmapToRegion(const QBitmap& bitmap)
+/*
+  Adds the 1 pixel high spans of each bitmap row as a band, coalescing
+  identical rows.
+*/
+
+static void bufFromBitmap( QRegionBuf *b, const QBitmap &bitmap )
 {
-    Region region = XCreateRegion();
     QImage image = bitmap.convertToImage();
-
-    XRectangle xr;
+    int prevBand = 0;
 
 #define AddSpan \
 	{ \
-	    xr.x = prev1; \
-	    xr.y = y; \
-	    xr.width = x-prev1-1; \
-	    xr.height = 1; \
-	    XUnionRectWithRegion( &xr, region, region ); \
+	    addBox( b, prev1, y, x, y+1 ); \
 	}
 
     // deal with 0<->1 problem (not on X11 anymore)
@@ -153,11 +535,12 @@ Region qt_x11_bitmapToRegion(const QBitmap& bitmap)
 	int w = image.width();
 	uchar all=zero;
 	int prev1 = -1;
+	int curBand = b->n;
 	for (x=0; x<w; ) {
 	    uchar byte = line[x/8];
 	    if ( x>w-8 || byte!=all ) {
 		if ( little ) {
-		    for ( int b=8; b>0 && x<w; b-- ) {
+		    for ( int bit=8; bit>0 && x<w; bit-- ) {
 			if ( !(byte&0x01) == !all ) {
 			    // More of the same
 			} else {
@@ -174,7 +557,7 @@ Region qt_x11_bitmapToRegion(const QBitmap& bitmap)
 			x++;
 		    }
 		} else {
-		    for ( int b=8; b>0 && x<w; b-- ) {
+		    for ( int bit=8; bit>0 && x<w; bit-- ) {
 			if ( !(byte&0x80) == !all ) {
 			    // More of the same
 			} else {
@@ -198,8 +581,18 @@ Region qt_x11_bitmapToRegion(const QBitmap& bitmap)
 	if ( all != zero ) {
 	    AddSpan;
 	}
+	if ( b->n != curBand )
+	    prevBand = coalesce( b, prevBand, curBand );
     }
 
+#undef AddSpan
+}
+
+Region qt_x11_bitmapToRegion(const QBitmap& bitmap)
+{
+    QRegion r( bitmap );
+    Region region = XCreateRegion();
+    XUnionRegion( r.handle(), region, region );
     return region;
 }
 
@@ -214,8 +607,15 @@ QRegion::QRegion( const QBitmap & bm )
 {
     data = new QRegionData;
     CHECK_PTR( data );
+    data->rgn = 0;
+    data->rects = data->small;
+    data->numRects = 0;
+    data->size = 0;
     data->is_null = FALSE;
-    data->rgn = qt_x11_bitmapToRegion(bm);
+    QRegionBuf b;
+    initBuf( &b );
+    bufFromBitmap( &b, bm );
+    setRects( b.rects, b.n, b.size );
 }
 
 /*!
@@ -225,7 +625,7 @@ QRegion::QRegion( const QBitmap & bm )
 QRegion::~QRegion()
 {
     if ( data->deref() ) {
-	XDestroyRegion( data->rgn );
+	freeRegionData( data->rects, data->size, data->rgn );
 	delete data;
     }
 }
@@ -241,7 +641,7 @@ QRegion &QRegion::operator=( const QRegion &r )
 {
     r.data->ref();				// beware of r = r
     if ( data->deref() ) {
-	XDestroyRegion( data->rgn );
+	freeRegionData( data->rects, data->size, data->rgn );
 	delete data;
     }
     data = r.data;
@@ -257,10 +657,69 @@ QRegion &QRegion::operator=( const QRegion &r )
 QRegion QRegion::copy() const
 {
     QRegion r( data->is_null );
-    XUnionRegion( data->rgn, r.data->rgn, r.data->rgn );
+    if ( data->numRects ) {
+	QRegionBuf b;
+	initBuf( &b );
+	for ( int i=0; i<data->numRects; i++ ) {
+	    QRegionBox *x = &data->rects[i];
+	    addBox( &b, x->x1, x->y1, x->x2, x->y2 );
+	}
+	r.setRects( b.rects, b.n, b.size );
+    }
     return r;
 }
 
+/*!
+  \internal
+  Makes \a rects the rectangles of this region, detaching it first.
+  If \a size is non-zero \a rects was allocated with malloc() and the
+  region takes it over.
+*/
+
+void QRegion::setRects( QRegionBox *rects, int n, int size )
+{
+    if ( data->count != 1 ) {
+	QRegionData *d = new QRegionData;
+	CHECK_PTR( d );
+	if ( data->deref() ) {
+	    freeRegionData( data->rects, data->size, data->rgn );
+	    delete data;
+	}
+	data = d;
+    } else {
+	freeRegionData( data->rects, data->size, data->rgn );
+    }
+    data->rgn = 0;
+    data->is_null = FALSE;
+    data->numRects = n;
+    if ( n <= (int)(sizeof(data->small)/sizeof(QRegionBox)) ) {
+	if ( n )
+	    memcpy( data->small, rects, n*sizeof(QRegionBox) );
+	if ( size )
+	    free( rects );
+	data->rects = data->small;
+	data->size = 0;
+    } else {
+	data->rects = rects;
+	data->size = size;
+    }
+    QRegionBox *e = &data->extents;
+    if ( n == 0 ) {
+	e->x1 = e->y1 = e->x2 = e->y2 = 0;
+	return;
+    }
+    e->x1 = data->rects[0].x1;
+    e->y1 = data->rects[0].y1;
+    e->x2 = data->rects[0].x2;
+    e->y2 = data->rects[n-1].y2;
+    for ( int i=1; i<n; i++ ) {
+	if ( data->rects[i].x1 < e->x1 )
+	    e->x1 = data->rects[i].x1;
+	if ( data->rects[i].x2 > e->x2 )
+	    e->x2 = data->rects[i].x2;
+    }
+}
+
 
 /*!
   Returns TRUE if the region is a null region, otherwise FALSE.
@@ -303,7 +762,7 @@ bool QRegion::isNull() const
 
 bool QRegion::isEmpty() const
 {
-    return data->is_null || XEmptyRegion( data->rgn );
+    return data->numRects == 0;
 }
 
 
@@ -314,18 +773,42 @@ bool QRegion::isEmpty() const
 
 bool QRegion::contains( const QPoint &p ) const
 {
-    return XPointInRegion( data->rgn, p.x(), p.y() );
+    int x = p.x();
+    int y = p.y();
+    const QRegionBox *e = &data->extents;
+    if ( x < e->x1 || x >= e->x2 || y < e->y1 || y >= e->y2 )
+	return FALSE;
+    const QRegionBox *r = data->rects;
+    const QRegionBox *end = r + data->numRects;
+    for ( ; r != end && r->y1 <= y; r++ ) {
+	if ( y < r->y2 && x >= r->x1 && x < r->x2 )
+	    return TRUE;
+    }
+    return FALSE;
 }
 
 /*!
-  Returns TRUE if the region contains the rectangle \e r, or FALSE if \e r is
-  outside the region.
+  Returns TRUE if the region overlaps the rectangle \e r, or FALSE if \e r
+  is completely outside the region.
 */
 
 bool QRegion::contains( const QRect &r ) const
 {
-    return XRectInRegion( data->rgn, r.left(), r.right(),
-			  r.width(), r.height() ) != RectangleOut;
+    QRect rr = r.normalize();
+    QRegionBox b;
+    b.x1 = rr.left();
+    b.y1 = rr.top();
+    b.x2 = rr.right()+1;
+    b.y2 = rr.bottom()+1;
+    if ( !boxOverlaps(b, data->extents) )
+	return FALSE;
+    const QRegionBox *x = data->rects;
+    const QRegionBox *end = x + data->numRects;
+    for ( ; x != end && x->y1 < b.y2; x++ ) {
+	if ( boxOverlaps(b, *x) )
+	    return TRUE;
+    }
+    return FALSE;
 }
 
 
@@ -335,10 +818,145 @@ bool QRegion::contains( const QRect &r ) const
 
 void QRegion::translate( int dx, int dy )
 {
-    if ( data == empty_region->data )
+    if ( data->numRects == 0 )
 	return;
     detach();
-    XOffsetRegion( data->rgn, dx, dy );
+    if ( data->rgn ) {
+	XDestroyRegion( data->rgn );
+	data->rgn = 0;
+    }
+    QRegionBox *r = data->rects;
+    for ( int i=0; i<data->numRects; i++, r++ ) {
+	r->x1 += dx;
+	r->x2 += dx;
+	r->y1 += dy;
+	r->y2 += dy;
+    }
+    r = &data->extents;
+    r->x1 += dx;
+    r->x2 += dx;
+    r->y1 += dy;
+    r->y2 += dy;
+}
+
+
+/*!
+  \internal
+  Sets this region to this region combined with \a r.
+*/
+
+void QRegion::combine( const QRegion &r, int op )
+{
+    const QRegionData *d1 = data;
+    const QRegionData *d2 = r.data;
+    int n1 = d1->numRects;
+    int n2 = d2->numRects;
+    const QRegion *result = 0;			// the trivial cases
+    switch ( op ) {
+	case RgnOr:
+	    if ( n2 == 0 || (n1 == 1 && boxContains(d1->extents,d2->extents)) )
+		result = this;
+	    else if ( n1 == 0 ||
+		      (n2 == 1 && boxContains(d2->extents,d1->extents)) )
+		result = &r;
+	    break;
+	case RgnAnd:
+	    if ( n1 == 0 )
+		result = this;
+	    else if ( n2 == 0 )
+		result = &r;
+	    else if ( !boxOverlaps(d1->extents, d2->extents) ) {
+		setRects( 0, 0, 0 );
+		return;
+	    }
+	    break;
+	case RgnSub:
+	    if ( n1 == 0 || n2 == 0 ||
+		 !boxOverlaps(d1->extents, d2->extents) )
+		result = this;
+	    break;
+	case RgnXor:
+	    if ( n2 == 0 )
+		result = this;
+	    else if ( n1 == 0 )
+		result = &r;
+	    break;
+    }
+    if ( result ) {
+	if ( result->data->is_null )		// results are never null
+	    setRects( 0, 0, 0 );
+	else if ( result != this )
+	    *this = *result;
+	return;
+    }
+    QRegionBuf b;
+    initBuf( &b );
+    bufOp( &b, op, d1->rects, n1, d2->rects, n2 );
+    setRects( b.rects, b.n, b.size );
+}
+
+/*!
+  Unites this region with \a r and returns a reference to this region.
+  \sa unite()
+*/
+
+QRegion &QRegion::operator|=( const QRegion &r )
+{
+    combine( r, RgnOr );
+    return *this;
+}
+
+/*!
+  Intersects this region with \a r and returns a reference to this
+  region.
+  \sa intersect()
+*/
+
+QRegion &QRegion::operator&=( const QRegion &r )
+{
+    combine( r, RgnAnd );
+    return *this;
+}
+
+/*!
+  Subtracts \a r from this region and returns a reference to this
+  region.
+  \sa subtract()
+*/
+
+QRegion &QRegion::operator-=( const QRegion &r )
+{
+    combine( r, RgnSub );
+    return *this;
+}
+
+/*!
+  Sets this region to this region XOR \a r and returns a reference to
+  this region.
+  \sa eor()
+*/
+
+QRegion &QRegion::operator^=( const QRegion &r )
+{
+    combine( r, RgnXor );
+    return *this;
+}
+
+/*!
+  Unites the \a n rectangles in \a rects with this region.  This is much
+  faster than uniting them one by one.
+*/
+
+void QRegion::uniteRects( const QRect *rects, int n )
+{
+    if ( n <= 0 )
+	return;
+    QRegion tmp( FALSE );
+    QRegionBuf b;
+    initBuf( &b );
+    uniteRectRange( &b, rects, n );
+    tmp.setRects( b.rects, b.n, b.size );
+    combine( tmp, RgnOr );
 }
 
 
@@ -348,8 +966,8 @@ void QRegion::translate( int dx, int dy )
 
 QRegion QRegion::unite( const QRegion &r ) const
 {
-    QRegion result( FALSE );
-    XUnionRegion( data->rgn, r.data->rgn, result.data->rgn );
+    QRegion result( *this );
+    result.combine( r, RgnOr );
     return result;
 }
 
@@ -359,8 +977,8 @@ QRegion QRegion::unite( const QRegion &r ) const
 
 QRegion QRegion::intersect( const QRegion &r ) const
 {
-    QRegion result( FALSE );
-    XIntersectRegion( data->rgn, r.data->rgn, result.data->rgn );
+    QRegion result( *this );
+    result.combine( r, RgnAnd );
     return result;
 }
 
@@ -370,8 +988,8 @@ QRegion QRegion::intersect( const QRegion &r ) const
 
 QRegion QRegion::subtract( const QRegion &r ) const
 {
-    QRegion result( FALSE );
-    XSubtractRegion( data->rgn, r.data->rgn, result.data->rgn );
+    QRegion result( *this );
+    result.combine( r, RgnSub );
     return result;
 }
 
@@ -381,8 +999,8 @@ QRegion QRegion::subtract( const QRegion &r ) const
 
 QRegion QRegion::eor( const QRegion &r ) const
 {
-    QRegion result( FALSE );
-    XXorRegion( data->rgn, r.data->rgn, result.data->rgn );
+    QRegion result( *this );
+    result.combine( r, RgnXor );
     return result;
 }
 
@@ -395,28 +1013,11 @@ QRegion QRegion::eor( const QRegion &r ) const
 
 QRect QRegion::boundingRect() const
 {
-    XRectangle r;
-    XClipBox( data->rgn, &r );
-    return QRect( r.x, r.y, r.width, r.height );
+    const QRegionBox *e = &data->extents;
+    return QRect( e->x1, e->y1, e->x2 - e->x1, e->y2 - e->y1 );
 }
 
 
-/*
-  This is how X represents regions internally.
-*/
-
-struct BOX {
-    short x1, x2, y1, y2;
-};
-
-struct _XRegion {
-    long size;
-    long numRects;
-    BOX *rects;
-    BOX  extents;
-};
-
-
 /*!
   Returns an array of the rectangles that make up the region.
   The rectangles are non-overlapping. The region is formed by
@@ -425,8 +1026,8 @@ struct _XRegion {
 
 QArray<QRect> QRegion::rects() const
 {
-    QArray<QRect> a( (int)data->rgn->numRects );
-    BOX *r = data->rgn->rects;
+    QArray<QRect> a( data->numRects );
+    QRegionBox *r = data->rects;
     for ( int i=0; i<(int)a.size(); i++ ) {
 	// Note: the -1 are correct - see that setClipRect(r)
 	//       gives r back.
@@ -437,6 +1038,46 @@ QArray<QRect> QRegion::rects() const
 }
 
 
+static inline short qt_region_coord( int c )
+{
+    return c < QCOORD_MIN ? QCOORD_MIN : (c > QCOORD_MAX ? QCOORD_MAX : c);
+}
+
+/*!
+  Returns the X region of this region.  It is built the first time it
+  is needed and kept until the region changes.
+*/
+
+Region QRegion::handle() const
+{
+    if ( data->rgn )
+	return data->rgn;
+    Region rgn = XCreateRegion();
+    int n = data->numRects;
+    if ( n > 0 ) {				// fill in X's own structure
+	BOX *boxes = (BOX *)malloc( n*sizeof(BOX) );
+	CHECK_PTR( boxes );
+	for ( int i=0; i<n; i++ ) {
+	    const QRegionBox *r = &data->rects[i];
+	    boxes[i].x1 = qt_region_coord( r->x1 );
+	    boxes[i].y1 = qt_region_coord( r->y1 );
+	    boxes[i].x2 = qt_region_coord( r->x2 );
+	    boxes[i].y2 = qt_region_coord( r->y2 );
+	}
+	free( rgn->rects );
+	rgn->rects = boxes;
+	rgn->size = n;
+	rgn->numRects = n;
+	rgn->extents.x1 = qt_region_coord( data->extents.x1 );
+	rgn->extents.y1 = qt_region_coord( data->extents.y1 );
+	rgn->extents.x2 = qt_region_coord( data->extents.x2 );
+	rgn->extents.y2 = qt_region_coord( data->extents.y2 );
+    }
+    data->rgn = rgn;
+    return rgn;
+}
+
+
 /*!
   Returns TRUE if the region is equal to \e r, or FALSE if the regions are
   different.
@@ -444,8 +1085,12 @@ QArray<QRect> QRegion::rects() const
 
 bool QRegion::operator==( const QRegion &r ) const
 {
-    return data == r.data ?
-	TRUE : XEqualRegion( data->rgn, r.data->rgn );
+    if ( data == r.data )
+	return TRUE;
+    if ( data->numRects != r.data->numRects )
+	return FALSE;
+    return memcmp( data->rects, r.data->rects,
+		   data->numRects*sizeof(QRegionBox) ) == 0;
 }
 
 /*!
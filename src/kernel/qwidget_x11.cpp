@@ -61,6 +61,12 @@ void qt_open_popup( QWidget * );		// --- "" ---
 void qt_close_popup( QWidget * );		// --- "" ---
 void qt_insert_sip( QWidget*, int, int );	// --- "" ---
 int  qt_sip_count( QWidget* );			// --- "" ---
+void qt_x11AddDirtyRegion( QWidget *, const QRect & );	// --- "" ---
+void qt_x11ScrollDirtyRegion( QWidget *, int, int );	// --- "" ---
+void qt_x11ClearDirtyRegion( QWidget *, const QRect & ); // --- "" ---
+void qt_x11RemoveDirtyRegion( QWidget * );		// --- "" ---
+void qt_x11SetPaintBuffer( QWidget *, bool );		// --- "" ---
+bool qt_x11HasPaintBuffer( const QWidget * );		// --- "" ---
 void qt_updated_rootinfo();
 
 
@@ -397,6 +403,8 @@ void QWidget::destroy( bool destroyWindow, bool destroySubWindows )
 {
     if ( qt_button_down == this )
 	qt_button_down = 0;
+    qt_x11RemoveDirtyRegion( this );
+    qt_x11SetPaintBuffer( this, FALSE );
 
     if ( testWFlags(WState_Created) ) {
 	clearWFlags( WState_Created );
@@ -1006,16 +1014,16 @@ void QWidget::setActiveWindow()
   Updates the widget unless updates are disabled or the widget is hidden.
 
   Updating the widget will erase the widget contents and generate a paint
-  event from the window system. The paint event is processed after the
-  program has returned to the main event loop.
+  event. The paint event is processed after the program has returned to
+  the main event loop.
 
   \sa repaint(), paintEvent(), setUpdatesEnabled(), erase()
 */
 
 void QWidget::update()
 {
-     if ( (flags & (WState_Visible|WState_BlockUpdates)) == WState_Visible )
- 	XClearArea( dpy, winid, 0, 0, 0, 0, TRUE );
+    if ( (flags & (WState_Visible|WState_BlockUpdates)) == WState_Visible )
+	qt_x11AddDirtyRegion( this, rect() );
 }
 
 /*!
@@ -1023,8 +1031,12 @@ void QWidget::update()
   unless updates are disabled or the widget is hidden.
 
   Updating the widget erases the widget area \e (x,y,w,h), which in turn
-  generates a paint event from the window system. The paint event is
-  processed after the program has returned to the main event loop.
+  generates a paint event. The paint event is processed after the
+  program has returned to the main event loop.
+
+  The areas of all the update() calls made before that are collected,
+  and the widget gets a single paint event for the rectangle that
+  bounds them.  Only that area is erased.
 
   If \e w is negative, it is replaced with <code>width() - x</code>.
   If \e h is negative, it is replaced width <code>height() - y</code>.
@@ -1041,7 +1053,7 @@ void QWidget::update( int x, int y, int w, int h )
 	if ( h < 0 )
 	    h = crect.height() - y;
 	if ( w != 0 && h != 0 )
-	    XClearArea( dpy, winid, x, y, w, h, TRUE );
+	    qt_x11AddDirtyRegion( this, QRect(x,y,w,h) );
     }
 }
 
@@ -1049,6 +1061,37 @@ void QWidget::update( int x, int y, int w, int h )
   \overload void QWidget::update( const QRect &r )
 */
 
+/*!
+  Returns TRUE if the top-level widget of this widget paints off-screen.
+  \sa setPaintBuffered()
+*/
+
+bool QWidget::isPaintBuffered() const
+{
+    return qt_x11HasPaintBuffer( topLevelWidget() );
+}
+
+/*!
+  Enables or disables off-screen painting for the top-level widget of
+  this widget and all its children.
+
+  When enabled, the paint events caused by update() are delivered with
+  painting redirected to a pixmap that is shared by the whole window,
+  and the result is copied to the screen in one operation.  This avoids
+  flicker for widgets that erase and redraw large areas.
+
+  Only drawing done through a QPainter opened on the widget is
+  buffered.  Widgets that draw on themselves with bitBlt() in
+  paintEvent(), or that set \c WPaintClever, are painted directly.
+
+  \sa isPaintBuffered(), update(), QPainter::redirect()
+*/
+
+void QWidget::setPaintBuffered( bool enable )
+{
+    qt_x11SetPaintBuffer( topLevelWidget(), enable );
+}
+
 /*!
   \overload void QWidget::repaint( bool erase )
 
@@ -1083,8 +1126,10 @@ void QWidget::repaint( int x, int y, int w, int h, bool erase )
 	if ( h < 0 )
 	    h = crect.height() - y;
 	QPaintEvent e( QRect(x,y,w,h) );
-	if ( erase && w != 0 && h != 0 )
+	if ( erase && w != 0 && h != 0 ) {
 	    XClearArea( dpy, winid, x, y, w, h, FALSE );
+	    qt_x11ClearDirtyRegion( this, e.rect() );
+	}
 	QApplication::sendEvent( this, &e );
     }
 }
@@ -1120,6 +1165,7 @@ void QWidget::hideWindow()
 {
     if ( qt_button_down == this )
 	qt_button_down = 0;
+    qt_x11RemoveDirtyRegion( this );
     XUnmapWindow( dpy, winId() );
     if ( isPopup() ) XFlush( dpy );
 }
@@ -1613,6 +1659,7 @@ void QWidget::scroll( int dx, int dy )
     XSetGraphicsExposures( dpy, gc, TRUE );	// want expose events
     XCopyArea( dpy, winid, winid, gc, x1, y1, w, h, x2, y2);
     XSetGraphicsExposures( dpy, gc, FALSE );
+    qt_x11ScrollDirtyRegion( this, dx, dy );
 
     if ( children() ) {				// scroll children
 	QPoint pd( dx, dy );
@@ -1465,9 +1465,12 @@ void generateClass()		      // generate C++ source code for a class
 	else
 	    fprintf( out, " %s )\n{\n", (const char*)argstr );
 
+	// Signals are activated by number, not by name.  Nothing can be
+	// connected to the signal until the meta object exists.
+	fprintf( out, "    if ( !metaObj )\n\treturn;\n" );
 	if ( predef_call ) {
-	    fprintf( out, "    activate_signal( \"%s(%s)\"",
-		     (const char*)f->name, (const char*)typstr );
+	    fprintf( out, "    activate_signal( metaObj->signalOffset() + %d",
+		     signals.at() );
 	    if ( !valstr.isEmpty() )
 		fprintf( out, ", %s", (const char*)valstr );
 	    fprintf( out, " );\n}\n" );
@@ -1476,8 +1479,9 @@ void generateClass()		      // generate C++ source code for a class
 	}
 
 	int nargs = f->args->count();
-	fprintf( out, "    QConnectionList *clist = receivers(\"%s(%s)\");\n",
-		 (const char*)f->name, (const char*)typstr );
+	fprintf( out, "    QConnectionList *clist = "
+		 "receivers( metaObj->signalOffset() + %d );\n",
+		 signals.at() );
 	fprintf( out, "    if ( !clist || signalsBlocked() )\n\treturn;\n" );
 	if ( nargs ) {
 	    for ( i=0; i<=nargs; i++ ) {
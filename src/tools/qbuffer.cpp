@@ -47,6 +47,10 @@
     ts << "pi = " << 3.14;			// str == "pi = 3.14"
   \endcode
 
+  A buffer opened with \c IO_ReadOnly on the QFile::mappedData() of a
+  mapped file reads the file without copying it.  Never open such a
+  buffer for writing.
+
   \sa QFile, QDataStream, QTextStream
 */
 
@@ -355,6 +359,33 @@ int QBuffer::readLine( char *p, uint maxlen )
 }
 
 
+/*!
+  Returns a pointer to the rest of the buffer and sets \e *len to its
+  length, or returns 0 at the end of the buffer.
+  \sa skipBlock()
+*/
+
+const char *QBuffer::peekBlock( uint *len )
+{
+    if ( !isOpen() || !isReadable() || (uint)index >= a.size() ) {
+	*len = 0;
+	return 0;
+    }
+    *len = a.size() - (uint)index;
+    return a.data() + index;
+}
+
+/*!
+  Skips \e len bytes of the buffer.
+  \sa peekBlock()
+*/
+
+void QBuffer::skipBlock( uint len )
+{
+    index += QMIN( len, a.size() - (uint)index );
+}
+
+
 /*!
   Reads a single byte/character from the buffer.
 
@@ -51,6 +51,8 @@ public:
     int	  readBlock( char *p, uint );
     int	  writeBlock( const char *p, uint );
     int	  readLine( char *p, uint );
+    const char *peekBlock( uint *len );
+    void  skipBlock( uint len );
 
     int	  getch();
     int	  putch( int );
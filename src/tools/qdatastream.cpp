@@ -26,6 +26,9 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <stdlib.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /*!
   \class QDataStream qdatastream.h
@@ -78,6 +81,10 @@
   In the last example, if you read into a QString instead of a \c char*
   you do not have to delete it.
 
+  Arrays of numbers are best read and written with readArray() and
+  writeArray(), which move the whole array in one go instead of one
+  number at a time.
+
   \sa QTextStream
 */
 
@@ -510,6 +517,156 @@ QDataStream &QDataStream::readRawBytes( char *s, uint len )
 }
 
 
+/*
+  Reverses the byte order of \a n numbers of \a size bytes (2, 4 or 8)
+  in place.
+*/
+
+static void swap_array( char *data, uint n, int size )
+{
+    register uchar *p = (uchar *)data;
+    uint i = 0;
+#if defined(__SSE2__)
+    uint vn = n*size/16;			// 16 bytes at a time
+    for ( ; i<vn; i++, p+=16 ) {
+	__m128i v = _mm_loadu_si128( (__m128i *)p );
+	v = _mm_or_si128( _mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8) );
+	if ( size == 4 ) {			// swap the 16-bit halves too
+	    v = _mm_shufflelo_epi16( v, _MM_SHUFFLE(2,3,0,1) );
+	    v = _mm_shufflehi_epi16( v, _MM_SHUFFLE(2,3,0,1) );
+	} else if ( size == 8 ) {
+	    v = _mm_shufflelo_epi16( v, _MM_SHUFFLE(0,1,2,3) );
+	    v = _mm_shufflehi_epi16( v, _MM_SHUFFLE(0,1,2,3) );
+	}
+	_mm_storeu_si128( (__m128i *)p, v );
+    }
+    i = vn*16/size;
+#endif
+    register uchar t;
+    switch ( size ) {
+	case 2:
+	    for ( ; i<n; i++, p+=2 ) {
+		t = p[0]; p[0] = p[1]; p[1] = t;
+	    }
+	    break;
+	case 4:
+	    for ( ; i<n; i++, p+=4 ) {
+		t = p[0]; p[0] = p[3]; p[3] = t;
+		t = p[1]; p[1] = p[2]; p[2] = t;
+	    }
+	    break;
+	case 8:
+	    for ( ; i<n; i++, p+=8 ) {
+		t = p[0]; p[0] = p[7]; p[7] = t;
+		t = p[1]; p[1] = p[6]; p[6] = t;
+		t = p[2]; p[2] = p[5]; p[5] = t;
+		t = p[3]; p[3] = p[4]; p[4] = t;
+	    }
+	    break;
+    }
+}
+
+/*
+  Reads \a len numbers of \a size bytes with one device call and swaps
+  them if needed.
+*/
+
+QDataStream &QDataStream::readSwapped( char *data, uint len, int size )
+{
+    if ( len == 0 )
+	return *this;
+    dev->readBlock( data, len*size );
+    if ( !noswap )
+	swap_array( data, len, size );
+    return *this;
+}
+
+/*!
+  Reads \e len 16-bit integers from the stream into \e a and returns a
+  reference to the stream.
+
+  This is the same as reading each number with operator>>(), but reads
+  the whole array with one call to the device and converts the byte
+  order of all of them at once.
+
+  \sa writeArray()
+*/
+
+QDataStream &QDataStream::readArray( Q_INT16 *a, uint len )
+{
+    CHECK_STREAM_PRECOND
+    if ( printable ) {
+	while ( len-- )
+	    *this >> *a++;
+	return *this;
+    }
+    return readSwapped( (char *)a, len, sizeof(Q_INT16) );
+}
+
+/*!
+  Reads \e len 32-bit integers from the stream into \e a and returns a
+  reference to the stream.
+  \sa writeArray()
+*/
+
+QDataStream &QDataStream::readArray( Q_INT32 *a, uint len )
+{
+    CHECK_STREAM_PRECOND
+    if ( printable ) {
+	while ( len-- )
+	    *this >> *a++;
+	return *this;
+    }
+    return readSwapped( (char *)a, len, sizeof(Q_INT32) );
+}
+
+/*!
+  Reads \e len 32-bit floating point numbers from the stream into \e a
+  and returns a reference to the stream.
+  \sa writeArray()
+*/
+
+QDataStream &QDataStream::readArray( float *a, uint len )
+{
+    CHECK_STREAM_PRECOND
+    if ( printable ) {
+	while ( len-- )
+	    *this >> *a++;
+	return *this;
+    }
+    return readSwapped( (char *)a, len, sizeof(float) );
+}
+
+/*!
+  Reads \e len 64-bit floating point numbers from the stream into \e a
+  and returns a reference to the stream.
+  \sa writeArray()
+*/
+
+QDataStream &QDataStream::readArray( double *a, uint len )
+{
+    CHECK_STREAM_PRECOND
+    if ( printable ) {
+	while ( len-- )
+	    *this >> *a++;
+	return *this;
+    }
+    return readSwapped( (char *)a, len, sizeof(double) );
+}
+
+/*!
+  \fn QDataStream &QDataStream::readArray( Q_UINT16 *a, uint len )
+  Reads \e len unsigned 16-bit integers from the stream into \e a and
+  returns a reference to the stream.
+*/
+
+/*!
+  \fn QDataStream &QDataStream::readArray( Q_UINT32 *a, uint len )
+  Reads \e len unsigned 32-bit integers from the stream into \e a and
+  returns a reference to the stream.
+*/
+
+
 /*****************************************************************************
   QDataStream write functions
  *****************************************************************************/
@@ -740,3 +897,116 @@ QDataStream &QDataStream::writeRawBytes( const char *s, uint len )
     }
     return *this;
 }
+
+
+/*
+  Writes \a len numbers of \a size bytes.  If they must be swapped
+  they are converted in chunks, each written with one device call.
+*/
+
+QDataStream &QDataStream::writeSwapped( const char *data, uint len, int size )
+{
+    if ( len == 0 )
+	return *this;
+    if ( noswap ) {
+	dev->writeBlock( data, len*size );
+	return *this;
+    }
+    const uint chunk = 4096;			// numbers per chunk
+    char *buf = new char[QMIN(len, chunk)*size];
+    while ( len ) {
+	uint n = QMIN( len, chunk );
+	memcpy( buf, data, n*size );
+	swap_array( buf, n, size );
+	dev->writeBlock( buf, n*size );
+	data += n*size;
+	len -= n;
+    }
+    delete [] buf;
+    return *this;
+}
+
+/*!
+  Writes the \e len 16-bit integers in \e a to the stream and returns a
+  reference to the stream.
+
+  This is the same as writing each number with operator<<(), but
+  converts the byte order of many numbers at once and writes them with
+  few calls to the device.
+
+  \sa readArray()
+*/
+
+QDataStream &QDataStream::writeArray( const Q_INT16 *a, uint len )
+{
+    CHECK_STREAM_PRECOND
+    if ( printable ) {
+	while ( len-- )
+	    *this << *a++;
+	return *this;
+    }
+    return writeSwapped( (const char *)a, len, sizeof(Q_INT16) );
+}
+
+/*!
+  Writes the \e len 32-bit integers in \e a to the stream and returns a
+  reference to the stream.
+  \sa readArray()
+*/
+
+QDataStream &QDataStream::writeArray( const Q_INT32 *a, uint len )
+{
+    CHECK_STREAM_PRECOND
+    if ( printable ) {
+	while ( len-- )
+	    *this << *a++;
+	return *this;
+    }
+    return writeSwapped( (const char *)a, len, sizeof(Q_INT32) );
+}
+
+/*!
+  Writes the \e len 32-bit floating point numbers in \e a to the stream
+  and returns a reference to the stream.
+  \sa readArray()
+*/
+
+QDataStream &QDataStream::writeArray( const float *a, uint len )
+{
+    CHECK_STREAM_PRECOND
+    if ( printable ) {
+	while ( len-- )
+	    *this << *a++;
+	return *this;
+    }
+    return writeSwapped( (const char *)a, len, sizeof(float) );
+}
+
+/*!
+  Writes the \e len 64-bit floating point numbers in \e a to the stream
+  and returns a reference to the stream.
+  \sa readArray()
+*/
+
+QDataStream &QDataStream::writeArray( const double *a, uint len )
+{
+    CHECK_STREAM_PRECOND
+    if ( printable ) {
+	while ( len-- )
+	    *this << *a++;
+	return *this;
+    }
+    return writeSwapped( (const char *)a, len, sizeof(double) );
+}
+
+/*!
+  \fn QDataStream &QDataStream::writeArray( const Q_UINT16 *a, uint len )
+  Writes the \e len unsigned 16-bit integers in \e a to the stream and
+  returns a reference to the stream.
+*/
+
+/*!
+  \fn QDataStream &QDataStream::writeArray( const Q_UINT32 *a, uint len )
+  Writes the \e len unsigned 32-bit integers in \e a to the stream and
+  returns a reference to the stream.
+*/
@@ -77,6 +77,24 @@ public:
     QDataStream &writeBytes( const char *, uint len );
     QDataStream &writeRawBytes( const char *, uint len );
 
+    QDataStream &readArray( Q_INT16 *, uint len );
+    QDataStream &readArray( Q_UINT16 *, uint len );
+    QDataStream &readArray( Q_INT32 *, uint len );
+    QDataStream &readArray( Q_UINT32 *, uint len );
+    QDataStream &readArray( float *, uint len );
+    QDataStream &readArray( double *, uint len );
+
+    QDataStream &writeArray( const Q_INT16 *, uint len );
+    QDataStream &writeArray( const Q_UINT16 *, uint len );
+    QDataStream &writeArray( const Q_INT32 *, uint len );
+    QDataStream &writeArray( const Q_UINT32 *, uint len );
+    QDataStream &writeArray( const float *, uint len );
+    QDataStream &writeArray( const double *, uint len );
+
+private:
+    QDataStream &readSwapped( char *, uint len, int size );
+    QDataStream &writeSwapped( const char *, uint len, int size );
+
 private:
     QIODevice	*dev;
     bool	 owndev;
@@ -129,5 +147,17 @@ inline QDataStream &QDataStream::operator<<( Q_UINT16 i )
 inline QDataStream &QDataStream::operator<<( Q_UINT32 i )
 { return *this << (Q_INT32)i; }
 
+inline QDataStream &QDataStream::readArray( Q_UINT16 *a, uint len )
+{ return readArray( (Q_INT16 *)a, len ); }
+
+inline QDataStream &QDataStream::readArray( Q_UINT32 *a, uint len )
+{ return readArray( (Q_INT32 *)a, len ); }
+
+inline QDataStream &QDataStream::writeArray( const Q_UINT16 *a, uint len )
+{ return writeArray( (const Q_INT16 *)a, len ); }
+
+inline QDataStream &QDataStream::writeArray( const Q_UINT32 *a, uint len )
+{ return writeArray( (const Q_INT32 *)a, len ); }
+
 
 #endif // QDATASTREAM_H
@@ -1261,65 +1261,128 @@ bool QDir::isRelativePath( const char *path )
 }
 
 
-static void dirInSort( QStrList *fl, QFileInfoList *fil, const char *fileName,
-		       const QFileInfo &fi, int sortSpec )
+/*
+  Directory entries are collected unsorted and sorted once at the end,
+  which keeps large directories from going quadratic.
+*/
+
+struct QDirSortItem {
+    QFileInfo  *fi;
+    QString	name;
+    bool	isDir;
+    int		index;				// position in the listing
+    uint	size;
+    QDateTime	time;
+};
+
+static int sortBySpec;				// for cmp_si()
+
+static int cmp_si( const void *n1, const void *n2 )
+{
+    const QDirSortItem *f1 = *(QDirSortItem **)n1;
+    const QDirSortItem *f2 = *(QDirSortItem **)n2;
+    int r = 0;
+    switch ( sortBySpec & QDir::SortByMask ) {
+	case QDir::Name:
+	    if ( sortBySpec & QDir::IgnoreCase )
+		r = stricmp( f1->name, f2->name );
+	    else
+		r = strcmp( f1->name, f2->name );
+	    break;
+	case QDir::Time:			// newest first
+	    if ( f1->time != f2->time )
+		r = f1->time > f2->time ? -1 : 1;
+	    break;
+	case QDir::Size:			// largest first
+	    if ( f1->size != f2->size )
+		r = f1->size > f2->size ? -1 : 1;
+	    break;
+    }
+    return r ? r : f1->index - f2->index;
+}
+
+class QDirSortList
+{
+public:
+    QDirSortList() : items(0), n(0), max(0) {}
+   ~QDirSortList();
+    void append( QFileInfo *fi, const char *name, bool isDir );
+    void sort( int sortSpec );
+    void take( QStrList *fl, QFileInfoList *fil, int sortSpec );
+
+    QDirSortItem **items;
+    int		n;
+    int		max;
+};
+
+QDirSortList::~QDirSortList()
+{
+    for ( int i=0; i<n; i++ ) {
+	delete items[i]->fi;
+	delete items[i];
+    }
+    delete [] items;
+}
+
+void QDirSortList::append( QFileInfo *fi, const char *name, bool isDir )
+{
+    if ( n == max ) {
+	max = max ? 2*max : 64;
+	QDirSortItem **tmp = new QDirSortItem*[max];
+	CHECK_PTR( tmp );
+	if ( n )
+	    memcpy( tmp, items, n*sizeof(QDirSortItem*) );
+	delete [] items;
+	items = tmp;
+    }
+    QDirSortItem *si = new QDirSortItem;
+    CHECK_PTR( si );
+    si->fi    = fi;
+    si->name  = name;
+    si->isDir = isDir;
+    si->index = n;
+    si->size  = 0;
+    items[n++] = si;
+}
+
+void QDirSortList::sort( int sortSpec )
 {
-    QFileInfo *newFi = new QFileInfo( fi );
-    CHECK_PTR( newFi );
     int sortBy = sortSpec & QDir::SortByMask;
-    if ( sortBy == QDir::Unsorted ) {
-	if ( sortSpec & QDir::Reversed ) {
-	    fl ->insert( 0, fileName );
-	    fil->insert( 0, newFi );
-	} else {
-	    fl ->append( fileName );
-	    fil->append( newFi );
-	}
+    if ( n < 2 || sortBy == QDir::Unsorted )
 	return;
+    if ( sortBy == QDir::Time || sortBy == QDir::Size ) {
+	for ( int i=0; i<n; i++ ) {
+	    if ( sortBy == QDir::Time )
+		items[i]->time = items[i]->fi->lastModified();
+	    else
+		items[i]->size = items[i]->fi->size();
+	}
     }
+    sortBySpec = sortSpec;
+    qsort( items, n, sizeof(QDirSortItem*), cmp_si );
+}
 
-    char      *tmp1;
-    QFileInfo *tmp2 = 0;
-    tmp1 = ( sortSpec & QDir::Reversed ) ? fl->last() : fl->first();
-    if ( sortBy != QDir::Name )
-	tmp2 = ( sortSpec & QDir::Reversed ) ? fil->last() : fil->first();
-    bool stop = FALSE;
-    while ( tmp1 ) {
-	switch( sortBy ) {
-	    case QDir::Name:
-		if ( sortSpec & QDir::IgnoreCase ) {
-		    if ( stricmp(fileName,tmp1) < 0 )
-			stop = TRUE;
-		} else {
-		    if ( strcmp(fileName,tmp1) < 0 )
-			stop = TRUE;
-		}
-		break;
-	    case QDir::Time:
-		if ( fi.lastModified() > tmp2->lastModified() )
-		    stop = TRUE;
-		break;
-	    case QDir::Size:
-		if ( fi.size() > tmp2->size() )
-		    stop = TRUE;
-		break;
+/*
+  Moves the sorted entries to \a fl and \a fil, directories first if
+  requested.
+*/
+
+void QDirSortList::take( QStrList *fl, QFileInfoList *fil, int sortSpec )
+{
+    bool reversed  = (sortSpec & QDir::Reversed) != 0;
+    bool dirsFirst = (sortSpec & QDir::DirsFirst) != 0;
+    for ( int pass=0; pass < (dirsFirst ? 2 : 1); pass++ ) {
+	for ( int i=0; i<n; i++ ) {
+	    QDirSortItem *si = items[reversed ? n-1-i : i];
+	    if ( dirsFirst && si->isDir != (pass == 0) )
+		continue;
+	    fl->append( si->name );
+	    fil->append( si->fi );
+	    si->fi = 0;
 	}
-	if (stop)
-	    break;
-	tmp1 = ( sortSpec & QDir::Reversed ) ? fl->prev() : fl->next();
-	if ( sortBy != QDir::Name )
-	    tmp2 = ( sortSpec & QDir::Reversed ) ? fil->prev() : fil->next();
     }
-    int pos;
-    if ( stop )
-	pos = fl->at() + (( sortSpec & QDir::Reversed ) ? 1 : 0);
-    else
-	pos = ( sortSpec & QDir::Reversed ) ? 0 : fl->count();
-    fl ->insert( pos, fileName );
-    fil->insert( pos, newFi );
 }
 
-
 /*!
   \internal
   Reads directory entries.
@@ -1353,17 +1416,8 @@ bool QDir::readDirEntries( const QString &nameFilter,
     bool doModified = (filterSpec & Modified)	!= 0;
     bool doSystem   = (filterSpec & System)	!= 0;
 #endif
-    bool dirsFirst  = (sortSpec	  & DirsFirst)	!= 0;
 
-    QStrList	  *dList  = 0;
-    QFileInfoList *diList = 0;
-
-    if ( dirsFirst ) {
-	dList = new QStrList;
-	CHECK_PTR( dList );
-	diList	 = new QFileInfoList;
-	CHECK_PTR( dList );
-    }
+    QDirSortList entries;
 
 #if defined(_OS_WIN32_) || defined(_OS_MSDOS_)
 
@@ -1378,7 +1432,6 @@ bool QDir::readDirEntries( const QString &nameFilter,
     long      ff;
     _finddata_t finfo;
 #endif
-    QFileInfo fi;
 
 #undef	IS_SUBDIR
 #undef	IS_RDONLY
@@ -1485,11 +1538,9 @@ bool QDir::readDirEntries( const QString &nameFilter,
 		continue;
 	    if ( !doSystem && isSystem )
 		continue;
-	    fi.setFile( *this, name );
-	    if ( dirsFirst && isDir )
-		dirInSort( dList, diList, name, fi, sortSpec );
-	    else
-		dirInSort( fList, fiList, name, fi, sortSpec );
+	    QFileInfo *fi = new QFileInfo( *this, name );
+	    CHECK_PTR( fi );
+	    entries.append( fi, name, isDir );
 	}
     }
 #if defined(_OS_WIN32_)
@@ -1515,7 +1566,6 @@ bool QDir::readDirEntries( const QString &nameFilter,
 #else
     QRegExp   wc( nameFilter, TRUE, TRUE );	// wild card, case sensitive
 #endif
-    QFileInfo fi;
     DIR	     *dir;
     dirent   *file;
 
@@ -1528,27 +1578,52 @@ bool QDir::readDirEntries( const QString &nameFilter,
 	return FALSE;
     }
 
+    QFileInfoDirCache *dc = 0;
+    if ( QFileInfo::globalCaching() )
+	dc = QFileInfo::dirCache( absPath() );
+
     while ( (file = readdir(dir)) ) {
-	fi.setFile( *this, file->d_name );
-	if ( wc.match(file->d_name) == -1 && !(allDirs && fi.isDir()) )
+	const char *name = file->d_name;
+	bool match = wc.match( name ) != -1;
+	if ( !match && !allDirs )
 	    continue;
-	if  ( (doDirs && fi.isDir()) || (doFiles && fi.isFile()) ) {
-	    if ( noSymLinks && fi.isSymLink() )
-		continue;
-	    if ( (filterSpec & RWEMask) != 0 )
-		if ( (doReadable && !fi.isReadable()) ||
-		     (doWritable && !fi.isWritable()) ||
-		     (doExecable && !fi.isExecutable()) )
+	if ( !doHidden && (name[0] == '.') && (name[1] != '\0') &&
+	     (name[1] != '.' || name[2] != '\0') )
+	    continue;
+	QFileInfo *fi = new QFileInfo( *this, name );
+	CHECK_PTR( fi );
+	if ( !dc || !fi->fromDirCache(dc, name) ) {
+#if defined(DT_DIR) && defined(DT_REG) && defined(DT_LNK) && defined(DT_UNKNOWN)
+	    switch ( file->d_type ) {		// avoid stat() when we can
+		case DT_DIR:
+		    fi->setTypeHint( TRUE );
+		    break;
+		case DT_REG:
+		    fi->setTypeHint( FALSE );
+		    break;
+		case DT_LNK:			// type of the link target
+		case DT_UNKNOWN:		// file system does not tell
+		    break;
+		default:			// neither file nor directory
+		    delete fi;
 		    continue;
-	    if ( !doHidden && (file->d_name[0] == '.') &&
-		 (file->d_name[1] != '\0') &&
-		 (file->d_name[1] != '.' || file->d_name[2] != '\0') )
-		continue;
-	    if ( dirsFirst && fi.isDir() )
-		dirInSort( dList, diList , file->d_name, fi, sortSpec );
-	    else
-		dirInSort( fList, fiList, file->d_name, fi, sortSpec );
+	    }
+#endif
 	}
+	bool isDir = fi->isDir();
+	if ( (!match && !isDir) ||
+	     !((doDirs && isDir) || (doFiles && fi->isFile())) ||
+	     (noSymLinks && fi->isSymLink()) ||
+	     ((filterSpec & RWEMask) != 0 &&
+	      ((doReadable && !fi->isReadable()) ||
+	       (doWritable && !fi->isWritable()) ||
+	       (doExecable && !fi->isExecutable()))) ) {
+	    if ( dc )
+		fi->toDirCache( dc, name );
+	    delete fi;
+	    continue;
+	}
+	entries.append( fi, name, isDir );
     }
     if ( closedir(dir) != 0 ) {
 #if defined(CHECK_NULL)
@@ -1557,20 +1632,24 @@ bool QDir::readDirEntries( const QString &nameFilter,
 #endif
     }
 
+    int sortBy = sortSpec & SortByMask;
+    if ( sortBy == Time || sortBy == Size ) {
+	QFileInfo **fis = new QFileInfo*[entries.n];
+	CHECK_PTR( fis );
+	for ( int i=0; i<entries.n; i++ )
+	    fis[i] = entries.items[i]->fi;
+	QFileInfo::statAll( fis, entries.n );
+	delete [] fis;
+    }
+    if ( dc ) {
+	for ( int i=0; i<entries.n; i++ )
+	    entries.items[i]->fi->toDirCache( dc, entries.items[i]->name );
+    }
+
 #endif // UNIX
 
-    if ( dirsFirst ) {
-	char	  *tmp	 = dList ->last();
-	QFileInfo *fiTmp = diList->last();
-	while ( tmp ) {
-	    fList->insert( 0, tmp );
-	    tmp = dList->prev();
-	    fiList->insert( 0, fiTmp );
-	    fiTmp = diList->prev();
-	}
-	delete dList;
-	delete diList;
-    }
+    entries.sort( sortSpec );
+    entries.take( fList, fiList, sortSpec );
     if ( filterSpec == (FilterSpec)filtS && sortSpec == (SortSpec)sortS &&
 	 nameFilter == nameFilt )
 	dirty = FALSE;
@@ -23,6 +23,9 @@
 
 #include "qfile.h"
 #include "qfiledefs.h"
+#if defined(UNIX)
+#include <sys/mman.h>
+#endif
 
 /*!
   \class QFile qfile.h
@@ -65,6 +68,8 @@
 
 QFile::QFile()
 {
+    rbuf = 0;
+    rbufSize = 16384;
     init();
 }
 
@@ -76,6 +81,8 @@ QFile::QFile()
 QFile::QFile( const char *name )
     : fn(name)
 {
+    rbuf = 0;
+    rbufSize = 16384;
     init();
 }
 
@@ -104,6 +111,8 @@ void QFile::init()
     length = 0;
     index  = 0;
     ext_f  = FALSE;				// not an external file handle
+    rbufPos = rbufLen = 0;
+    mmapped = FALSE;
 }
 
 
@@ -238,6 +247,9 @@ bool QFile::remove( const char *fileName )      // remove file
   <li>\c IO_Truncate truncates the file.
   <li>\c IO_Translate enables carriage returns and linefeed translation
   for text files under MS-DOS, Windows and OS/2.
+  <li>\c IO_Mapped maps the file into memory.  It must be combined with
+  \c IO_ReadOnly and nothing else.  mappedData() then gives the whole
+  file without copying it.
   </ul>
 
   The raw access mode is best when I/O is block-operated using 4kB block size
@@ -291,7 +303,16 @@ bool QFile::open( int m )
 	return FALSE;
     }
     bool ok = TRUE;
-    if ( isRaw() ) {				// raw file I/O
+    if ( isMapped() ) {				// memory mapped file
+	if ( isWritable() || (m & ~(IO_ReadOnly|IO_Mapped)) ) {
+#if defined(CHECK_RANGE)
+	    warning( "QFile::open: IO_Mapped is only for reading" );
+#endif
+	    init();
+	    return FALSE;
+	}
+	ok = mapFile();
+    } else if ( isRaw() ) {			// raw file I/O
 	int oflags = OPEN_RDONLY;
 	if ( isReadable() && isWritable() )
 	    oflags = OPEN_RDWR;
@@ -325,6 +346,8 @@ bool QFile::open( int m )
 	    FSTAT( fd, &st );
 	    length = (int)st.st_size;
 	    index  = (flags() & IO_Append) == 0 ? 0 : length;
+	    if ( (st.st_mode & STAT_MASK) != STAT_REG )
+		setType( IO_Sequential );	// FIFO or device
 	} else {
 	    ok = FALSE;
 	}
@@ -401,7 +424,8 @@ bool QFile::open( int m )
   \endcode
 
   When a QFile is opened using this function, close() does not actually
-  close the file, only flushes it.
+  close the file, only flushes it.  \c IO_Mapped is ignored; only files
+  opened by name can be mapped.
 
   \warning If \e f is \c stdin, \c stdout, \c stderr, you may not
   be able to seek.  See QIODevice::isSequentialAccess() for more
@@ -419,7 +443,7 @@ bool QFile::open( int m, FILE *f )
 	return FALSE;
     }
     init();
-    setMode( m &~IO_Raw );
+    setMode( m & ~(IO_Raw|IO_Mapped) );
     setState( IO_Open );
     fh = f;
     ext_f = TRUE;
@@ -442,7 +466,8 @@ bool QFile::open( int m, FILE *f )
   Returns TRUE if successful, otherwise FALSE.
 
   When a QFile is opened using this function, close() does not actually
-  close the file.
+  close the file.  \c IO_Mapped is ignored; only files opened by name can
+  be mapped.
 
   \warning If \e f is one of 0 (stdin), 1 (stdout) or 2 (stderr), you may not
   be able to seek. size() is set to \c INT_MAX (in limits.h).
@@ -459,15 +484,16 @@ bool QFile::open( int m, int f )
 	return FALSE;
     }
     init();
-    setMode( m |IO_Raw );
+    setMode( (m & ~IO_Mapped) | IO_Raw );
     setState( IO_Open );
     fd = f;
     ext_f = TRUE;
+    STATBUF st;
+    if ( FSTAT( fd, &st ) != 0 || (st.st_mode & STAT_MASK) != STAT_REG )
+	setType( IO_Sequential );		// pipe, socket or terminal
     if ( fd == 0 || fd == 1 || fd == 2 ) {
 	length = INT_MAX;
     } else {
-	STATBUF st;
-	FSTAT( fd, &st );
 	length = (int)st.st_size;
 	index  = (int)LSEEK(fd, 0, SEEK_CUR);
     }
@@ -489,7 +515,12 @@ void QFile::close()
 {
     if ( !isOpen() )				// file is not open
 	return;
-    if ( fh ) {					// buffered file
+    if ( isMapped() ) {
+	if ( !ext_f ) {				// only named files are mapped
+	    unmapFile();
+	    CLOSE( fd );
+	}
+    } else if ( fh ) {					// buffered file
 	if ( ext_f )
 	    fflush( fh );			// cannot close
 	else
@@ -499,6 +530,8 @@ void QFile::close()
 	    ;					// cannot close
 	else
 	    CLOSE( fd );
+	delete [] rbuf;
+	rbuf = 0;
     }
     init();					// restore internal state
 }
@@ -567,7 +600,16 @@ bool QFile::at( int pos )
 	return FALSE;
     }
     bool ok;
-    if ( isRaw() ) {				// raw file
+    if ( isMapped() ) {				// just move the index
+	ok = pos >= 0 && pos <= length;
+    } else if ( isRaw() ) {			// raw file
+	if ( rbufLen && pos >= index - (int)rbufPos &&
+	     pos <= index + (int)(rbufLen - rbufPos) ) {
+	    rbufPos = pos - (index - rbufPos);	// still in the buffer
+	    index = pos;
+	    return TRUE;
+	}
+	rbufPos = rbufLen = 0;
 	pos = (int)LSEEK(fd, pos, SEEK_SET);
 	ok = pos != -1;
     } else {					// buffered file
@@ -632,8 +674,31 @@ int QFile::readBlock( char *p, uint len )
     }
 #endif
     int nread;					// number of bytes read
-    if ( isRaw() ) {				// raw file
-	nread = READ( fd, p, len );
+    if ( isMapped() ) {				// memory mapped file
+	nread = QMIN( len, (uint)(length - index) );
+	memcpy( p, mview.data() + index, nread );
+	if ( len && nread == 0 )
+	    setStatus( IO_ReadError );
+    } else if ( isRaw() ) {			// raw file
+	nread = 0;
+	if ( rbufPos < rbufLen ) {		// take what is buffered
+	    nread = QMIN( len, rbufLen - rbufPos );
+	    memcpy( p, rbuf + rbufPos, nread );
+	    rbufPos += nread;
+	}
+	if ( (uint)nread < len ) {
+	    if ( len - nread >= rbufSize || isSequentialAccess() ) {
+		// big reads and pipes go directly
+		int n = READ( fd, p + nread, len - nread );
+		if ( n > 0 )
+		    nread += n;
+	    } else if ( fillReadBuffer() ) {
+		int n = QMIN( len - nread, rbufLen );
+		memcpy( p + nread, rbuf, n );
+		rbufPos = n;
+		nread += n;
+	    }
+	}
 	if ( len && nread <= 0 ) {
 	    nread = 0;
 	    setStatus(IO_ReadError);
@@ -680,6 +745,8 @@ int QFile::writeBlock( const char *p, uint len )
     }
 #endif
     int nwritten;				// number of bytes written
+    if ( isRaw() && rbufLen && !isSequentialAccess() )
+	discardReadBuffer();			// sockets read and write apart
     if ( isRaw() )				// raw file
 	nwritten = WRITE( fd, p, len );
     else					// buffered file
@@ -732,7 +799,48 @@ int QFile::readLine( char *p, uint maxlen )
     }
 #endif
     int nread;					// number of bytes read
-    if ( isRaw() ) {				// raw file
+    if ( isMapped() ) {				// memory mapped file
+	uint n = QMIN( maxlen-1, (uint)(length - index) );
+	const char *b = mview.data() + index;
+	const char *nl = (const char *)memchr( b, '\n', n );
+	if ( nl )
+	    n = nl - b + 1;
+	memcpy( p, b, n );
+	p[n] = '\0';
+	index += n;
+	nread = n;
+    } else if ( isRaw() && rbufSize && !isSequentialAccess() ) {
+	nread = 0;
+	maxlen--;				// room for the 0-terminator
+	while ( (uint)nread < maxlen ) {
+	    if ( rbufPos == rbufLen && !fillReadBuffer() )
+		break;
+	    uint n = QMIN( maxlen - nread, rbufLen - rbufPos );
+	    const char *b = rbuf + rbufPos;
+	    const char *nl = (const char *)memchr( b, '\n', n );
+	    if ( nl )
+		n = nl - b + 1;
+	    memcpy( p + nread, b, n );
+	    rbufPos += n;
+	    index += n;
+	    nread += n;
+	    if ( nl )
+		break;
+	}
+	p[nread] = '\0';
+    } else if ( isRaw() && isSequentialAccess() ) { // pipe, size unknown
+	nread = 0;
+	maxlen--;
+	while ( (uint)nread < maxlen ) {
+	    int c = getch();
+	    if ( c == EOF )
+		break;
+	    p[nread++] = c;
+	    if ( c == '\n' )
+		break;
+	}
+	p[nread] = '\0';
+    } else if ( isRaw() ) {			// raw file
 	nread = QIODevice::readLine( p, maxlen );
     } else {					// buffered file
 	p = fgets( p, maxlen, fh );
@@ -770,7 +878,17 @@ int QFile::getch()
     }
 #endif
     int ch;
-    if ( isRaw() ) {				// raw file (inefficient)
+    if ( isMapped() ) {				// memory mapped file
+	if ( index < length ) {
+	    ch = (uchar)mview.data()[index++];
+	} else {
+	    ch = EOF;
+	    setStatus( IO_ReadError );
+	}
+    } else if ( isRaw() && (rbufPos < rbufLen || fillReadBuffer()) ) {
+	ch = (uchar)rbuf[rbufPos++];
+	index++;
+    } else if ( isRaw() ) {			// raw file (inefficient)
 	char buf[1];
 	ch = readBlock( buf, 1 ) == 1 ? buf[0] : EOF;
     } else {					// buffered file
@@ -843,7 +961,28 @@ int QFile::ungetch( int ch )
 #endif
     if ( ch == EOF )				// cannot unget EOF
 	return ch;
-    if ( isRaw() ) {				// raw file (very inefficient)
+    if ( isMapped() ) {				// cannot change the file
+	if ( index > 0 && (uchar)mview.data()[index-1] == (uchar)ch )
+	    index--;
+	else
+	    ch = EOF;
+    } else if ( isRaw() && rbufPos > 0 ) {	// put it back in the buffer
+	rbuf[--rbufPos] = ch;
+	index--;
+    } else if ( isRaw() && isSequentialAccess() ) { // cannot seek a pipe
+	if ( rbufLen >= rbufSize ) {
+	    ch = EOF;
+	} else {
+	    if ( !rbuf ) {
+		rbuf = new char[rbufSize];
+		CHECK_PTR( rbuf );
+	    }
+	    memmove( rbuf+1, rbuf, rbufLen );
+	    rbuf[0] = ch;
+	    rbufLen++;
+	    index--;
+	}
+    } else if ( isRaw() ) {			// raw file (very inefficient)
 	char buf[1];
 	at( index-1 );
 	buf[0] = ch;
@@ -869,6 +1008,9 @@ int QFile::ungetch( int ch )
 
   If the file is not open or there is an error, handle() returns -1.
 
+  Note that a raw file reads ahead, so the position of the file
+  descriptor may be beyond at().
+
   \sa QSocketNotifier
 */
 
@@ -881,3 +1023,200 @@ int QFile::handle() const
     else
 	return fd;
 }
+
+
+/*!
+  \fn uint QFile::readBufferSize() const
+  Returns the size of the read-ahead buffer of raw files.
+  \sa setReadBufferSize()
+*/
+
+/*!
+  Sets the size of the read-ahead buffer to \e size bytes.
+
+  A file opened with \c IO_Raw reads from the file descriptor in chunks
+  of this size, so that getch(), readLine() and small readBlock() calls
+  do not cost a system call each.  The default is 16384 bytes; 0 turns
+  read-ahead off.  Buffered files use the C library's buffering and are
+  not affected.
+
+  Sequential devices such as pipes, sockets and terminals are never read
+  ahead: data taken into the buffer would no longer wake up a
+  QSocketNotifier watching the descriptor.
+
+  \sa readBufferSize()
+*/
+
+void QFile::setReadBufferSize( uint size )
+{
+    if ( size == rbufSize )
+	return;
+    if ( rbufLen )
+	discardReadBuffer();
+    delete [] rbuf;
+    rbuf = 0;
+    rbufSize = size;
+}
+
+/*!
+  Returns a pointer to the data in the read-ahead buffer of a raw file,
+  filling it if it is empty, or to the rest of a mapped file, and sets
+  \e *len to its length.  Returns 0 for buffered files, for sequential
+  devices and at the end of the file.
+  \sa skipBlock()
+*/
+
+const char *QFile::peekBlock( uint *len )
+{
+    if ( isOpen() && isMapped() && index < length ) {
+	*len = length - index;
+	return mview.data() + index;
+    }
+    if ( !isOpen() || !isRaw() || !isReadable() ||
+	 (rbufPos == rbufLen && !fillReadBuffer()) ) {
+	*len = 0;
+	return 0;
+    }
+    *len = rbufLen - rbufPos;
+    return rbuf + rbufPos;
+}
+
+/*!
+  Skips \e len bytes of the data returned by peekBlock().
+*/
+
+void QFile::skipBlock( uint len )
+{
+    if ( isMapped() ) {
+	index += QMIN( len, (uint)(length - index) );
+	return;
+    }
+    if ( !isRaw() ) {
+	QIODevice::skipBlock( len );
+	return;
+    }
+    len = QMIN( len, rbufLen - rbufPos );
+    rbufPos += len;
+    index += len;
+}
+
+/*!
+  \internal
+  Reads the next chunk of a raw file into the read-ahead buffer, which
+  must be empty.  Returns FALSE at the end of the file, on errors, for
+  sequential devices and if read-ahead is turned off.
+*/
+
+bool QFile::fillReadBuffer()
+{
+    rbufPos = rbufLen = 0;
+    if ( rbufSize == 0 || !isReadable() || isSequentialAccess() )
+	return FALSE;
+    if ( !rbuf ) {
+	rbuf = new char[rbufSize];
+	CHECK_PTR( rbuf );
+    }
+    int n = READ( fd, rbuf, rbufSize );
+    if ( n <= 0 )
+	return FALSE;
+    rbufLen = n;
+    return TRUE;
+}
+
+/*!
+  \internal
+  Throws away what is left in the read-ahead buffer and moves the file
+  descriptor back to at(), before writing or seeking.
+*/
+
+void QFile::discardReadBuffer()
+{
+    if ( rbufPos < rbufLen )
+	LSEEK( fd, index, SEEK_SET );
+    rbufPos = rbufLen = 0;
+}
+
+
+/*!
+  \fn bool QFile::isMapped() const
+  Returns TRUE if the file was opened with \c IO_Mapped.
+  \sa mappedData()
+*/
+
+/*!
+  \fn QByteArray QFile::mappedData() const
+
+  Returns the contents of a file opened with \c IO_Mapped, without
+  copying them.  The array is a
+  \link shclass.html shallow copy\endlink of raw data (see
+  QArray::setRawData()) that points into the mapping, so it is read
+  only: do not write to it or resize it.  Use QArray::copy() or detach()
+  if you need a modifiable copy.
+
+  When the file is closed, arrays that point into the mapping become
+  empty, so it is safe to keep them, but not to keep pointers into their
+  data.
+
+  A QBuffer or QDataStream opened read-only on the array reads the file
+  without copying it:
+  \code
+    QFile f( "data.bin" );
+    if ( f.open(IO_ReadOnly|IO_Mapped) ) {
+	QDataStream s( f.mappedData(), IO_ReadOnly );
+	s >> ...;
+    }
+  \endcode
+
+  Returns an empty array if the file is not mapped.
+*/
+
+/*!
+  \internal
+  Opens and maps the file.  If the system cannot map it the file is read
+  into memory instead, which behaves the same.
+*/
+
+bool QFile::mapFile()
+{
+    fd = OPEN( (const char *)fn, OPEN_RDONLY, 0666 );
+    if ( fd == -1 )
+	return FALSE;
+    STATBUF st;
+    FSTAT( fd, &st );
+    length = (int)st.st_size;
+    index = 0;
+    if ( length == 0 )
+	return TRUE;
+#if defined(UNIX)
+    void *p = mmap( 0, length, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if ( p != MAP_FAILED ) {
+	mview.setRawData( (const char *)p, length );
+	mmapped = TRUE;
+	return TRUE;
+    }
+#endif
+    if ( !mview.resize(length) ||
+	 READ(fd, mview.data(), length) != length ) {
+	mview.resize( 0 );
+	CLOSE( fd );
+	return FALSE;
+    }
+    return TRUE;
+}
+
+/*!
+  \internal
+  Unmaps the file and empties all arrays returned by mappedData().
+*/
+
+void QFile::unmapFile()
+{
+#if defined(UNIX)
+    if ( mmapped ) {
+	void *p = mview.data();
+	mview.resetRawData( mview.data(), mview.size() ); // empties all copies
+	munmap( p, length );
+    }
+#endif
+    mview = QByteArray();
+}
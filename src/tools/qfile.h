@@ -63,6 +63,8 @@ public:
     int		readBlock( char *data, uint len );
     int		writeBlock( const char *data, uint len );
     int		readLine( char *data, uint maxlen );
+    const char *peekBlock( uint *len );
+    void	skipBlock( uint len );
 
     int		getch();
     int		putch( int );
@@ -70,6 +72,12 @@ public:
 
     int		handle() const;
 
+    uint	readBufferSize() const;
+    void	setReadBufferSize( uint );
+
+    bool	isMapped() const;
+    QByteArray	mappedData() const;
+
 protected:
     QString	fn;
     FILE       *fh;
@@ -79,6 +87,16 @@ protected:
 
 private:
     void	init();
+    bool	fillReadBuffer();
+    void	discardReadBuffer();
+    bool	mapFile();
+    void	unmapFile();
+    char       *rbuf;				// read-ahead buffer for raw files
+    uint	rbufSize;
+    uint	rbufPos;
+    uint	rbufLen;
+    QByteArray	mview;				// the mapping, for IO_Mapped
+    bool	mmapped;			// mview is mmap'ed, not read
 
 private:	// Disabled copy constructor and operator=
 #if defined(Q_DISABLE_COPY)
@@ -94,5 +112,14 @@ inline const char *QFile::name() const
 inline int QFile::at() const
 { return index; }
 
+inline uint QFile::readBufferSize() const
+{ return rbufSize; }
+
+inline bool QFile::isMapped() const
+{ return (flags() & IO_Mapped) == IO_Mapped; }
+
+inline QByteArray QFile::mappedData() const
+{ return mview; }
+
 
 #endif // QFILE_H
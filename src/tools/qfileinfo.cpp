@@ -30,10 +30,15 @@
 #include "qfiledefs.h"
 #include "qdatetime.h"
 #include "qdir.h"
+#include "qdict.h"
+#include <string.h>
 #if defined(UNIX)
 #include <pwd.h>
 #include <grp.h>
 #endif
+#if defined(QT_THREAD_SUPPORT)
+#include <pthread.h>
+#endif
 
 #if defined(_OS_SUN_)
 #undef readlink
@@ -67,6 +72,7 @@ struct QFileInfoCache
 {
     STATBUF st;
     bool isSymLink;
+    bool typeOnly;				// only the file type is known
 };
 
 
@@ -87,6 +93,12 @@ struct QFileInfoCache
   every time you request information from it, you can call the function
   setCaching( FALSE ).
 
+  QFileInfo objects created by QDir::entryInfoList() may know the file
+  type from the directory listing alone; the rest of the information is
+  read from the file system the first time it is needed.  Programs that
+  scan the same directories many times can also enable a process-wide
+  cache for directory scans, see setGlobalCaching().
+
   A QFileInfo can point to a file using either a relative or an absolute
   file path. Absolute file paths begin with the directory separator
   ('/') or a drive specification (not applicable to UNIX).
@@ -666,7 +678,7 @@ static const uint nobodyID = (uint) -2;
 uint QFileInfo::ownerId() const
 {
 #if defined(UNIX)
-    if ( !fic || !cache )
+    if ( !fic || !cache || fic->typeOnly )
 	doStat();
     if ( fic )
 	return fic->st.st_uid;
@@ -708,7 +720,7 @@ const char *QFileInfo::group() const
 uint QFileInfo::groupId() const
 {
 #if defined(UNIX)
-    if ( !fic || !cache )
+    if ( !fic || !cache || fic->typeOnly )
 	doStat();
     if ( fic )
 	return fic->st.st_gid;
@@ -742,7 +754,7 @@ uint QFileInfo::groupId() const
 #if defined(UNIX)
 bool QFileInfo::permission( int permissionSpec ) const
 {
-    if ( !fic || !cache )
+    if ( !fic || !cache || fic->typeOnly )
 	doStat();
     if ( fic ) {
 	uint mask = 0;
@@ -792,7 +804,7 @@ bool QFileInfo::permission( int ) const
 
 uint QFileInfo::size() const
 {
-    if ( !fic || !cache )
+    if ( !fic || !cache || fic->typeOnly )
 	doStat();
     if ( fic )
 	return (uint)fic->st.st_size;
@@ -809,7 +821,7 @@ uint QFileInfo::size() const
 QDateTime QFileInfo::lastModified() const
 {
     QDateTime dt;
-    if ( !fic || !cache )
+    if ( !fic || !cache || fic->typeOnly )
 	doStat();
     if ( fic )
 	dt.setTime_t( fic->st.st_mtime );
@@ -828,7 +840,7 @@ QDateTime QFileInfo::lastModified() const
 QDateTime QFileInfo::lastRead() const
 {
     QDateTime dt;
-    if ( !fic || !cache )
+    if ( !fic || !cache || fic->typeOnly )
 	doStat();
     if ( fic )
 	dt.setTime_t( fic->st.st_atime );
@@ -843,6 +855,7 @@ void QFileInfo::doStat() const
 	that->fic = new QFileInfoCache;
     STATBUF *b = &that->fic->st;
     that->fic->isSymLink = FALSE;
+    that->fic->typeOnly = FALSE;
 
 #if defined( UNIX ) && defined(S_IFLNK)
     if ( ::lstat(fn.data(),b) == 0 ) {
@@ -858,3 +871,246 @@ void QFileInfo::doStat() const
 	that->fic = 0;
     }
 }
+
+
+/*****************************************************************************
+  Directory scan support
+ *****************************************************************************/
+
+/*
+  Records the file type found in a directory listing without touching
+  the file itself.  Only isDir(), isFile() and isSymLink() are answered
+  from it, any other property will stat the file.
+*/
+
+void QFileInfo::setTypeHint( bool isDir )
+{
+    if ( !fic ) {
+	fic = new QFileInfoCache;
+	CHECK_PTR( fic );
+    }
+    memset( &fic->st, 0, sizeof(fic->st) );
+    fic->st.st_mode = isDir ? STAT_DIR : STAT_REG;
+    fic->isSymLink = FALSE;
+    fic->typeOnly = TRUE;
+}
+
+
+#if defined(QT_THREAD_SUPPORT)
+
+struct QFileInfoStatJob {
+    QFileInfo **list;
+    int		from;
+    int		to;
+};
+
+static void *qt_stat_thread( void *arg )
+{
+    QFileInfoStatJob *job = (QFileInfoStatJob *)arg;
+    for ( int i=job->from; i<job->to; i++ )
+	job->list[i]->size();			// stats if not known
+    return 0;
+}
+
+#endif // QT_THREAD_SUPPORT
+
+/*
+  Makes sure that the \a n file infos in \a list have read all their
+  information from the file system.  On network file systems the time
+  spent here is mostly round trips, so large lists are split across a
+  few threads when Qt is built with thread support.
+*/
+
+void QFileInfo::statAll( QFileInfo **list, int n )
+{
+    int i;
+    int todo = 0;
+    for ( i=0; i<n; i++ ) {			// move unknown ones to the front
+	QFileInfo *fi = list[i];
+	if ( !fi->fic || fi->fic->typeOnly || !fi->cache ) {
+	    list[i] = list[todo];
+	    list[todo++] = fi;
+	}
+    }
+#if defined(QT_THREAD_SUPPORT)
+    const int minjob = 64;			// not worth a thread below this
+    int nthreads = QMIN( todo/minjob, 8 );
+    if ( nthreads > 1 ) {
+	QFileInfoStatJob jobs[8];
+	pthread_t	 tids[8];
+	bool		 started[8];
+	for ( i=0; i<nthreads; i++ ) {
+	    jobs[i].list = list;
+	    jobs[i].from = todo*i/nthreads;
+	    jobs[i].to	 = todo*(i+1)/nthreads;
+	    started[i] = FALSE;
+	}
+	for ( i=1; i<nthreads; i++ )
+	    started[i] = pthread_create( &tids[i], 0, qt_stat_thread,
+					 &jobs[i] ) == 0;
+	qt_stat_thread( &jobs[0] );
+	for ( i=1; i<nthreads; i++ ) {
+	    if ( started[i] )
+		pthread_join( tids[i], 0 );
+	    else				// could not start, do it here
+		qt_stat_thread( &jobs[i] );
+	}
+	return;
+    }
+#endif
+    for ( i=0; i<todo; i++ )
+	list[i]->size();
+}
+
+
+/*
+  The global cache keeps the stat information of directory entries,
+  grouped by directory.  A directory's entries are trusted for as long
+  as the modification time of the directory itself is unchanged, so a
+  rescan costs a single stat().
+*/
+
+typedef Q_DECLARE(QDictM,QFileInfoCache) QFileInfoCacheDict;
+
+struct QFileInfoDirCache {
+    time_t	       mtime;
+    QFileInfoCacheDict files;
+};
+
+typedef Q_DECLARE(QDictM,QFileInfoDirCache) QFileInfoDirCacheDict;
+
+static QFileInfoDirCacheDict *globalCache = 0;
+static bool globalCacheEnabled = FALSE;
+static uint globalCacheCount = 0;
+static const uint globalCacheLimit = 200000;	// entries
+
+struct QFileInfoCacheCleanup {			// frees the cache on exit
+   ~QFileInfoCacheCleanup() { delete globalCache; globalCache = 0; }
+};
+static QFileInfoCacheCleanup cleanupGlobalCache;
+
+/*!
+  Enables the process-wide cache for directory scans if \e enable is
+  TRUE, or disables and clears it if \e enable is FALSE.
+
+  With the global cache enabled, QDir remembers the information about
+  every file it had to stat while reading a directory, and reuses it for
+  later scans of the same directory as long as the directory's
+  modification time is unchanged.  This makes repeated scans of large
+  directories (e.g. in a file dialog) nearly free, even on network file
+  systems.
+
+  Since only the directory is checked, a file that is modified in place
+  keeps its old size and modification time in the cache.  Call
+  clearGlobalCache() or refresh() the QFileInfo if you need to be sure.
+
+  The global cache is disabled by default.
+
+  \sa globalCaching(), clearGlobalCache(), setCaching()
+*/
+
+void QFileInfo::setGlobalCaching( bool enable )
+{
+    if ( !enable )
+	clearGlobalCache();
+    globalCacheEnabled = enable;
+}
+
+/*!
+  Returns TRUE if the process-wide cache for directory scans is enabled.
+  \sa setGlobalCaching()
+*/
+
+bool QFileInfo::globalCaching()
+{
+    return globalCacheEnabled;
+}
+
+/*!
+  Removes all entries from the process-wide cache for directory scans.
+  \sa setGlobalCaching()
+*/
+
+void QFileInfo::clearGlobalCache()
+{
+    if ( globalCache ) {
+	globalCache->clear();
+	globalCacheCount = 0;
+    }
+}
+
+/*
+  Returns the global cache for the directory \a dirPath, or 0 if global
+  caching is disabled.  Cached entries are dropped if the directory has
+  been modified since they were recorded.
+*/
+
+QFileInfoDirCache *QFileInfo::dirCache( const char *dirPath )
+{
+    if ( !globalCacheEnabled )
+	return 0;
+    STATBUF st;
+    if ( STAT(dirPath,&st) != 0 )
+	return 0;
+    if ( !globalCache ) {
+	globalCache = new QFileInfoDirCacheDict( 61 );
+	CHECK_PTR( globalCache );
+	globalCache->setAutoDelete( TRUE );
+    }
+    QFileInfoDirCache *dc = globalCache->find( dirPath );
+    if ( dc && dc->mtime != st.st_mtime ) {
+	globalCacheCount -= dc->files.count();
+	globalCache->remove( dirPath );
+	dc = 0;
+    }
+    if ( !dc ) {
+	if ( globalCacheCount >= globalCacheLimit )
+	    clearGlobalCache();
+	dc = new QFileInfoDirCache;
+	CHECK_PTR( dc );
+	dc->mtime = st.st_mtime;
+	dc->files.setAutoDelete( TRUE );
+	globalCache->insert( dirPath, dc );
+	if ( globalCache->count() > 2*globalCache->size() )
+	    globalCache->resize( 4*globalCache->size()+1 );
+    }
+    return dc;
+}
+
+/*
+  Takes the information about \a fileName from the directory cache \a dc.
+  Returns TRUE if it was found.
+*/
+
+bool QFileInfo::fromDirCache( QFileInfoDirCache *dc, const char *fileName )
+{
+    QFileInfoCache *c = dc->files.find( fileName );
+    if ( !c )
+	return FALSE;
+    if ( !fic ) {
+	fic = new QFileInfoCache;
+	CHECK_PTR( fic );
+    }
+    *fic = *c;
+    return TRUE;
+}
+
+/*
+  Stores the information about \a fileName in the directory cache \a dc,
+  if it has been read from the file system.
+*/
+
+void QFileInfo::toDirCache( QFileInfoDirCache *dc, const char *fileName ) const
+{
+    if ( !fic || fic->typeOnly || dc->files.find(fileName) )
+	return;
+    if ( globalCacheCount >= globalCacheLimit )
+	return;
+    QFileInfoCache *c = new QFileInfoCache;
+    CHECK_PTR( c );
+    *c = *fic;
+    dc->files.insert( fileName, c );
+    globalCacheCount++;
+    if ( dc->files.count() > 2*dc->files.size() )
+	dc->files.resize( 4*dc->files.size()+1 );
+}
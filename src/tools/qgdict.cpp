@@ -42,6 +42,14 @@
   <li> write() writes a collection/dictionary item to a QDataStream.
   </ul>
   Normally, you do not have to reimplement any of these functions.
+
+  The hash array grows automatically when the dictionary holds more
+  than twice as many items as there are hash buckets, so the size given
+  to the constructor is only a starting point.  The full hash value of
+  each key is stored with the item; lookups compare it before comparing
+  the keys, and growing the array never has to hash a key again.
+  The array is not grown while any iterators are attached to the
+  dictionary, since that would disturb the iteration order.
 */
 
 static const int op_find = 0;
@@ -133,13 +141,74 @@ public:
     GCI	    setData( GCI d )	{ return data = d; }
     QBucket *getNext()		{ return next; }
     void    setNext( QBucket *n){ next = n; }
+    uint    getHash()		{ return hash; }
+    void    setHash( uint h )	{ hash = h; }
+
+    void   *operator new( size_t );
+    void    operator delete( void * );
 private:
     char   *key;
     GCI	    data;
     QBucket *next;
+    uint    hash;
 };
 
 
+/*
+  Buckets are allocated in blocks and recycled through a free list,
+  since dictionaries create and destroy them at a very high rate.
+  Blocks are never returned to the system.
+*/
+
+static const int bucketsPerBlock = 256;
+static QBucket  *freeBuckets = 0;
+
+void *QBucket::operator new( size_t )
+{
+    if ( !freeBuckets ) {			// allocate a new block
+	QBucket *block
+	    = (QBucket *)::operator new( bucketsPerBlock*sizeof(QBucket) );
+	CHECK_PTR( block );
+	for ( int i=0; i<bucketsPerBlock-1; i++ )
+	    block[i].next = &block[i+1];
+	block[bucketsPerBlock-1].next = 0;
+	freeBuckets = block;
+    }
+    QBucket *b = freeBuckets;
+    freeBuckets = b->next;
+    return b;
+}
+
+void QBucket::operator delete( void *p )
+{
+    if ( !p )
+	return;
+    QBucket *b = (QBucket *)p;
+    b->next = freeBuckets;
+    freeBuckets = b;
+}
+
+
+/*
+  Hash array sizes used when the dictionary grows: primes, each a little
+  more than twice the previous one.
+*/
+
+static const uint growSizes[] = {
+    17, 37, 79, 163, 331, 673, 1361, 2729, 5471, 10949, 21911, 43853,
+    87719, 175447, 350899, 701819, 1403641, 2807303, 5614657, 11229331,
+    22458671, 44917381, 89834777, 179669557, 359339171, 718678369,
+    1437356741, 0 };
+
+static uint growSize( uint len )
+{
+    const uint *s = growSizes;
+    while ( *s && *s <= 2*len )
+	s++;
+    return *s ? *s : len;
+}
+
+
 /*****************************************************************************
   QGDict member functions
  *****************************************************************************/
@@ -166,8 +235,6 @@ void QGDict::init( uint len )
     memset( (char*)vec, 0, vlen*sizeof(QBucket*) );
     numItems = 0;
     iterators = 0;
-
-    // Be careful not to break resize() if you add something.
 }
 
 /*!
@@ -239,6 +306,35 @@ QGDict &QGDict::operator=( const QGDict &dict )
 */
 
 
+/*!
+  \internal
+  Returns the full hash value for \e key, before it is reduced to an
+  index into the hash array.
+*/
+
+uint QGDict::hashOf( const char *key )
+{
+    if ( triv )					// key is a long/ptr
+	return (uint)(ulong)key;		// simple hash
+    return (uint)hashKey( key );		// key is a string
+}
+
+/*!
+  \internal
+  Returns TRUE if the bucket \e n holds \e key, which has the hash
+  value \e h.
+*/
+
+bool QGDict::match( QBucket *n, const char *key, uint h ) const
+{
+    if ( n->getHash() != h )
+	return FALSE;
+    if ( triv )
+	return n->getKey() == key;
+    return (cases ? strcmp(n->getKey(),key)
+		  : stricmp(n->getKey(),key)) == 0;
+}
+
 /*!
   \internal
   The do-it-all function; op is one of op_find, op_insert, op_replace
@@ -247,36 +343,32 @@ QGDict &QGDict::operator=( const QGDict &dict )
 GCI QGDict::look( const char *key, GCI d, int op )
 {
     register QBucket *n;
-    int	 index;
-    if ( triv ) {				// key is a long/ptr
-	index = (int)(long(key) % vlen);	// simple hash
-	if ( op == op_find ) {			// find
-	    for ( n=vec[index]; n; n=n->getNext() ) {
-		if ( n->getKey() == key )
-		    return n->getData();	// item found
-	    }
-	    return 0;				// not such item
-	}
-    } else {					// key is a string
-	index = hashKey( key ) % vlen;
-	if ( op == op_find ) {			// find
-	    for ( n=vec[index]; n; n=n->getNext() ) {
-		if ( (cases ? strcmp(n->getKey(),key)
-			 : stricmp(n->getKey(),key)) == 0 )
-		    return n->getData();	// item found
-	    }
-	    return 0;				// did not find the item
+    uint h = hashOf( key );
+    uint index = h % vlen;
+    if ( op == op_find ) {			// find
+	for ( n=vec[index]; n; n=n->getNext() ) {
+	    if ( match(n,key,h) )
+		return n->getData();		// item found
 	}
+	return 0;				// did not find the item
     }
     if ( op == op_replace ) {			// replace
 	if ( vec[index] != 0 )			// maybe something there
 	    remove( key );
     }
+    if ( numItems >= 2*vlen && !iterators ) {	// too crowded, grow
+	uint newsize = growSize( vlen );
+	if ( newsize != vlen ) {
+	    rehash( newsize );
+	    index = h % vlen;
+	}
+    }
     QBucket *node = new QBucket;		// insert new node
     CHECK_PTR( node );
     if ( !node )				// no memory
 	return 0;
     node->setKey( (char *)(copyk ? qstrdup(key) : key) );
+    node->setHash( h );
     node->setData( newItem(d) );
 #if defined(CHECK_NULL)
     if ( node->getData() == 0 )
@@ -296,30 +388,7 @@ GCI QGDict::look( const char *key, GCI d, int op )
 */
 void QGDict::resize( uint newsize )
 {
-    // Save old information
-    QBucket   **old_vec = vec;
-    uint	old_vlen = vlen;
-    QGDItList  *old_iterators = iterators;
-    bool	old_copyk = copyk;
-
-    init( newsize );
-    copyk = FALSE;
-
-    // Reinsert every item from vec, deleting vec as we go
-    for ( uint index = 0; index < old_vlen; index++ ) {
-	QBucket *n=old_vec[index];
-	while ( n ) {
-	    look( n->getKey(), n->getData(), op_insert );
-	    QBucket *t=n->getNext();
-	    delete n;
-	    n = t;
-	}
-    }
-    delete [] old_vec;
-
-    // Restore state
-    iterators = old_iterators;
-    copyk = old_copyk;
+    rehash( newsize );
 
     // `Invalidate' all iterators, since order is lost
     if ( iterators ) {			// update iterators
@@ -331,6 +400,40 @@ void QGDict::resize( uint newsize )
     }
 }
 
+/*!
+  \internal
+  Moves all buckets into a new hash array with \e newsize entries,
+  using the stored hash values.  Iterators are not updated.
+*/
+
+void QGDict::rehash( uint newsize )
+{
+    QBucket   **old_vec = vec;
+    uint	old_vlen = vlen;
+    vec = new QBucket *[vlen = newsize];
+    CHECK_PTR( vec );
+    memset( (char*)vec, 0, vlen*sizeof(QBucket*) );
+
+    for ( uint index = 0; index < old_vlen; index++ ) {
+	QBucket *n = old_vec[index];
+	QBucket *r = 0;
+	while ( n ) {				// reverse the chain, so that
+	    QBucket *t = n->getNext();		//   items with equal keys
+	    n->setNext( r );			//   keep their order
+	    r = n;
+	    n = t;
+	}
+	while ( r ) {				// link into new array
+	    QBucket *t = r->getNext();
+	    uint i = r->getHash() % vlen;
+	    r->setNext( vec[i] );
+	    vec[i] = r;
+	    r = t;
+	}
+    }
+    delete [] old_vec;
+}
+
 /*!
   \internal 
   Unlinks the bucket with the specified key (and specifed
@@ -343,19 +446,11 @@ QBucket *QGDict::unlink( const char *key, GCI d )
 	return 0;
     register QBucket *n;
     QBucket *prev = 0;
-    int index;
-    if ( triv )
-	index = (int)(long(key) % vlen);
-    else
-	index = hashKey( key ) % vlen;
+    uint h = hashOf( key );
+    uint index = h % vlen;
 
     for ( n=vec[index]; n; n=n->getNext() ) {	// find item in list
-	bool equal;
-	if ( triv )
-	    equal = n->getKey() == key;
-	else
-	    equal = (cases ? strcmp(n->getKey(),key)
-			   : stricmp(n->getKey(),key)) == 0;
+	bool equal = match( n, key, h );
 	if ( equal && d )
 	    equal = (n->getData() == d);
 	if ( equal ) {				// found node to be removed
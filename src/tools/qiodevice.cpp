@@ -337,7 +337,9 @@ void QIODevice::setStatus( int s )
 
   The mode parameter \e m must be a combination of the following flags.
   <ul>
-  <li>\c IO_Raw specified raw (unbuffered) file access.
+  <li>\c IO_Raw specifies raw file access, bypassing the C library's
+  buffering.  QFile still reads regular files ahead in blocks; see
+  QFile::setReadBufferSize().
   <li>\c IO_ReadOnly opens a file in read-only mode.
   <li>\c IO_WriteOnly opens a file in write-only mode.
   <li>\c IO_ReadWrite opens a file in read/write mode.
@@ -346,6 +348,7 @@ void QIODevice::setStatus( int s )
   <li>\c IO_Translate enables carriage returns and linefeed translation
   for text files under MS-DOS, Window, OS/2 and Macintosh.  Cannot be
   combined with \c IO_Raw.
+  <li>\c IO_Mapped maps a file read-only into memory.
   </ul>
 
   This virtual function must be reimplemented by all subclasses.
@@ -483,6 +486,46 @@ int QIODevice::readLine( char *data, uint maxlen )
 }
 
 
+/*!
+  Returns a pointer to the data that the next read operation will
+  return and sets \e *len to the number of bytes available there,
+  without reading them.  Call skipBlock() to consume them.
+
+  Returns 0 if the device has no such data at hand, either because it is
+  at the end or because it does not buffer its data.  The default
+  implementation always returns 0.
+
+  This makes it possible to search for a delimiter in the data without
+  reading it one byte at a time; QTextStream::readLine() uses it.
+
+  \sa skipBlock(), readBlock()
+*/
+
+const char *QIODevice::peekBlock( uint *len )
+{
+    *len = 0;
+    return 0;
+}
+
+/*!
+  Skips \e len bytes of the data returned by peekBlock().  \e len must
+  not be larger than the length peekBlock() returned.
+
+  The default implementation reads the bytes and throws them away.
+*/
+
+void QIODevice::skipBlock( uint len )
+{
+    char buf[256];
+    while ( len ) {
+	int n = readBlock( buf, QMIN(len, sizeof(buf)) );
+	if ( n <= 0 )
+	    break;
+	len -= n;
+    }
+}
+
+
 /*!
   \fn int QIODevice::getch()
 
@@ -24,6 +24,7 @@
 #include "qregexp.h"
 #include <ctype.h>
 #include <stdlib.h>
+#include <string.h>
 
 /*!
   \class QRegExp qregexp.h
@@ -93,6 +94,346 @@ const int PatSyntax	= 2;			// pattern syntax error
 const int PatOverflow	= 4;			// pattern too long
 
 
+/*****************************************************************************
+  Match engine
+
+  Patterns without word boundaries are also compiled (lazily) to a DFA
+  over the pattern items, which answers "is there a match here at all"
+  in a single pass without backtracking.  The backtracking matcher is
+  then only run at a position where a match is known to start, to get
+  the exact same match length as before.  Independently of the DFA, the
+  longest run of plain characters that every match must contain is used
+  to reject strings, and to skip to candidate positions when the pattern
+  starts with it.
+ *****************************************************************************/
+
+const int  RxOne	= 0;			// item repetitions
+const int  RxStar	= 1;
+const int  RxOpt	= 2;
+const int  RxMaxItems	= 255;			// no DFA for longer patterns
+const int  RxMaxStates	= 256;			// ... or when it gets this big
+
+struct QRegExpItem {
+    uint	set[8];				// bytes matched by the item
+    int		rep;
+};
+
+struct QRegExpDState {
+    uint       *set;				// items still to be matched
+    bool	accept;				// a match ends here
+    bool	acceptEnd;			// ... if at end of string
+    bool	dead;				// no match can end from here
+    short	next[256];			// -1 if not computed yet
+};
+
+struct QRegExpDFA {
+    QRegExpDFA() : states(0), count(0) {}
+   ~QRegExpDFA();
+    QRegExpDState **states;
+    int		count;
+};
+
+QRegExpDFA::~QRegExpDFA()
+{
+    for ( int i=0; i<count; i++ ) {
+	delete [] states[i]->set;
+	delete states[i];
+    }
+    delete [] states;
+}
+
+struct QRegExpEngine {
+    QRegExpEngine() : items(0), nitems(0), eol(FALSE), empty(FALSE),
+		      dfa(FALSE), litlen(0) {}
+   ~QRegExpEngine() { delete [] items; }
+    QRegExpItem *items;
+    int		nitems;
+    int		nwords;				// uints in an item set
+    bool	eol;				// pattern ends with $
+    bool	empty;				// matches the empty string
+    bool	dfa;				// the DFA can be used
+    QRegExpDFA	anchored;			// matches starting here
+    QRegExpDFA	unanchored;			// matches starting anywhere
+    int		litlen;				// required literal, 0 if none
+    int		litpos;				// first item of it
+    int		litskip[256];			// Horspool shift table
+};
+
+static inline bool rx_in( const uint *set, int i )
+{
+    return (set[i >> 5] >> (i & 31)) & 1;
+}
+
+static inline void rx_add( uint *set, int i )
+{
+    set[i >> 5] |= 1 << (i & 31);
+}
+
+/*
+  Adds the items that can be skipped because they are optional.
+*/
+
+static void rx_closure( QRegExpEngine *e, uint *set )
+{
+    for ( int i=0; i<e->nitems; i++ ) {
+	if ( e->items[i].rep != RxOne && rx_in(set,i) )
+	    rx_add( set, i+1 );
+    }
+}
+
+/*
+  Analyzes the compiled pattern \a d, which has at most \a maxitems
+  items.  The byte sets of the items are
+  computed with the exact tests used by QRegExp::matchstr(), so that
+  both matchers agree on every byte.
+*/
+
+static QRegExpEngine *rx_engine( const ushort *d, bool cs, int maxitems )
+{
+    QRegExpEngine *e = new QRegExpEngine;
+    CHECK_PTR( e );
+    const ushort *p;
+    e->items = new QRegExpItem[maxitems];
+    CHECK_PTR( e->items );
+    bool dfa = TRUE;				// no word boundaries
+    bool bad = FALSE;				// not understood
+    int	 run = 0;				// current literal run
+    p = d;
+    if ( *p == BOL )
+	p++;
+    while ( *p ) {
+	if ( *p == BOW || *p == EOW ) {		// zero width, not in the DFA
+	    dfa = FALSE;
+	    run = 0;
+	    p++;
+	    continue;
+	}
+	QRegExpItem *it = &e->items[e->nitems];
+	memset( it->set, 0, sizeof(it->set) );
+	it->rep = RxOne;
+	if ( *p == CLO || *p == OPT ) {
+	    it->rep = *p == CLO ? RxStar : RxOpt;
+	    p++;
+	}
+	int  b;
+	bool chr = FALSE;
+	if ( *p & CHR ) {
+	    chr = TRUE;
+	    char c = (char)*p;
+	    for ( b=0; b<256; b++ ) {
+		char ch = (char)b;
+		if ( cs ? ch == c : tolower(ch) == c )
+		    rx_add( it->set, b );
+	    }
+	    p++;
+	} else if ( *p == ANY ) {
+	    for ( b=1; b<256; b++ )
+		rx_add( it->set, b );
+	    p++;
+	} else if ( *p == CCL ) {
+	    p++;
+	    for ( b=0; b<256; b++ ) {
+		if ( p[b >> 4] & (1 << (b & 0xf)) )
+		    rx_add( it->set, b );
+	    }
+	    p += 16;
+	} else if ( *p == EOL && it->rep == RxOne && p[1] == END ) {
+	    e->eol = TRUE;
+	    break;
+	} else {
+	    bad = TRUE;
+	    break;
+	}
+	if ( (it->rep != RxOne && *p++ != END) ||
+	     rx_in(it->set,0) ) {		// would run past the string
+	    bad = TRUE;
+	    break;
+	}
+	if ( chr && it->rep == RxOne ) {	// part of a literal
+	    if ( ++run > e->litlen ) {
+		e->litlen = run;
+		e->litpos = e->nitems - run + 1;
+	    }
+	} else {
+	    run = 0;
+	}
+	e->nitems++;
+    }
+    if ( bad ) {				// leave it to matchstr()
+	e->litlen = 0;
+	return e;
+    }
+    if ( dfa && e->nitems <= RxMaxItems ) {
+	e->dfa = TRUE;
+	e->nwords = (e->nitems + 1 + 31) / 32;
+	uint set[8];
+	memset( set, 0, sizeof(set) );
+	rx_add( set, 0 );
+	rx_closure( e, set );
+	e->empty = rx_in( set, e->nitems ) && !e->eol;
+    }
+    if ( e->litlen ) {
+	int m = e->litlen;
+	for ( int b=0; b<256; b++ )
+	    e->litskip[b] = m;
+	for ( int j=0; j<m-1; j++ ) {
+	    QRegExpItem *it = &e->items[e->litpos+j];
+	    for ( int b=0; b<256; b++ ) {
+		if ( rx_in(it->set,b) )
+		    e->litskip[b] = m-1-j;
+	    }
+	}
+    }
+    return e;
+}
+
+/*
+  Returns the first occurrence of the required literal in [p,end), or 0.
+*/
+
+static const char *rx_literal( QRegExpEngine *e, const char *p,
+			       const char *end )
+{
+    QRegExpItem *lit = &e->items[e->litpos];
+    int m = e->litlen;
+    if ( m == 1 ) {
+	while ( p < end && !rx_in(lit->set,(uchar)*p) )
+	    p++;
+	return p < end ? p : 0;
+    }
+    const uchar *s = (const uchar *)p;
+    const uchar *last = (const uchar *)end - m;
+    while ( s <= last ) {
+	int j = m-1;
+	while ( rx_in(lit[j].set,s[j]) ) {
+	    if ( j-- == 0 )
+		return (const char *)s;
+	}
+	s += e->litskip[s[m-1]];
+    }
+    return 0;
+}
+
+/*
+  Returns the state of \a dfa for the item set \a set, creating it if
+  needed.  Returns -1 if the DFA has grown too big.
+*/
+
+static int rx_state( QRegExpEngine *e, QRegExpDFA *dfa, const uint *set )
+{
+    int i;
+    int nw = e->nwords;
+    for ( i=0; i<dfa->count; i++ ) {
+	if ( memcmp(dfa->states[i]->set,set,nw*sizeof(uint)) == 0 )
+	    return i;
+    }
+    if ( dfa->count == RxMaxStates )
+	return -1;
+    if ( dfa->count == 0 ) {
+	dfa->states = new QRegExpDState*[RxMaxStates];
+	CHECK_PTR( dfa->states );
+    }
+    QRegExpDState *st = new QRegExpDState;
+    CHECK_PTR( st );
+    st->set = new uint[nw];
+    CHECK_PTR( st->set );
+    memcpy( st->set, set, nw*sizeof(uint) );
+    st->acceptEnd = rx_in( set, e->nitems );
+    st->accept = st->acceptEnd && !e->eol;
+    st->dead = dfa == &e->anchored;
+    for ( i=0; i<nw && st->dead; i++ )
+	st->dead = set[i] == 0;
+    for ( i=0; i<256; i++ )
+	st->next[i] = -1;
+    dfa->states[dfa->count] = st;
+    return dfa->count++;
+}
+
+/*
+  Returns the state after reading byte \a b in state \a s, or -1 if the
+  DFA has grown too big.  In the unanchored DFA a new match may start
+  at every byte.
+*/
+
+static int rx_next( QRegExpEngine *e, QRegExpDFA *dfa, int s, uchar b )
+{
+    QRegExpDState *st = dfa->states[s];
+    if ( st->next[b] >= 0 )
+	return st->next[b];
+    uint from[8], to[8];
+    int nw = e->nwords;
+    memcpy( from, st->set, nw*sizeof(uint) );
+    if ( dfa == &e->unanchored ) {
+	rx_add( from, 0 );
+	rx_closure( e, from );
+    }
+    memset( to, 0, nw*sizeof(uint) );
+    for ( int i=0; i<e->nitems; i++ ) {
+	if ( rx_in(from,i) && rx_in(e->items[i].set,b) )
+	    rx_add( to, e->items[i].rep == RxStar ? i : i+1 );
+    }
+    rx_closure( e, to );
+    int n = rx_state( e, dfa, to );
+    if ( n >= 0 )
+	dfa->states[s]->next[b] = n;		// states[] is stable
+    return n;
+}
+
+/*
+  Runs the anchored DFA from \a p.  Returns 1 if a match starts at \a p,
+  0 if none does, and -1 if the DFA cannot tell.
+*/
+
+static int rx_dfa_anchored( QRegExpEngine *e, const char *p, const char *end )
+{
+    QRegExpDFA *dfa = &e->anchored;
+    uint set[8];
+    memset( set, 0, e->nwords*sizeof(uint) );
+    rx_add( set, 0 );
+    rx_closure( e, set );
+    int s = rx_state( e, dfa, set );
+    while ( s >= 0 ) {
+	QRegExpDState *st = dfa->states[s];
+	if ( st->accept || (p == end && st->acceptEnd) )
+	    return 1;
+	if ( p == end || st->dead )
+	    return 0;
+	s = rx_next( e, dfa, s, (uchar)*p++ );
+    }
+    return -1;
+}
+
+/*
+  Runs the unanchored DFA over [p,end).  Returns 1 and sets \a mend to
+  the end of the earliest ending match if there is a match starting
+  before \a end, 0 if there is none, and -1 if the DFA cannot tell.
+*/
+
+static int rx_dfa_scan( QRegExpEngine *e, const char *p, const char *end,
+			const char **mend )
+{
+    QRegExpDFA *dfa = &e->unanchored;
+    uint set[8];
+    memset( set, 0, e->nwords*sizeof(uint) );	// nothing started yet
+    int s = rx_state( e, dfa, set );
+    while ( s >= 0 ) {
+	QRegExpDState *st = dfa->states[s];
+	if ( p == end ) {
+	    if ( !st->acceptEnd )
+		return 0;
+	    *mend = p;
+	    return 1;
+	}
+	if ( st->accept || e->empty ) {
+	    *mend = p;
+	    return 1;
+	}
+	s = rx_next( e, dfa, s, (uchar)*p++ );
+    }
+    return -1;
+}
+
+
 /*****************************************************************************
   QRegExp member functions
  *****************************************************************************/
@@ -104,6 +445,7 @@ const int PatOverflow	= 4;			// pattern too long
 QRegExp::QRegExp()
 {
     rxdata = 0;
+    engine = 0;
     cs = TRUE;
     wc = FALSE;
     error = PatOk;
@@ -126,6 +468,7 @@ QRegExp::QRegExp( const char *pattern, bool caseSensitive, bool wildcard )
 {
     rxstring = pattern;
     rxdata = 0;
+    engine = 0;
     cs = caseSensitive;
     wc = wildcard;
     compile();
@@ -140,6 +483,7 @@ QRegExp::QRegExp( const QRegExp &r )
 {
     rxstring = r.pattern();
     rxdata = 0;
+    engine = 0;
     cs = r.caseSensitive();
     wc = r.wildcard();
     compile();
@@ -153,6 +497,7 @@ QRegExp::~QRegExp()
 {
     if ( rxdata )                      // Avoid purify complaints
 	delete [] rxdata;
+    delete engine;
 }
 
 /*!
@@ -296,11 +641,39 @@ int QRegExp::match( const char *str, int index, int *len ) const
     register char *p = (char *)str + index;
     ushort *d  = rxdata;
     char   *ep = 0;
+    QRegExpEngine *e = engine;
+    if ( !e )					// analyze on first use
+	e = ((QRegExp*)this)->engine =
+	    rx_engine( d, cs, 2*rxstring.length()+4 );
+    char *end  = 0;
+    char *stop = 0;				// no match starts from here on
+    bool none  = FALSE;
+    if ( e->litlen || e->dfa ) {
+	end = stop = p + strlen( p );
+	if ( e->litlen && !rx_literal(e,p,end) )
+	    none = TRUE;			// required literal missing
+    }
 
-    if ( *d == BOL ) {				// match from beginning of line
-	ep = matchstr( d, p, p );
+    if ( none ) {
+	;
+    } else if ( *d == BOL ) {			// match from beginning of line
+	if ( !e->dfa || rx_dfa_anchored(e,p,end) != 0 )
+	    ep = matchstr( d, p, p );
     } else {
-	if ( *d & CHR ) {
+	const char *mend;
+	if ( e->dfa ) {
+	    switch ( rx_dfa_scan(e,p,end,&mend) ) {
+		case 0:
+		    stop = p;			// no match at all
+		    break;
+		case 1:				// starts at or before mend
+		    if ( mend < end )
+			stop = (char *)mend + 1;
+		    break;
+	    }
+	}
+	bool prefix = e->litlen && e->litpos == 0;
+	if ( (*d & CHR) && !prefix ) {
 	    if ( cs ) {				// case sensitive
 		while ( *p && *p != (char)*d )
 		    p++;
@@ -309,9 +682,16 @@ int QRegExp::match( const char *str, int index, int *len ) const
 		    p++;
 	    }
 	}
-	while ( *p ) {				// regular match
-	    if ( (ep=matchstr(d,p,(char*)str+index)) )
-		break;
+	while ( *p && (!end || p < stop) ) {	// regular match
+	    if ( prefix ) {			// skip to the next candidate
+		p = (char *)rx_literal( e, p, end );
+		if ( !p || p >= stop )
+		    break;
+	    }
+	    if ( !e->dfa || rx_dfa_anchored(e,p,end) != 0 ) {
+		if ( (ep=matchstr(d,p,(char*)str+index)) )
+		    break;
+	    }
 	    p++;
 	}
     }
@@ -637,6 +1017,8 @@ void QRegExp::compile()
 	delete [] rxdata;
 	rxdata = 0;
     }
+    delete engine;
+    engine = 0;
     if ( rxstring.isEmpty() ) {			// no regexp pattern set
 	error = PatNull;
 	return;
@@ -28,6 +28,8 @@
 #include "qstring.h"
 #endif // QT_H
 
+struct QRegExpEngine;
+
 
 class Q_EXPORT QRegExp
 {
@@ -63,6 +65,7 @@ protected:
 private:
     QString	rxstring;			// regular expression pattern
     ushort     *rxdata;				// compiled regexp pattern
+    QRegExpEngine *engine;			// prefilter and DFA, lazy
     int		error;				// error status
     bool	cs;				// case sensitive
     bool	wc;				// wildcard
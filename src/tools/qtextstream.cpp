@@ -749,7 +749,40 @@ QString QTextStream::readLine()
 	return nullString;
     }
 #endif
-    QString  *dynbuf = 0;
+    uint len;
+    const char *b = dev->peekBlock( &len );
+    if ( b ) {					// scan the device's buffer
+	const char *nl = (const char *)memchr( b, '\n', len );
+	if ( nl ) {				// the common case, one copy
+	    int i = nl - b;
+	    QString str( i+1 );
+	    memcpy( str.data(), b, i );
+	    dev->skipBlock( i+1 );
+	    if ( i > 0 && str[i-1] == '\r' )
+		str.truncate( i-1 );		// if there are two \r, one stays
+	    return str;
+	}
+	QString str( len+1 );			// the line goes on and on
+	uint i = 0;
+	while ( b ) {
+	    nl = (const char *)memchr( b, '\n', len );
+	    uint n = nl ? nl - b : len;
+	    if ( i+n+1 > str.size() )
+		str.resize( QMAX(i+n+1, str.size()*2) );
+	    memcpy( str.data()+i, b, n );
+	    i += n;
+	    dev->skipBlock( nl ? n+1 : n );
+	    if ( nl )
+		break;
+	    b = dev->peekBlock( &len );
+	}
+	if ( i > 0 && str[(int)i-1] == '\r' )
+	    i--;
+	str.truncate( i );
+	return str;
+    }
+
+    QString  *dynbuf = 0;			// read one byte at a time
     const int buflen = 256;
     char      buffer[buflen];
     char     *s = buffer;
@@ -29,21 +29,146 @@
 #include "qscrollbar.h"
 #include "qpixmap.h"
 #include "qapplication.h"
+#include "qbitarray.h"
 
-Q_DECLARE(QListM, QListBoxItem);
+/*
+  Stands in for the item at one index when the list box gets its rows
+  from a QListBoxProvider.
+*/
+
+class QLBProviderItem : public QListBoxItem	// internal class
+{
+public:
+    QLBProviderItem() : prov( 0 ), index( -1 ) {}
+    const char *text() const { return prov->text( index ); }
+    const QPixmap *pixmap() const { return prov->pixmap( index ); }
+    int height( const QListBox * ) const;
+    int width( const QListBox * ) const;
+    void paint( QPainter * );
+
+    QListBoxProvider *prov;
+    int index;
+};
+
+int QLBProviderItem::height( const QListBox *lb ) const
+{
+    return lb->fontMetrics().lineSpacing() + 1;
+}
+
+int QLBProviderItem::width( const QListBox *lb ) const
+{
+    const QPixmap *pm = pixmap();
+    if ( pm )
+	return pm->width() + 6;
+    return lb->fontMetrics().width( text() ) + 6;
+}
+
+void QLBProviderItem::paint( QPainter *p )
+{
+    const QPixmap *pm = pixmap();
+    if ( pm ) {
+	p->drawPixmap( 3, 0, *pm );
+    } else {
+	QFontMetrics fm = p->fontMetrics();
+	p->drawText( 3,  fm.ascent() + fm.leading()/2, text() );
+    }
+}
+
+
+/*
+  The items of a list box, in an array so that any item can be reached
+  directly, or the provider and the number of rows it provides.
+*/
 
-class QLBItemList : public QListM(QListBoxItem) // internal class
+class QLBItemList // internal class
 {
-    int compareItems( GCI i1, GCI i2);
 public:
+    QLBItemList();
+   ~QLBItemList();
+
+    uint count() const { return prov ? numRows : n; }
+    QListBoxItem *at( int i );
+    void insert( int i, const QListBoxItem * );
+    QListBoxItem *take( int i );
+    int sortedIndex( const char * ) const;
+
     int timerId;				//### bincomp
+
+    QListBoxProvider *prov;
+    uint numRows;
+    QLBProviderItem provItem;
+    QBitArray provSelected;
+
+private:
+    QListBoxItem **items;
+    int n;
+    int size;
 };
 
-int QLBItemList::compareItems( GCI i1, GCI i2)
+QLBItemList::QLBItemList()
+    : timerId( 0 ), prov( 0 ), numRows( 0 ), items( 0 ), n( 0 ), size( 0 )
+{
+}
+
+QLBItemList::~QLBItemList()
+{
+    delete [] items;
+}
+
+QListBoxItem *QLBItemList::at( int i )
+{
+    if ( (uint)i >= count() )
+	return 0;
+    if ( prov ) {
+	provItem.prov = prov;
+	provItem.index = i;
+	return &provItem;
+    }
+    return items[i];
+}
+
+void QLBItemList::insert( int i, const QListBoxItem *lbi )
+{
+    if ( n == size ) {
+	int newSize = QMAX( size*2, 16 );
+	QListBoxItem **a = new QListBoxItem *[newSize];
+	CHECK_PTR( a );
+	if ( items )
+	    memcpy( a, items, n * sizeof(QListBoxItem *) );
+	delete [] items;
+	items = a;
+	size = newSize;
+    }
+    memmove( items + i + 1, items + i, (n - i) * sizeof(QListBoxItem *) );
+    items[i] = (QListBoxItem *)lbi;
+    n++;
+}
+
+QListBoxItem *QLBItemList::take( int i )
 {
-    QListBoxItem *lbi1 = (QListBoxItem *)i1;
-    QListBoxItem *lbi2 = (QListBoxItem *)i2;
-    return strcmp( lbi1->text(), lbi2->text() );
+    QListBoxItem *lbi = items[i];
+    n--;
+    memmove( items + i, items + i + 1, (n - i) * sizeof(QListBoxItem *) );
+    return lbi;
+}
+
+/*
+  Returns the index before the first item whose text is not less than
+  \a text, assuming the items are sorted.
+*/
+
+int QLBItemList::sortedIndex( const char *text ) const
+{
+    int lo = 0;
+    int hi = n;
+    while ( lo < hi ) {
+	int mid = (lo + hi) / 2;
+	if ( qstrcmp( items[mid]->text(), text ) < 0 )
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
 }
 
 
@@ -73,6 +198,17 @@ static inline bool checkIndex( const char *method, const char * name,
     return !range_err;
 }
 
+static inline bool checkNoProvider( const char *method, const char * name,
+				    const QLBItemList *itemList )
+{
+#if defined(CHECK_STATE)
+    if ( itemList->prov )
+	warning( "QListBox::%s: (%s) Items come from a provider",
+		 method, name ? name : "<no name>" );
+#endif
+    return itemList->prov == 0;
+}
+
 
 /*!
   \class QListBoxItem qlistbox.h
@@ -372,6 +508,9 @@ int QListBoxPixmap::width( const QListBox * ) const
   If you need to insert other types than texts and pixmaps, you must
   define new classes which inherit QListBoxItem.
 
+  Very long lists need not be built from items at all: setProvider()
+  makes the list box ask a QListBoxProvider for the rows it shows.
+
   \warning The list box assumes ownership of all list box items
   and will delete them when they are not needed.
 
@@ -423,7 +562,6 @@ QListBox::QListBox( QWidget *parent, const char *name, WFlags f )
     goingDown	  = FALSE;
     itemList	  = new QLBItemList;
     CHECK_PTR( itemList );
-    itemList->timerId = 0;
     setCellWidth( 0 );
     QFontMetrics fm = fontMetrics();
     setCellHeight( fm.lineSpacing() + 1 );
@@ -552,7 +690,8 @@ uint QListBox::count() const
 
 void QListBox::insertStrList( const QStrList *list, int index )
 {
-    if ( !checkInsertIndex( "insertStrList", name(), count(), &index ) )
+    if ( !checkNoProvider( "insertStrList", name(), itemList ) ||
+	 !checkInsertIndex( "insertStrList", name(), count(), &index ) )
 	return;
     if ( !list ) {
 #if defined(CHECK_NULL)
@@ -587,7 +726,8 @@ void QListBox::insertStrList( const QStrList *list, int index )
 
 void QListBox::insertStrList( const char **strings, int numStrings, int index )
 {
-    if ( !checkInsertIndex( "insertStrList", name(), count(), &index ) )
+    if ( !checkNoProvider( "insertStrList", name(), itemList ) ||
+	 !checkInsertIndex( "insertStrList", name(), count(), &index ) )
 	return;
     if ( !strings ) {
 #if defined(CHECK_NULL)
@@ -621,7 +761,8 @@ void QListBox::insertStrList( const char **strings, int numStrings, int index )
 
 void QListBox::insertItem( const QListBoxItem *lbi, int index )
 {
-    if ( !checkInsertIndex( "insertItem", name(), count(), &index ) )
+    if ( !checkNoProvider( "insertItem", name(), itemList ) ||
+	 !checkInsertIndex( "insertItem", name(), count(), &index ) )
 	return;
     if ( !lbi ) {
 #if defined ( CHECK_NULL )
@@ -651,7 +792,8 @@ void QListBox::insertItem( const QListBoxItem *lbi, int index )
 
 void QListBox::insertItem( const char *text, int index )
 {
-    if ( !checkInsertIndex( "insertItem", name(), count(), &index ) )
+    if ( !checkNoProvider( "insertItem", name(), itemList ) ||
+	 !checkInsertIndex( "insertItem", name(), count(), &index ) )
 	return;
     if ( !text ) {
 #if defined ( CHECK_NULL )
@@ -681,7 +823,8 @@ void QListBox::insertItem( const char *text, int index )
 
 void QListBox::insertItem( const QPixmap &pixmap, int index )
 {
-    if ( !checkInsertIndex( "insertItem", name(), count(), &index ) )
+    if ( !checkNoProvider( "insertItem", name(), itemList ) ||
+	 !checkInsertIndex( "insertItem", name(), count(), &index ) )
 	return;
     if ( stringsOnly ) {
 	stringsOnly = FALSE;
@@ -719,10 +862,7 @@ void QListBox::inSort( const QListBoxItem *lbi )
 	return;
     }
 
-    itemList->inSort( lbi );
-    int index = itemList->at();
-    itemList->remove();
-    insertItem( lbi, index );
+    insertItem( lbi, itemList->sortedIndex( lbi->text() ) );
 }
 
 
@@ -738,11 +878,7 @@ void QListBox::inSort( const char *text )
 #endif
 	return;
     }
-    QListBoxText lbi( text );
-    itemList->inSort(&lbi);
-    int index = itemList->at();
-    itemList->remove();
-    insertItem( text, index );
+    insertItem( text, itemList->sortedIndex( text ) );
 }
 
 
@@ -755,7 +891,8 @@ void QListBox::inSort( const char *text )
 
 void QListBox::removeItem( int index )
 {
-    if ( !checkIndex( "removeItem", name(), count(), index ) )
+    if ( !checkNoProvider( "removeItem", name(), itemList ) ||
+	 !checkIndex( "removeItem", name(), count(), index ) )
 	return;
     bool currentChanged = ( current == index );
 
@@ -794,6 +931,96 @@ void QListBox::clear()
 }
 
 
+/*!
+  Makes the list box show \a count rows whose text and pixmap are
+  asked from \a provider when they are needed, instead of owning an
+  item for every row.  All existing items are deleted.
+
+  Call setProvider() again with the same provider when the number of
+  rows changes; the current item and the selection are kept as far as
+  possible.  setProvider( 0, 0 ) or clear() returns to normal mode.
+
+  While the list box has a provider, the functions that insert,
+  remove or change items do nothing.  All rows have the height of a
+  line of text, and the list box measures rows as it shows them, so
+  its width grows as the user scrolls to wider rows.
+
+  \sa provider(), QListBoxProvider
+*/
+
+void QListBox::setProvider( QListBoxProvider *provider, uint count )
+{
+    if ( !provider )
+	count = 0;
+    if ( !provider || provider != itemList->prov ) {
+	clearList();
+	itemList->prov = provider;
+    }
+    itemList->numRows = count;
+    uint old = itemList->provSelected.size();
+    itemList->provSelected.resize( count );
+    for( uint i = old; i < count && i % 8; i++ )
+	itemList->provSelected.clearBit( i );	// rows that went away
+    if ( current >= (int)count )
+	current = count - 1;
+    setCellHeight( fontMetrics().lineSpacing() + 1 );
+    updateNumRows( TRUE );
+    if ( autoUpdate() )
+	repaint();
+}
+
+/*!
+  Returns the provider set with setProvider(), or 0 if the list box
+  owns its items.
+*/
+
+QListBoxProvider *QListBox::provider() const
+{
+    return itemList->prov;
+}
+
+
+/*!
+  \class QListBoxProvider qlistbox.h
+  \brief The QListBoxProvider class supplies the rows of a list box
+  that does not own its items.
+
+  A list box with a million rows does not need a million QListBoxItem
+  objects.  Subclass QListBoxProvider, reimplement text() and maybe
+  pixmap(), and pass it to QListBox::setProvider() together with the
+  number of rows.  The list box then asks for the rows it paints, and
+  QListBox::text() and QListBox::pixmap() ask the provider.
+
+  The provider is not deleted by the list box.
+
+  \sa QListBox::setProvider()
+*/
+
+/*!
+  Destroys the provider.
+*/
+
+QListBoxProvider::~QListBoxProvider()
+{
+}
+
+/*!
+  \fn const char *QListBoxProvider::text( int index ) const
+
+  Implement this function to return the text of row \a index.
+*/
+
+/*!
+  Returns the pixmap of row \a index, or 0 if the row shows text().
+  The default implementation returns 0.
+*/
+
+const QPixmap *QListBoxProvider::pixmap( int ) const
+{
+    return 0;
+}
+
+
 /*!
   Returns a pointer to the text at position \e index, or 0 if there is no
   text there.
@@ -830,7 +1057,8 @@ const QPixmap *QListBox::pixmap( int index ) const
 
 void QListBox::changeItem( const char *text, int index )
 {
-    if ( !checkIndex( "changeItem", name(), count(), index ) )
+    if ( !checkNoProvider( "changeItem", name(), itemList ) ||
+	 !checkIndex( "changeItem", name(), count(), index ) )
 	return;
     change( new QListBoxText(text), index );
 }
@@ -845,7 +1073,8 @@ void QListBox::changeItem( const char *text, int index )
 
 void QListBox::changeItem( const QPixmap &pixmap, int index )
 {
-    if ( !checkIndex( "changeItem", name(), count(), index ) )
+    if ( !checkNoProvider( "changeItem", name(), itemList ) ||
+	 !checkIndex( "changeItem", name(), count(), index ) )
 	return;
     change( new QListBoxPixmap(pixmap), index );
 }
@@ -860,7 +1089,8 @@ void QListBox::changeItem( const QPixmap &pixmap, int index )
 
 void QListBox::changeItem( const QListBoxItem *lbi, int index )
 {
-    if ( !checkIndex( "changeItem", name(), count(), index ) )
+    if ( !checkNoProvider( "changeItem", name(), itemList ) ||
+	 !checkIndex( "changeItem", name(), count(), index ) )
 	return;
     change( lbi, index );
 }
@@ -1273,6 +1503,18 @@ void QListBox::paintCell( QPainter *p, int row, int col )
     QListBoxItem *lbi = itemList->at( row );
     if ( !lbi )
 	return;
+    if ( itemList->prov ) {			// measure provided rows as shown
+	int w = lbi->width( this );
+	if ( w > maxItemWidth() ) {
+	    setMaxItemWidth( w );
+	    bool a = autoUpdate();
+	    setAutoUpdate( FALSE );		// no repaint() while painting
+	    setCellWidth( QMAX( w, viewWidth() ) );
+	    setAutoUpdate( a );
+	    if ( a )
+		update();
+	}
+    }
 
     QColorGroup g = colorGroup();
     if ( isSelected( row ) ) {
@@ -1654,9 +1896,12 @@ void QListBox::updateItem( int index, bool erase )
 void QListBox::clearList()
 {
     stringsOnly = TRUE;
+    itemList->prov = 0;
+    itemList->numRows = 0;
+    itemList->provSelected.resize( 0 );
     QListBoxItem *lbi;
     while ( itemList->count() ) {
-	lbi = itemList->take( 0 );
+	lbi = itemList->take( itemList->count() - 1 );
 	delete lbi;
     }
     if ( goingDown || QApplication::closingDown() )
@@ -1673,18 +1918,28 @@ void QListBox::clearList()
 /*!
   Traverses the list and finds an item with the maximum width, and
   updates the internal list box structures accordingly.
+
+  If the items come from a provider(), only the visible items are
+  measured here; the other rows are measured when they are painted.
+  The width never shrinks.
 */
 
 void QListBox::updateCellWidth()
 {
-    QListBoxItem *lbi = itemList->first();
     int maxW = 0;
     int w;
-    while ( lbi ) {
-	w = lbi->width( this );
+    int i = 0;
+    int last = count() - 1;
+    if ( itemList->prov ) {
+	maxW = (int)maxItemWidth();
+	i = QMAX( topCell(), 0 );
+	last = QMIN( lastRowVisible(), last );
+    }
+    while ( i <= last ) {
+	w = itemList->at( i )->width( this );
 	if ( w > maxW )
 	    maxW = w;
-	lbi = itemList->next();
+	i++;
     }
     setMaxItemWidth( maxW );
     setCellWidth( QMAX( maxW, viewWidth() ) );
@@ -1858,7 +2113,10 @@ void QListBox::toggleCurrentItem()
     if ( !i )
 	return;
 
-    i->selected = !i->selected;
+    if ( itemList->prov )
+	itemList->provSelected.toggleBit( currentItem() );
+    else
+	i->selected = !i->selected;
     updateItem( currentItem() );
     emitChangedSignal( TRUE );
 }
@@ -1894,10 +2152,13 @@ void QListBox::setSelected( int index, bool select )
 	return;
 
     QListBoxItem *lbi = item( index );
-    if ( !lbi || lbi->selected == select )
+    if ( !lbi || isSelected( index ) == select )
 	return;
 
-    lbi->selected = select;
+    if ( itemList->prov )
+	itemList->provSelected.setBit( index, select );
+    else
+	lbi->selected = select;
     updateItem( index );
     emitChangedSignal( TRUE );
 }
@@ -1914,6 +2175,8 @@ bool QListBox::isSelected( int i ) const
 	return i == current;
 
     QListBoxItem * lbi = item( i );
+    if ( lbi && itemList->prov )
+	return itemList->provSelected.testBit( i );
     return lbi ? lbi->selected : FALSE;
 }
 
@@ -108,6 +108,16 @@ private:	// Disabled copy constructor and operator=
 };
 
 
+class Q_EXPORT QListBoxProvider
+{
+public:
+    virtual ~QListBoxProvider();
+
+    virtual const char	  *text( int index )   const = 0;
+    virtual const QPixmap *pixmap( int index ) const;
+};
+
+
 class Q_EXPORT QListBox : public QTableView		// list box widget
 {
     Q_OBJECT
@@ -131,6 +141,9 @@ public:
     void	removeItem( int index );
     void	clear();
 
+    void	setProvider( QListBoxProvider *, uint count );
+    QListBoxProvider *provider() const;
+
     const char *text( int index )	const;
     const QPixmap *pixmap( int index )	const;
 
@@ -88,13 +88,54 @@ struct QListViewPrivate
 	QListViewItem * i;
     };
 
-    // for sorting
-    class SortableItem {
+    // the children of an item with many children, by position, with a
+    // Fenwick tree over their total heights
+    class ChildIndex {
       public:
-	QString key;
+	ChildIndex(): items(0), tree(0), heights(0), n(0), max(0),
+		      total(0), valid(FALSE), dirty(0), ndirty(0) {}
+	~ChildIndex() { delete[] items; delete[] tree; delete[] heights;
+			delete[] dirty; }
+	void resize( int );
+	void buildTree();
+	void add( int k, int delta );
+	int prefix( int k ) const;
+	int find( int y ) const;
+	void markDirty( QListViewItem * );
+
+	QListViewItem ** items;
+	int * tree;			// 1-based
+	int * heights;			// as summed into tree
+	int n;
+	int max;
+	int total;
+	bool valid;
+	QListViewItem ** dirty;		// children whose height changed
+	int ndirty;
+    };
+
+    // for sorting
+    struct SortableItem {
+	char * key;			// owned by SortCache
 	QListViewItem * i;
     };
 
+    // the keys of the last sort, kept so that new children can be
+    // merged in without asking the old ones for their keys again
+    class SortCache {
+      public:
+	SortCache(): items( 0 ), n( 0 ) {}
+	~SortCache() {
+	    for( int i=0; i<n; i++ )
+		delete[] items[i].key;
+	    delete[] items;
+	}
+	SortableItem * items;		// in ascending key order
+	int n;
+	int column;
+	bool ascending;
+    };
+
     class ItemColumnInfo {
       public:
 	ItemColumnInfo(): text( 0 ), pm( 0 ), next( 0 ) {}
@@ -440,6 +481,9 @@ void QListViewItem::init()
     siblingItem = childItem = 0;
 
     columns = 0;
+    childIndex = 0;
+    indexPos = 0;
+    sortCache = 0;
 
     selected = 0;
 
@@ -449,6 +493,8 @@ void QListViewItem::init()
     expandable = FALSE;
     selectable = TRUE;
     is_root = FALSE;
+    populated = FALSE;
+    keyCached = FALSE;
 }
 
 
@@ -458,12 +504,14 @@ void QListViewItem::init()
 
 QListViewItem::~QListViewItem()
 {
+    discardSortCache();
     while ( childItem ) {
 	QListViewItem *nextChild = childItem->siblingItem;
 	delete childItem;
 	childItem = nextChild;
     }
     delete (QListViewPrivate::ItemColumnInfo *)columns;
+    delete (QListViewPrivate::ChildIndex *)childIndex;
     if ( parentItem )
 	parentItem->removeItem( this );
 }
@@ -476,6 +524,7 @@ QListViewItem::~QListViewItem()
 void QListViewItem::insertItem( QListViewItem * newChild )
 {
     invalidateHeight();
+    invalidateChildIndex();
     newChild->siblingItem = childItem;
     childItem = newChild;
     nChildren++;
@@ -483,6 +532,7 @@ void QListViewItem::insertItem( QListViewItem * newChild )
     lsc = Unsorted;
     newChild->ownHeight = 0;
     newChild->configured = FALSE;
+    newChild->keyCached = FALSE;
 }
 
 
@@ -516,7 +566,10 @@ void QListViewItem::removeItem( QListViewItem * tbg )
 	    lv->d->focusItem = 0;
     }
 
+    if ( tbg->keyCached )
+	discardSortCache();
     nChildren--;
+    invalidateChildIndex();
 
     QListViewItem ** nextChild = &childItem;
     while( nextChild && *nextChild && tbg != *nextChild )
@@ -539,6 +592,12 @@ void QListViewItem::removeItem( QListViewItem * tbg )
   QListViewItem immediately copies the return value of this function,
   so it's safe to return a pointer to a static variable.
 
+  The keys of sorted children are remembered, so that items inserted
+  later can be merged into place without asking every sibling for its
+  key again.  setText() forgets the remembered key.  If your key()
+  depends on other data, call invalidateSortCache() whenever that data
+  changes, or the item keeps its old place in the sort order.
+
   You can use this function to sort by non-alphabetic data.  This code
   excerpt sort by file modification date, for example
 
@@ -580,6 +639,10 @@ static int cmp( const void *n1, const void *n2 )
   but may avoid or defer sorting other objects in order to be more
   responsive.)
 
+  If the children were already sorted by the same column and order,
+  only the children inserted since are asked for their keys, and they
+  are merged into the existing order.
+
   \sa key()
 */
 
@@ -603,21 +666,77 @@ void QListViewItem::sortChildItems( int column, bool ascending )
     if ( childItem == 0 || childItem->siblingItem == 0 )
 	return;
 
-    // make an array we can sort in a thread-safe way using qsort()
+    QListViewPrivate::SortCache * sc
+	= (QListViewPrivate::SortCache *)sortCache;
+    if ( sc && ( sc->column != column || sc->ascending != ascending ) ) {
+	discardSortCache();
+	sc = 0;
+    }
+
     QListViewPrivate::SortableItem * siblings
 	= new QListViewPrivate::SortableItem[nChildren];
     QListViewItem * s = childItem;
     int i = 0;
-    while ( s && i<nChildren ) {
-	siblings[i].key = s->key( column, ascending );
-	siblings[i].i = s;
+
+    // the new children are the ones without a remembered key.
+    // insertItem() puts them first, so this usually stops early.
+    int n = sc ? nChildren - sc->n : 0;
+    QListViewPrivate::SortableItem * added = siblings + nChildren - n;
+    while ( sc && s && i < n ) {
+	if ( !s->keyCached ) {
+	    added[i].key = qstrdup( s->key( column, ascending ) );
+	    added[i].i = s;
+	    i++;
+	}
 	s = s->siblingItem;
-	i++;
+    }
+    if ( sc && i != n ) {
+	while ( i )
+	    delete[] added[--i].key;
+	discardSortCache();
+	sc = 0;
+	i = 0;
+	s = childItem;
     }
 
-    // and do it.
-    qsort( siblings, nChildren,
-	   sizeof( QListViewPrivate::SortableItem ), cmp );
+    if ( sc ) {
+	// the old children are in order already: sort the new ones
+	// and merge them in from the front.  the new ones that are
+	// left over at the end are in place already.
+	qsort( added, n, sizeof( QListViewPrivate::SortableItem ), cmp );
+	for( i=0; i < n; i++ )
+	    added[i].i->keyCached = TRUE;
+	QListViewPrivate::SortableItem * old = sc->items;
+	int o = 0;
+	int a = 0;
+	i = 0;
+	while ( o < sc->n ) {
+	    if ( a < n && qstrcmp( added[a].key, old[o].key ) < 0 )
+		siblings[i++] = added[a++];
+	    else
+		siblings[i++] = old[o++];
+	}
+	delete[] sc->items;
+    } else {
+	// make an array we can sort in a thread-safe way using qsort()
+	while ( s && i<nChildren ) {
+	    siblings[i].key = qstrdup( s->key( column, ascending ) );
+	    siblings[i].i = s;
+	    s->keyCached = TRUE;
+	    s = s->siblingItem;
+	    i++;
+	}
+
+	// and do it.
+	qsort( siblings, nChildren,
+	       sizeof( QListViewPrivate::SortableItem ), cmp );
+
+	sc = new QListViewPrivate::SortCache;
+	CHECK_PTR( sc );
+	sc->column = column;
+	sc->ascending = ascending;
+	sortCache = (void *)sc;
+    }
 
     // build the linked list of siblings, in the appropriate
     // direction, and finally set this->childItem to the new top
@@ -633,9 +752,46 @@ void QListViewItem::sortChildItems( int column, bool ascending )
 	siblings[0].i->siblingItem = 0;
 	childItem = siblings[nChildren-1].i;
     }
+    invalidateChildIndex();
+
+    // keep the keys for the next time
+    sc->items = siblings;
+    sc->n = nChildren;
+}
+
+
+/*!  Tells the item that key() may return something else than it did
+  when the item was last sorted, so that the next sort of its siblings
+  asks all of them for their keys again.
+
+  setText() calls this.  Reimplementations of key() that depend on
+  other data must call it when that data changes.
+
+  \sa key(), sortChildItems()
+*/
+
+void QListViewItem::invalidateSortCache()
+{
+    if ( keyCached && parentItem )
+	parentItem->discardSortCache();
+}
 
-    // we don't want no steenking memory leaks.
-    delete[] siblings;
+
+/*!  \internal
+  Forgets the keys of the children remembered by the last
+  sortChildItems().
+*/
+
+void QListViewItem::discardSortCache()
+{
+    QListViewPrivate::SortCache * sc
+	= (QListViewPrivate::SortCache *)sortCache;
+    if ( !sc )
+	return;
+    for( int i=0; i < sc->n; i++ )
+	sc->items[i].i->keyCached = FALSE;
+    delete sc;
+    sortCache = 0;
 }
 
 
@@ -668,7 +824,13 @@ void QListViewItem::invalidateHeight()
     if ( maybeTotalHeight < 0 )
 	return;
     maybeTotalHeight = -1;
-    if ( parentItem && parentItem->isOpen() )
+    if ( !parentItem )
+	return;
+    QListViewPrivate::ChildIndex * ci
+	= (QListViewPrivate::ChildIndex *)parentItem->childIndex;
+    if ( ci && ci->valid )
+	ci->markDirty( this );
+    if ( parentItem->isOpen() )
 	parentItem->invalidateHeight();
 }
 
@@ -677,7 +839,8 @@ void QListViewItem::invalidateHeight()
   TRUE, and to be closed (its children are not visible) if \a o is
   FALSE.
 
-  Also does some bookeeping.
+  Also does some bookeeping.  The first time the item is opened,
+  populate() is called to create its children.
 
   \sa ownHeight() totalHeight()
 */
@@ -686,6 +849,10 @@ void QListViewItem::setOpen( bool o )
 {
     if ( o == (bool)open )
 	return;
+    if ( o && !populated ) {
+	populated = TRUE;
+	populate();
+    }
     open = o;
 
     if ( !nChildren )
@@ -751,6 +918,24 @@ void QListViewItem::activate()
 {
 }
 
+
+/*!
+  This virtual function is called the first time the item is opened,
+  just before its children become visible.  The default implementation
+  does nothing.
+
+  Reimplement it to create the children of an item only when the user
+  wants to see them, and call setExpandable( TRUE ) so that the item
+  can be opened before it has children.  Sorting is done once all the
+  children have been inserted.
+
+  \sa setOpen() setExpandable()
+*/
+
+void QListViewItem::populate()
+{
+}
+
 /*! \fn bool QListViewItem::isSelectable() const
 
   Returns TRUE if the item is selectable (as it is by default) and
@@ -785,7 +970,7 @@ void QListViewItem::setSelectable( bool enable )
 
   The dirview example uses this in the canonical fashion: It checks
   whether the directory is empty in setup() and calls
-  setExpandable(TRUE) if not, and in setOpen() it reads the contents
+  setExpandable(TRUE) if not, and in populate() it reads the contents
   of the directory and inserts items accordingly.  This strategy means
   that dirview can display the entire file system without reading very
   much at start-up.
@@ -874,12 +1059,206 @@ int QListViewItem::totalHeight() const
     if ( !that->isOpen() || !that->childCount() )
 	return that->ownHeight;
 
-    QListViewItem * child = that->childItem;
+    that->maybeTotalHeight += childrenHeight();
+    return that->maybeTotalHeight;
+}
+
+
+/*
+  Items with many children keep an index of them, so that the child at
+  a given y offset and the offset of a given child can be found in
+  logarithmic time.  The index is built when it is first needed,
+  rebuilt after children are added, removed or reordered, and updated
+  in place when the total height of a child changes.
+*/
+
+static const int indexThreshold = 32;		// fewer children are walked
+
+void QListViewPrivate::ChildIndex::resize( int size )
+{
+    if ( size <= max )
+	return;
+    delete[] items;
+    delete[] tree;
+    delete[] heights;
+    delete[] dirty;
+    max = size + size/4;
+    items = new QListViewItem*[max];
+    tree = new int[max+1];
+    heights = new int[max];
+    dirty = new QListViewItem*[max/4 + 8];
+    CHECK_PTR( items );
+    CHECK_PTR( tree );
+    CHECK_PTR( heights );
+    CHECK_PTR( dirty );
+}
+
+void QListViewPrivate::ChildIndex::buildTree()
+{
+    int k;
+    total = 0;
+    tree[0] = 0;
+    for( k=1; k<=n; k++ ) {
+	tree[k] = heights[k-1];
+	total += heights[k-1];
+    }
+    for( k=1; k<=n; k++ ) {
+	int j = k + (k & -k);
+	if ( j <= n )
+	    tree[j] += tree[k];
+    }
+}
+
+void QListViewPrivate::ChildIndex::add( int k, int delta )
+{
+    total += delta;
+    for( k++; k <= n; k += k & -k )
+	tree[k] += delta;
+}
+
+/*  Returns the sum of the heights of the first \a k children. */
+
+int QListViewPrivate::ChildIndex::prefix( int k ) const
+{
+    int sum = 0;
+    for( ; k > 0; k -= k & -k )
+	sum += tree[k];
+    return sum;
+}
+
+/*  Returns the number of leading children whose heights add up to at
+  most \a y, i.e. the position of the child that covers \a y. */
+
+int QListViewPrivate::ChildIndex::find( int y ) const
+{
+    int bit = 1;
+    while ( bit*2 <= n )
+	bit *= 2;
+    int m = 0;
+    for( ; bit; bit /= 2 ) {
+	if ( m + bit <= n && tree[m+bit] <= y ) {
+	    m += bit;
+	    y -= tree[m];
+	}
+    }
+    return m;
+}
+
+void QListViewPrivate::ChildIndex::markDirty( QListViewItem * i )
+{
+    if ( ndirty < max/4 + 8 )
+	dirty[ndirty++] = i;
+    else
+	valid = FALSE;				// cheaper to rebuild
+}
+
+
+/*  Makes sure the child index is up to date, if this item has enough
+  children to have one.  Returns TRUE if it has. */
+
+bool QListViewItem::indexChildren() const
+{
+    if ( nChildren < indexThreshold )
+	return FALSE;
+    QListViewItem * that = (QListViewItem *)this;
+    QListViewPrivate::ChildIndex * ci
+	= (QListViewPrivate::ChildIndex *)childIndex;
+    if ( !ci ) {
+	ci = new QListViewPrivate::ChildIndex;
+	CHECK_PTR( ci );
+	that->childIndex = ci;
+    }
+    while ( ci->valid && ci->ndirty ) {
+	QListViewItem * i = ci->dirty[--ci->ndirty];
+	int h = i->totalHeight();
+	if ( ci->valid && h != ci->heights[i->indexPos] ) {
+	    ci->add( i->indexPos, h - ci->heights[i->indexPos] );
+	    ci->heights[i->indexPos] = h;
+	}
+    }
+    if ( !ci->valid ) {
+	ci->resize( nChildren );
+	ci->n = 0;
+	ci->ndirty = 0;
+	QListViewItem * i = childItem;
+	while ( i && ci->n < nChildren ) {
+	    i->indexPos = ci->n;
+	    ci->items[ci->n] = i;
+	    ci->heights[ci->n++] = i->totalHeight();
+	    i = i->siblingItem;
+	}
+	ci->buildTree();
+	ci->ndirty = 0;				// heights are all fresh
+	ci->valid = TRUE;
+    }
+    return TRUE;
+}
+
+
+/*  Forgets the positions of the children, after they have been added,
+  removed or reordered. */
+
+void QListViewItem::invalidateChildIndex()
+{
+    if ( childIndex )
+	((QListViewPrivate::ChildIndex *)childIndex)->valid = FALSE;
+}
+
+
+/*  Returns the sum of the total heights of all children. */
+
+int QListViewItem::childrenHeight() const
+{
+    if ( indexChildren() )
+	return ((QListViewPrivate::ChildIndex *)childIndex)->total;
+    int h = 0;
+    QListViewItem * child = childItem;
     while ( child != 0 ) {
-	that->maybeTotalHeight += child->totalHeight();
+	h += child->totalHeight();
 	child = child->siblingItem;
     }
-    return that->maybeTotalHeight;
+    return h;
+}
+
+
+/*  Returns the first child whose subtree extends below offset \a y,
+  counted from the top of the first child, and stores the offset of
+  its top in \a top.  Returns 0 if there is no such child. */
+
+QListViewItem * QListViewItem::childAt( int y, int * top ) const
+{
+    if ( indexChildren() ) {
+	QListViewPrivate::ChildIndex * ci
+	    = (QListViewPrivate::ChildIndex *)childIndex;
+	int k = ci->find( y );
+	*top = k ? ci->prefix( k ) : 0;
+	return k < ci->n ? ci->items[k] : 0;
+    }
+    int t = 0;
+    QListViewItem * c = childItem;
+    while ( c && t + c->totalHeight() <= y ) {
+	t += c->totalHeight();
+	c = c->siblingItem;
+    }
+    *top = t;
+    return c;
+}
+
+
+/*  Returns the offset of \a child from the top of the first child. */
+
+int QListViewItem::childPos( const QListViewItem * child ) const
+{
+    if ( indexChildren() && child->parentItem == this )
+	return ((QListViewPrivate::ChildIndex *)childIndex)->prefix(
+	    child->indexPos );
+    int a = 0;
+    QListViewItem * s = childItem;
+    while( s && s != child ) {
+	a += s->totalHeight();
+	s = s->siblingItem;
+    }
+    return a;
 }
 
 
@@ -934,6 +1313,7 @@ void QListViewItem::setText( int column, const char * text )
     if ( l->text )
 	delete[] l->text;
     l->text = qstrdup( text );
+    invalidateSortCache();
     repaint();
 }
 
@@ -1120,11 +1500,15 @@ void QListViewItem::paintBranches( QPainter * p, const QColorGroup & cg,
 
     int dotoffset = (itemPos() + height() - y) %2;
 
-    // each branch needs at most two lines, ie. four end points
-    QPointArray dotlines( childCount() * 4 );
+    // each branch needs at most two lines, ie. four end points; only
+    // the children in the exposed rectangle are drawn
+    QPointArray dotlines( QMIN( childCount(), 64 ) * 4 + 2 );
     int c = 0;
 
     // skip the stuff above the exposed rectangle
+    int top;
+    child = childAt( -y, &top );
+    y += top;
     while ( child && y + child->height() <= 0 ) {
 	y += child->totalHeight();
 	child = child->nextSibling();
@@ -1134,6 +1518,8 @@ void QListViewItem::paintBranches( QPainter * p, const QColorGroup & cg,
 
     // paint stuff in the magical area
     while ( child && y < h ) {
+	if ( c + 6 > (int)dotlines.size() )
+	    dotlines.resize( dotlines.size()*2 + 6 );
 	linebot = y + child->height()/2;
 	if ( child->expandable || child->childCount() ) {
 	    // needs a box
@@ -1711,16 +2097,13 @@ void QListView::buildDrawableList() const
 	     cur->y + ih < cy + ch ) {
 	    cur->i->enforceSortOrder();
 
-	    QListViewItem * c = cur->i->childItem;
-	    int y = cur->y + ih;
-
 	    // if any of the children are not to be painted, skip them
 	    // and invalidate topPixel
-	    while ( c && y + c->totalHeight() <= cy ) {
-		y += c->totalHeight();
-		c = c->siblingItem;
+	    int top;
+	    QListViewItem * c = cur->i->childAt( cy - cur->y - ih, &top );
+	    int y = cur->y + ih + top;
+	    if ( c != cur->i->childItem )
 		d->topPixel = cy + ch;
-	    }
 
 	    // push one child on the stack, if there is at least one
 	    // needing to be painted
@@ -3831,6 +4214,7 @@ void QListViewItem::moveToJustAfter( QListViewItem * olderSibling )
 	}
 	siblingItem = olderSibling->siblingItem;
 	olderSibling->siblingItem = this;
+	parentItem->invalidateChildIndex();
     }
 }
 
@@ -3861,12 +4245,7 @@ int QListViewItem::itemPos() const
 		p->configured = TRUE;
 		p->setup(); // ### virtual non-const function called in const
 	    }
-	    a += p->height();
-	    QListViewItem * s = p->firstChild();
-	    while( s && s != i ) {
-		a += s->totalHeight();
-		s = s->nextSibling();
-	    }
+	    a += p->height() + p->childPos( i );
 	}
 	p = i;
     }
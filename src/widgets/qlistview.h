@@ -128,10 +128,19 @@ protected:
     virtual void enforceSortOrder() const;
     virtual void setHeight( int );
     virtual void activate();
+    virtual void populate();
+
+    void invalidateSortCache();
 
 private:
     void init();
     void moveToJustAfter( QListViewItem * );
+    bool indexChildren() const;
+    void invalidateChildIndex();
+    int childrenHeight() const;
+    QListViewItem * childAt( int, int * ) const;
+    int childPos( const QListViewItem * ) const;
+    void discardSortCache();
     int ownHeight;
     int maybeTotalHeight;
     int nChildren;
@@ -144,12 +153,17 @@ private:
     uint configured: 1;
     uint expandable: 1;
     uint is_root: 1;
+    uint populated: 1;
+    uint keyCached: 1;
 
     QListViewItem * parentItem;
     QListViewItem * siblingItem;
     QListViewItem * childItem;
 
     void * columns;
+    void * childIndex;
+    int indexPos;
+    void * sortCache;
 
     friend class QListView;
 };
@@ -55,13 +55,257 @@
 
 struct QMultiLineData
 {
-    QMultiLineData() :isHandlingEvent(FALSE), maxLineWidth(0), timer(0) {}
+    QMultiLineData() :isHandlingEvent(FALSE), maxLineWidth(0), timer(0),
+		      metricsValid(FALSE) {}
     ~QMultiLineData() { delete timer; }
     bool isHandlingEvent;
     int maxLineWidth;
     QTimer *timer;
+
+    // font() metrics for textWidth()
+    bool metricsValid;
+    int leftBearing;
+    int tabDist;
+    int charWidth[256];
+};
+
+
+/*
+  The lines of a QMultiLineEdit, kept in a gap buffer so that any line
+  can be reached directly and typing or inserting text at one place
+  only moves the lines between the gap and that place.
+
+  Each line remembers its width in pixels, or -1 if it has changed
+  since it was last measured.  Together with the number of lines that
+  are as wide as the widest one, this lets updateCellWidth() find the
+  widest line by measuring only the lines that have changed.
+*/
+
+struct QMultiLineLine
+{
+    QString *s;
+    int w;
 };
 
+class QMultiLineText
+{
+public:
+    QMultiLineText();
+   ~QMultiLineText();
+
+    int count() const { return n; }
+    bool isEmpty() const { return n == 0; }
+    QString *at( int i ) const { return i < 0 || i >= n ? 0 : line( i ).s; }
+    int width( int i ) const { return line( i ).w; }
+
+    void reserve( int i, int extra );
+    void insert( int i, QString *s, int w );
+    bool remove( int i );
+    void clear();
+
+    void setWidth( int i, int w );
+    void changed( int i );
+    void changedAll();
+    void findWidest();
+
+    int widest;				// widest line seen
+    int nWidest;			// lines that wide; 0 if unknown
+    int stale[8];			// lines to measure
+    int nStale;				// -1 if more than 8
+
+private:
+    QMultiLineLine &line( int i ) const
+	{ return buf[i < gap ? i : i + gapLen]; }
+    void moveGap( int i );
+    void addStale( int i );
+
+    QMultiLineLine *buf;
+    int size;
+    int gap;
+    int gapLen;
+    int n;
+};
+
+QMultiLineText::QMultiLineText()
+    : widest( 0 ), nWidest( 0 ), nStale( 0 ),
+      buf( 0 ), size( 0 ), gap( 0 ), gapLen( 0 ), n( 0 )
+{
+}
+
+QMultiLineText::~QMultiLineText()
+{
+    clear();
+    delete [] buf;
+}
+
+void QMultiLineText::moveGap( int i )
+{
+    if ( i < gap )
+	memmove( buf + i + gapLen, buf + i,
+		 (gap - i) * sizeof(QMultiLineLine) );
+    else if ( i > gap )
+	memmove( buf + gap, buf + gap + gapLen,
+		 (i - gap) * sizeof(QMultiLineLine) );
+    gap = i;
+}
+
+/*
+  Moves the gap to line \a i and makes sure \a extra lines can be
+  inserted there without reallocating.
+*/
+
+void QMultiLineText::reserve( int i, int extra )
+{
+    moveGap( i );
+    if ( gapLen >= extra )
+	return;
+    int newSize = QMAX( size*2, n + extra + 16 );
+    QMultiLineLine *b = new QMultiLineLine[newSize];
+    CHECK_PTR( b );
+    int tail = n - gap;
+    if ( buf ) {
+	memcpy( b, buf, gap * sizeof(QMultiLineLine) );
+	memcpy( b + newSize - tail, buf + gap + gapLen,
+		tail * sizeof(QMultiLineLine) );
+	delete [] buf;
+    }
+    buf = b;
+    gapLen = newSize - n;
+    size = newSize;
+}
+
+/*
+  Inserts \a s as line \a i, which is \a w pixels wide or -1 if it
+  has not been measured.
+*/
+
+void QMultiLineText::insert( int i, QString *s, int w )
+{
+    reserve( i, 1 );
+    buf[gap].s = s;
+    buf[gap].w = -1;
+    gap++;
+    gapLen--;
+    n++;
+    for( int j = 0; j < nStale; j++ )
+	if ( stale[j] >= i )
+	    stale[j]++;
+    if ( w >= 0 )
+	setWidth( i, w );
+    else
+	addStale( i );
+}
+
+/*
+  Deletes line \a i.  Returns FALSE if there is no such line.
+*/
+
+bool QMultiLineText::remove( int i )
+{
+    if ( i < 0 || i >= n )
+	return FALSE;
+    moveGap( i );
+    QMultiLineLine &l = buf[gap + gapLen];
+    if ( l.w >= 0 && l.w == widest )
+	nWidest--;
+    delete l.s;
+    gapLen++;
+    n--;
+    int k = 0;
+    for( int j = 0; j < nStale; j++ ) {
+	if ( stale[j] != i )
+	    stale[k++] = stale[j] > i ? stale[j] - 1 : stale[j];
+    }
+    if ( nStale > 0 )
+	nStale = k;
+    return TRUE;
+}
+
+void QMultiLineText::clear()
+{
+    for( int i = 0; i < n; i++ )
+	delete line( i ).s;
+    n = 0;
+    gap = 0;
+    gapLen = size;
+    widest = 0;
+    nWidest = 0;
+    nStale = 0;
+}
+
+void QMultiLineText::setWidth( int i, int w )
+{
+    QMultiLineLine &l = line( i );
+    if ( l.w >= 0 && l.w == widest )
+	nWidest--;
+    l.w = w;
+    if ( w > widest ) {
+	widest = w;
+	nWidest = 1;
+    } else if ( w == widest ) {
+	nWidest++;
+    }
+}
+
+void QMultiLineText::addStale( int i )
+{
+    if ( nStale < 0 )
+	return;
+    for( int j = 0; j < nStale; j++ )
+	if ( stale[j] == i )
+	    return;
+    if ( nStale < (int)(sizeof(stale)/sizeof(int)) )
+	stale[nStale++] = i;
+    else
+	nStale = -1;
+}
+
+/*
+  Line \a i has changed and must be measured again.
+*/
+
+void QMultiLineText::changed( int i )
+{
+    if ( i < 0 || i >= n )
+	return;
+    QMultiLineLine &l = line( i );
+    if ( l.w < 0 )
+	return;
+    if ( l.w == widest )
+	nWidest--;
+    l.w = -1;
+    addStale( i );
+}
+
+void QMultiLineText::changedAll()
+{
+    for( int i = 0; i < n; i++ )
+	line( i ).w = -1;
+    widest = 0;
+    nWidest = 0;
+    nStale = -1;
+}
+
+/*
+  Finds the widest line again after the widest one got narrower or
+  went away.  All lines must have been measured.
+*/
+
+void QMultiLineText::findWidest()
+{
+    widest = 0;
+    nWidest = 0;
+    for( int i = 0; i < n; i++ ) {
+	int w = line( i ).w;
+	if ( w > widest ) {
+	    widest = w;
+	    nWidest = 1;
+	} else if ( w == widest ) {
+	    nWidest++;
+	}
+    }
+}
+
 static const int BORDER = 3;
 
 static const int blinkTime  = 500;		// text cursor blink time
@@ -156,8 +400,7 @@ QMultiLineEdit::QMultiLineEdit( QWidget *parent , const char *name )
 
     setNumRows( 0 );
     setWidth( 1 ); // ### constant width
-    contents = new QList<QString>;
-    contents->setAutoDelete( TRUE );
+    contents = new QMultiLineText;
 
     cursorX = 0; cursorY = 0;
     curXPos = 0;
@@ -192,18 +435,27 @@ QMultiLineEdit::QMultiLineEdit( QWidget *parent , const char *name )
     scrollTimer    = 0;
 }
 
-/*! \fn int QMultiLineEdit::numLines() const
-
+/*!
   Returns the number of lines in the editor. The count includes any
   empty lines at top and bottom, so for an empty editor this method
   will return 1.
 */
 
-/*! \fn bool QMultiLineEdit::atEnd() const
+int QMultiLineEdit::numLines() const
+{
+    return contents->count();
+}
 
+/*!
   Returns TRUE if the cursor is placed at the end of the text.
 */
 
+bool QMultiLineEdit::atEnd() const
+{
+    return cursorY == (int)contents->count() - 1
+	&& cursorX == lineLength( cursorY ) ;
+}
+
 /*! \fn bool QMultiLineEdit::atBeginning() const
 
   Returns TRUE if the cursor is placed at the beginning of the text.
@@ -211,15 +463,27 @@ QMultiLineEdit::QMultiLineEdit( QWidget *parent , const char *name )
 
 
 /*!
-  \fn int QMultiLineEdit::lineLength( int line ) const
   Returns the number of characters at line number \a line.
 */
 
-/*! \fn QString *QMultiLineEdit::getString( int line ) const
+int QMultiLineEdit::lineLength( int line ) const
+{
+    return contents->at( line )->length();
+}
 
+/*!
   Returns a pointer to the text at line \a line.
+
+  The line is assumed to be changed through the pointer and will be
+  measured again the next time the width of the text is needed.
 */
 
+QString *QMultiLineEdit::getString( int line ) const
+{
+    contents->changed( line );
+    return contents->at( line );
+}
+
 /*! \fn void QMultiLineEdit::textChanged()
 
   This signal is emitted when the text is changed by an event or by a
@@ -438,11 +702,31 @@ void QMultiLineEdit::paintCell( QPainter *painter, int row, int )
 
 int QMultiLineEdit::textWidth( QString *s )
 {
-    int w;
-    if ( s )
-	w = textWidthWithTabs( QFontMetrics( font() ), *s, -1 );
-    else
-	w = 0;
+    int w = 0;
+    if ( s && s->data() ) {
+	// same as textWidthWithTabs(), with the widths looked up
+	QMultiLineData *d = mlData;
+	if ( !d->metricsValid ) {
+	    QFontMetrics fm( font() );
+	    d->leftBearing = -fm.minLeftBearing();
+	    d->tabDist = tabStopDist( fm );
+	    d->charWidth[0] = 0;
+	    for( int c = 1; c < 256; c++ ) {
+		char ch = (char)c;
+		d->charWidth[c] = fm.width( &ch, 1 );
+	    }
+	    d->metricsValid = TRUE;
+	}
+	register const uchar *p = (const uchar *)s->data();
+	w = d->leftBearing;
+	while ( *p ) {
+	    if ( *p == '\t' )
+		w = ( w/d->tabDist + 1 ) * d->tabDist;
+	    else
+		w += d->charWidth[*p];
+	    p++;
+	}
+    }
     return w + 2 * BORDER;
 }
 
@@ -453,7 +737,6 @@ int QMultiLineEdit::textWidth( QString *s )
 
 int QMultiLineEdit::textWidth( int line )
 {
-    //possibilities of caching...
     QString *s = contents->at( line );
     if ( !s ) {
 	warning( "QMultiLineEdit::textWidth: (%s) "
@@ -461,7 +744,12 @@ int QMultiLineEdit::textWidth( int line )
 		 name( "unnamed" ), line );
 	return 0;
     }
-    return textWidth( s );
+    int w = contents->width( line );
+    if ( w < 0 ) {
+	w = textWidth( s );
+	contents->setWidth( line, w );
+    }
+    return w;
 }
 
 
@@ -594,7 +882,7 @@ QString QMultiLineEdit::markedText() const
     if ( !getMarkedRegion( &markBeginY, &markBeginX, &markEndY, &markEndX ) )
 	return QString();
     if ( markBeginY == markEndY ) { //just one line
-	QString *s  = getString( markBeginY );
+	QString *s  = contents->at( markBeginY );
 	ASSERT(s);
 	return s->mid( markBeginX, markEndX - markBeginX );
     } else { //multiline
@@ -602,8 +890,8 @@ QString QMultiLineEdit::markedText() const
 	ASSERT( markEndY < (int)contents->count() );
 	
 	QString *firstS, *lastS;
-	firstS = getString( markBeginY );
-	lastS  = getString( markEndY );
+	firstS = contents->at( markBeginY );
+	lastS  = contents->at( markEndY );
 	ASSERT( firstS != lastS );
 
 	int len = firstS->length() - markBeginX + 1;
@@ -1102,6 +1390,7 @@ void QMultiLineEdit::insertAt( const char *txt, int line, int col )
     if ( !p ) { //single line
 	oldLine->insert( col, *textLine );
 	int w = textWidth( oldLine );
+	contents->setWidth( line, w );
 	setWidth( QMAX( maxLineWidth(), w ) );
 	if ( onLineAfter )
 	    cursorX += textLine->length();
@@ -1112,13 +1401,16 @@ void QMultiLineEdit::insertAt( const char *txt, int line, int col )
 	if ( onLineAfter )
 	    cursorX -= oldLine->length();
 	*oldLine += *textLine;
-	w = QMAX( textWidth( oldLine ), w );
+	int tw = textWidth( oldLine );
+	contents->setWidth( line, tw );
+	w = QMAX( tw, w );
 	line++;
 	cursorY++;
 	while (( p = getOneLine( p, &textLine ) )) {
 	    ASSERT ( textLine );
-	    contents->insert( line++, textLine );
-	    w = QMAX( textWidth( textLine ), w );
+	    tw = textWidth( textLine );
+	    contents->insert( line++, textLine, tw );
+	    w = QMAX( tw, w );
 	    if ( cursorAfter )
 		cursorY++;
 	}
@@ -1148,8 +1440,8 @@ void QMultiLineEdit::insertLine( const char *txt, int line )
 {
     bool u = autoUpdate();
     setAutoUpdate( FALSE );
-    if ( dummy && numLines() == 1 && getString( 0 )->isEmpty() ) {
-	contents->remove( (uint)0 );
+    if ( dummy && numLines() == 1 && contents->at( 0 )->isEmpty() ) {
+	contents->remove( 0 );
 	//debug ("insertLine: removing dummy, %d", count() );
 	dummy = FALSE;
     }
@@ -1158,11 +1450,19 @@ void QMultiLineEdit::insertLine( const char *txt, int line )
     QString *textLine;
     int w = maxLineWidth();
     const char *p = txt;
+    int n = 1;
+    while ( p && (p = strchr( p, '\n' )) ) {
+	p++;
+	n++;
+    }
+    contents->reserve( line, n );
+    p = txt;
     do {
 	p = getOneLine( p, &textLine );
 	ASSERT ( textLine );
-	contents->insert( line++, textLine );
-	w = QMAX( textWidth( textLine ), w );
+	int tw = textWidth( textLine );
+	contents->insert( line++, textLine, tw );
+	w = QMAX( tw, w );
     } while ( p );
     mlData->maxLineWidth = w;
 	
@@ -1240,6 +1540,7 @@ void QMultiLineEdit::insertChar( char c )
 	del();                                 // ## Will flicker
     s->insert( cursorX, c);
     int w = textWidth( s );
+    contents->setWidth( cursorY, w );
     setWidth( QMAX( maxLineWidth(), w ) );
     cursorRight( FALSE );			// will repaint
     curXPos  = 0;
@@ -1532,8 +1833,9 @@ void QMultiLineEdit::del()
 	    textDirty = TRUE;
 	    QString *s = getString( cursorY );
 	    if ( cursorX == (int) s->length() ) { // remove newline
-		*s += *getString( cursorY + 1 );
+		*s += *contents->at( cursorY + 1 );
 		int w = textWidth( s );
+		contents->setWidth( cursorY, w );
 		setWidth( QMAX( maxLineWidth(), w ) );
 		removeLine( cursorY + 1 );
 	    } else {
@@ -1637,7 +1939,7 @@ void QMultiLineEdit::mousePressEvent( QMouseEvent *m )
 	newY = lastRowVisible();
     newY = QMIN( (int)contents->count() - 1, newY );
     QFontMetrics fm( font() );
-    cursorX = xPosToCursorPos( *getString( newY ), fm,
+    cursorX = xPosToCursorPos( *contents->at( newY ), fm,
 			       m->pos().x() - BORDER + xOffset(),
 			       cellWidth() - 2 * BORDER );
     if ( m->button() ==  LeftButton ) {
@@ -1706,7 +2008,7 @@ void QMultiLineEdit::mouseMoveEvent( QMouseEvent *e )
     }
     newY = QMIN( (int)contents->count() - 1, newY );
     QFontMetrics fm( font() );
-    QString *s = getString( newY );
+    QString *s = contents->at( newY );
     int newX = xPosToCursorPos( *s, fm,
 				e->pos().x() - BORDER + xOffset(),
 				cellWidth() - 2 * BORDER );
@@ -1832,7 +2134,7 @@ void QMultiLineEdit::makeVisible()
 
 int QMultiLineEdit::mapFromView( int xPos, int line )
 {
-    QString *s = getString( line );
+    QString *s = contents->at( line );
     if ( !s )
 	return 0;
     QFontMetrics fm( font() );
@@ -1849,7 +2151,7 @@ int QMultiLineEdit::mapFromView( int xPos, int line )
 
 int QMultiLineEdit::mapToView( int xIndex, int line )
 {
-    QString *s = getString( line );
+    QString *s = contents->at( line );
     ASSERT( s );
     xIndex = QMIN( (int)s->length(), xIndex );
     QFontMetrics fm( font() );
@@ -1857,22 +2159,27 @@ int QMultiLineEdit::mapToView( int xIndex, int line )
 }
 
 /*!
-  Traverses the list and finds an item with the maximum width, and
-  updates the internal structures accordingly.
+  Finds the line with the maximum width, and updates the internal
+  structures accordingly.  Only lines that have changed since they
+  were last measured are measured again.
 */
 
 void QMultiLineEdit::updateCellWidth()
 {
-    QString *s = contents->first();
-    int maxW = 0;
-    int w;
-    while ( s ) {
-	w = textWidth( s );
-	if ( w > maxW )
-	    maxW = w;
-	s = contents->next();
+    QMultiLineText *t = contents;
+    int i;
+    if ( t->nStale < 0 ) {
+	for( i = 0; i < t->count(); i++ )
+	    if ( t->width( i ) < 0 )
+		t->setWidth( i, textWidth( t->at( i ) ) );
+    } else {
+	for( i = 0; i < t->nStale; i++ )
+	    t->setWidth( t->stale[i], textWidth( t->at( t->stale[i] ) ) );
     }
-    setWidth( maxW );
+    t->nStale = 0;
+    if ( t->nWidest == 0 )
+	t->findWidest();
+    setWidth( t->widest );
 }
 
 
@@ -1932,9 +2239,7 @@ void QMultiLineEdit::clear()
 {
     bool u = autoUpdate();
     setAutoUpdate( FALSE );
-    contents->first();
-    while ( contents->remove() )
-	;
+    contents->clear();
     cursorX = cursorY = 0;
     setWidth( 1 );
     insertLine( "", -1 );
@@ -1957,6 +2262,8 @@ void QMultiLineEdit::setFont( const QFont &font )
     QWidget::setFont( font );
     QFontMetrics fm( font );
     setCellHeight( fm.lineSpacing() + 1 );
+    mlData->metricsValid = FALSE;
+    contents->changedAll();
     updateCellWidth();
 }
 
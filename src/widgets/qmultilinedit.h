@@ -31,6 +31,7 @@
 #endif // QT_H
 
 struct QMultiLineData;
+class QMultiLineText;
 
 class Q_EXPORT QMultiLineEdit : public QTableView
 {
@@ -127,7 +128,7 @@ private slots:
     void clipboardChanged();
     void repaintAll();
 private:
-    QList<QString> *contents;
+    QMultiLineText *contents;
     QMultiLineData *mlData;
 
     bool	readOnly;
@@ -182,29 +183,8 @@ inline void QMultiLineEdit::setOverwriteMode( bool on )
     overWrite = on;
  }
 
-inline int QMultiLineEdit::lineLength( int row ) const
-{
-    return contents->at( row )->length();
-}
-
-inline bool QMultiLineEdit::atEnd() const
-{
-    return cursorY == (int)contents->count() - 1
-	&& cursorX == lineLength( cursorY ) ;
-}
-
 inline bool QMultiLineEdit::atBeginning() const
 {
     return cursorY == 0 && cursorX == 0;
 }
-
-inline QString *QMultiLineEdit::getString( int row ) const
-{
-    return contents->at( row );
-}
-
-inline int QMultiLineEdit::numLines() const
-{
-    return contents->count();
-}
 #endif // QMULTILINED_H
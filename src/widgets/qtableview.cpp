@@ -25,7 +25,9 @@
 #include "qscrollbar.h"
 #include "qpainter.h"
 #include "qdrawutil.h"
+#include "qptrdict.h"
 #include <limits.h>
+#include <string.h>
 
 const int sbDim = 16;
 
@@ -60,6 +62,133 @@ void CornerSquare::paintEvent( QPaintEvent * )
 }
 
 
+/*
+  QTableViewIndex holds the running sums of variable cell sizes along
+  one axis as a Fenwick tree: tree[i] is the total size of the cells
+  i - (i & -i) to i - 1.  This maps table coordinates to cells and back
+  in O(log n) without calling cellWidth()/cellHeight() for every cell.
+*/
+
+struct QTableViewIndex
+{
+    QTableViewIndex() : tree(0), n(0), max(0) {}
+   ~QTableViewIndex() { delete [] tree; }
+
+    void	append( int size );
+    void	add( int cell, int delta );
+    int		pos( int cell ) const;
+    int		find( int p ) const;
+
+    int	       *tree;				// 1-based
+    int		n;				// number of cells indexed
+    int		max;				// allocated size of tree
+};
+
+struct QTableViewSizes
+{
+    QTableViewIndex cols;
+    QTableViewIndex rows;
+};
+
+/*
+  Adds one cell of the given size at the end.
+*/
+
+void QTableViewIndex::append( int size )
+{
+    if ( n + 1 >= max ) {
+	int newMax = QMAX( 2*max, 64 );
+	int *t = new int[newMax];
+	CHECK_PTR( t );
+	if ( tree )
+	    memcpy( t, tree, (n+1)*sizeof(int) );
+	delete [] tree;
+	tree = t;
+	max = newMax;
+    }
+    int i = ++n;
+    int low = i & -i;
+    for ( int j = 1; j < low; j <<= 1 )		// sum of the covered cells
+	size += tree[i - j];
+    tree[i] = size;
+}
+
+/*
+  Adds \e delta to the size of \e cell.
+*/
+
+void QTableViewIndex::add( int cell, int delta )
+{
+    for ( register int i = cell + 1; i <= n; i += i & -i )
+	tree[i] += delta;
+}
+
+/*
+  Returns the start of \e cell, i.e. the total size of the cells before it.
+*/
+
+int QTableViewIndex::pos( int cell ) const
+{
+    register int p = 0;
+    for ( register int i = QMIN( cell, n ); i > 0; i -= i & -i )
+	p += tree[i];
+    return p;
+}
+
+/*
+  Returns the last cell that starts at or before \e p, or n if \e p is
+  beyond the last cell.	 Cells of size zero are skipped.
+*/
+
+int QTableViewIndex::find( int p ) const
+{
+    int bit = 1;
+    while ( 2*bit <= n )
+	bit <<= 1;
+    register int i = 0;
+    for ( ; n > 0 && bit; bit >>= 1 ) {
+	if ( i + bit <= n && tree[i + bit] <= p ) {
+	    i += bit;
+	    p -= tree[i];
+	}
+    }
+    return i;
+}
+
+
+/*
+  The size indexes are kept in a dictionary keyed on the table view,
+  so that QTableView's layout does not change.
+*/
+
+static QPtrDict<QTableViewSizes> *qtv_sizeDict = 0;
+
+static void cleanupTableView()
+{
+    delete qtv_sizeDict;
+    qtv_sizeDict = 0;
+}
+
+static QTableViewSizes *tableSizes( const QTableView *tv, bool create )
+{
+    if ( !qtv_sizeDict ) {
+	if ( !create )
+	    return 0;
+	qtv_sizeDict = new QPtrDict<QTableViewSizes>;
+	CHECK_PTR( qtv_sizeDict );
+	qtv_sizeDict->setAutoDelete( TRUE );
+	qAddPostRoutine( cleanupTableView );
+    }
+    QTableViewSizes *s = qtv_sizeDict->find( (void *)tv );
+    if ( !s && create ) {
+	s = new QTableViewSizes;
+	CHECK_PTR( s );
+	qtv_sizeDict->insert( (void *)tv, s );
+    }
+    return s;
+}
+
+
 /*!
   \class QTableView qtableview.h
   \brief This is the abstract base class of all the table views.
@@ -77,7 +206,9 @@ void CornerSquare::paintEvent( QPaintEvent * )
   implementation of paintCell().  Subclasses that need cells with
   variable width or height must reimplement cellHeight() and/or
   cellWidth(). Use updateTableSize() to tell QTableView when the
-  width or height has changed.
+  width or height has changed.	Large tables with variable cell sizes
+  should set \c Tbl_cacheCells and report changes to individual cells
+  with cellHeightChanged() and cellWidthChanged().
 
   When you read this documentation, it is important to understand the
   distinctions between the four pixel coordinate systems involved.
@@ -173,6 +304,8 @@ QTableView::~QTableView()
     delete vScrollBar;
     delete hScrollBar;
     delete cornerSquare;
+    if ( qtv_sizeDict )
+	qtv_sizeDict->remove( (void *)this );
 }
 
 
@@ -393,9 +526,14 @@ void QTableView::setTopLeftCell( int row, int col )
 	    if ( newX > maxXOffset() )
 		newX = maxXOffset();
 	} else {
-	    newX = 0;
-	    while ( col )
-		newX += cellWidth( --col );   // optimize using current! ###
+	    QTableViewIndex *idx = colIndex();
+	    if ( idx && col <= nCols ) {
+		newX = idx->pos( col );
+	    } else {
+		newX = 0;
+		while ( col )
+		    newX += cellWidth( --col );	// optimize using current! ###
+	    }
 	}
     }
     if ( row >= 0 ) {
@@ -404,9 +542,14 @@ void QTableView::setTopLeftCell( int row, int col )
 	    if ( newY > maxYOffset() )
 		newY = maxYOffset();
 	} else {
-	    newY = 0;
-	    while ( row )
-		newY += cellHeight( --row );   // optimize using current! ###
+	    QTableViewIndex *idx = rowIndex();
+	    if ( idx && row <= nRows ) {
+		newY = idx->pos( row );
+	    } else {
+		newY = 0;
+		while ( row )
+		    newY += cellHeight( --row );	// optimize using current! ###
+	    }
 	}
     }
     setOffset( newX, newY );
@@ -496,9 +639,15 @@ void QTableView::setOffset( int x, int y, bool updateScrBars )
 	}
     } else {
 	int xn=0, xcd=0, col = 0;
-	while ( col < nCols && x >= xn+(xcd=cellWidth(col)) ) {
-	    xn += xcd;
-	    col++;
+	QTableViewIndex *idx = colIndex();
+	if ( idx ) {
+	    col = idx->find( x );
+	    xn = idx->pos( col );
+	} else {
+	    while ( col < nCols && x >= xn+(xcd=cellWidth(col)) ) {
+		xn += xcd;
+		col++;
+	    }
 	}
 	xCellOffs = col;
 	if ( testTableFlags(Tbl_snapToHGrid) ) {
@@ -521,9 +670,15 @@ void QTableView::setOffset( int x, int y, bool updateScrBars )
 	yCellDelta  = (short)(y % cellH);
     } else {
 	int yn=0, yrd=0, row=0;
-	while ( row < nRows && y >= yn+(yrd=cellHeight(row)) ) {
-	    yn += yrd;
-	    row++;
+	QTableViewIndex *idx = rowIndex();
+	if ( idx ) {
+	    row = idx->find( y );
+	    yn = idx->pos( row );
+	} else {
+	    while ( row < nRows && y >= yn+(yrd=cellHeight(row)) ) {
+		yn += yrd;
+		row++;
+	    }
 	}
 	yCellOffs = row;
 	if ( testTableFlags(Tbl_snapToVGrid) ) {
@@ -591,6 +746,7 @@ void QTableView::setCellWidth( int cellWidth )
     }
 #endif
     cellW = (short)cellWidth;
+    cellWidthChanged();
     if ( autoUpdate() && isVisible() )
 	repaint();
     updateScrollBars( horSteps | horRange );
@@ -643,6 +799,7 @@ void QTableView::setCellHeight( int cellHeight )
     }
 #endif
     cellH = (short)cellHeight;
+    cellHeightChanged();
     if ( autoUpdate() && isVisible() )
 	repaint();
     updateScrollBars( verSteps | verRange );
@@ -656,14 +813,18 @@ void QTableView::setCellHeight( int cellHeight )
   have variable cell widths and a non-trivial cellWidth() function, or a
   large number of columns in the table.
 
-  The default implementation may be slow for very wide tables.
+  The default implementation may be slow for very wide tables, unless
+  \link setTableFlags() Tbl_cacheCellsH\endlink is set.
 
   \sa cellWidth(), totalHeight() */
 
 int QTableView::totalWidth()
 {
+    QTableViewIndex *idx;
     if ( cellW ) {
 	return cellW*nCols;
+    } else if ( (idx = colIndex()) ) {
+	return idx->pos( nCols );
     } else {
 	int tw = 0;
 	for( int i = 0 ; i < nCols ; i++ )
@@ -679,15 +840,19 @@ int QTableView::totalWidth()
   have variable cell heights and a non-trivial cellHeight() function, or a
   large number of rows in the table.
 
-  The default implementation may be slow for very tall tables.
+  The default implementation may be slow for very tall tables, unless
+  \link setTableFlags() Tbl_cacheCellsV\endlink is set.
 
   \sa cellHeight(), totalWidth()
 */
 
 int QTableView::totalHeight()
 {
+    QTableViewIndex *idx;
     if ( cellH ) {
 	return cellH*nRows;
+    } else if ( (idx = rowIndex()) ) {
+	return idx->pos( nRows );
     } else {
 	int th = 0;
 	for( int i = 0 ; i < nRows ; i++ )
@@ -697,6 +862,108 @@ int QTableView::totalHeight()
 }
 
 
+/*!
+  Tells the table view that the width of column \e col has changed.  If
+  \e col is negative, all column widths are assumed to have changed.
+
+  This is only needed when \link setTableFlags() Tbl_cacheCellsH\endlink
+  is set and the columns have variable widths; the table view then
+  remembers the widths returned by cellWidth() and does not ask again
+  unless told to.  Columns that are added or removed at the end by
+  setNumCols() are handled automatically, but if columns are inserted
+  or removed elsewhere, call this function without arguments.
+
+  Call updateTableSize() afterwards to update the scroll bars.
+
+  \sa cellHeightChanged(), cellWidth(), updateTableSize()
+*/
+
+void QTableView::cellWidthChanged( int col )
+{
+    QTableViewSizes *s = tableSizes( this, FALSE );
+    if ( !s )
+	return;
+    QTableViewIndex *idx = &s->cols;
+    if ( col < 0 ) {
+	idx->n = 0;				// rebuild when needed
+    } else if ( col < idx->n ) {
+	int w = idx->pos( col + 1 ) - idx->pos( col );
+	idx->add( col, cellWidth( col ) - w );
+    }
+}
+
+/*!
+  Tells the table view that the height of row \e row has changed.  If
+  \e row is negative, all row heights are assumed to have changed.
+
+  This is only needed when \link setTableFlags() Tbl_cacheCellsV\endlink
+  is set and the rows have variable heights; the table view then
+  remembers the heights returned by cellHeight() and does not ask again
+  unless told to.  Rows that are added or removed at the end by
+  setNumRows() are handled automatically, but if rows are inserted or
+  removed elsewhere, call this function without arguments.
+
+  Call updateTableSize() afterwards to update the scroll bars.
+
+  \sa cellWidthChanged(), cellHeight(), updateTableSize()
+*/
+
+void QTableView::cellHeightChanged( int row )
+{
+    QTableViewSizes *s = tableSizes( this, FALSE );
+    if ( !s )
+	return;
+    QTableViewIndex *idx = &s->rows;
+    if ( row < 0 ) {
+	idx->n = 0;				// rebuild when needed
+    } else if ( row < idx->n ) {
+	int h = idx->pos( row + 1 ) - idx->pos( row );
+	idx->add( row, cellHeight( row ) - h );
+    }
+}
+
+
+/*
+  Returns the column width index, brought up to date with numCols(), or
+  0 if the columns have a fixed width or Tbl_cacheCellsH is not set.
+*/
+
+QTableViewIndex *QTableView::colIndex() const
+{
+    if ( cellW || !testTableFlags(Tbl_cacheCellsH) )
+	return 0;
+    QTableViewIndex *idx = &tableSizes( this, TRUE )->cols;
+    if ( idx->n > nCols ) {
+	idx->n = nCols;
+    } else if ( idx->n < nCols ) {
+	QTableView *tw = (QTableView *)this;
+	while ( idx->n < nCols )
+	    idx->append( tw->cellWidth( idx->n ) );
+    }
+    return idx;
+}
+
+/*
+  Returns the row height index, brought up to date with numRows(), or
+  0 if the rows have a fixed height or Tbl_cacheCellsV is not set.
+*/
+
+QTableViewIndex *QTableView::rowIndex() const
+{
+    if ( cellH || !testTableFlags(Tbl_cacheCellsV) )
+	return 0;
+    QTableViewIndex *idx = &tableSizes( this, TRUE )->rows;
+    if ( idx->n > nRows ) {
+	idx->n = nRows;
+    } else if ( idx->n < nRows ) {
+	QTableView *tw = (QTableView *)this;
+	while ( idx->n < nRows )
+	    idx->append( tw->cellHeight( idx->n ) );
+    }
+    return idx;
+}
+
+
 /*!
   \fn uint QTableView::tableFlags() const
 
@@ -762,6 +1029,13 @@ int QTableView::totalHeight()
   <dt> Tbl_snapToVGrid <dd> Except when the user is actually
   scrolling, the top row snaps to the top edge of the view.
   <dt> Tbl_snapToGrid <dd> The union of the previous two flags.
+  <dt> Tbl_cacheCellsH <dd> The table remembers variable column widths,
+  so that scrolling and finding columns take time proportional to the
+  logarithm of the number of columns. See cellWidthChanged().
+  <dt> Tbl_cacheCellsV <dd> The table remembers variable row heights,
+  so that scrolling and finding rows take time proportional to the
+  logarithm of the number of rows. See cellHeightChanged().
+  <dt> Tbl_cacheCells <dd> The union of the previous two flags.
   </dl>
 
   You can specify more than one flag at a time using bitwise OR.
@@ -886,6 +1160,12 @@ void QTableView::clearTableFlags( uint f )
     if ( f & Tbl_snapToVGrid ) {
 	updateScrollBars( verRange );
     }
+    if ( f & Tbl_cacheCellsH ) {
+	cellWidthChanged();
+    }
+    if ( f & Tbl_cacheCellsV ) {
+	cellHeightChanged();
+    }
     if ( updateOn ) {
 	setAutoUpdate( TRUE );
 	updateScrollBars();	     // returns immediately if nothing to do
@@ -1555,6 +1835,7 @@ int QTableView::findRawRow( int yPos, int *cellMaxY, int *cellMinY,
 			    bool goOutsideView ) const
 {
     int r = -1;
+    QTableViewIndex *idx;
     if ( nRows == 0 )
 	return r;
     if ( goOutsideView || yPos >= minViewY() && yPos <= maxViewY() ) {
@@ -1574,6 +1855,21 @@ int QTableView::findRawRow( int yPos, int *cellMaxY, int *cellMinY,
 	    if ( cellMinY )
 		*cellMinY = r*cellH + minViewY() - yCellDelta;
 	    r += yCellOffs;			     // absolute cell index
+	} else if ( (idx = rowIndex()) ) {	     // indexed cell height
+	    int top = idx->pos( yCellOffs ) - minViewY() + yCellDelta;
+	    r = idx->find( yPos + top );
+	    if ( r >= nRows ) {			     // below the last row
+		r = nRows;
+		if ( cellMaxY )
+		    *cellMaxY = idx->pos( nRows ) - top - 1;
+		if ( cellMinY )
+		    *cellMinY = idx->pos( nRows - 1 ) - top;
+	    } else {
+		if ( cellMaxY )
+		    *cellMaxY = idx->pos( r + 1 ) - top - 1;
+		if ( cellMinY )
+		    *cellMinY = idx->pos( r ) - top;
+	    }
 	} else {				     // variable cell height
 	    QTableView *tw = (QTableView *)this;
 	    r	     = yCellOffs;
@@ -1602,6 +1898,7 @@ int QTableView::findRawCol( int xPos, int *cellMaxX, int *cellMinX ,
 			    bool goOutsideView ) const
 {
     int c = -1;
+    QTableViewIndex *idx;
     if ( nCols == 0 )
 	return c;
     if ( goOutsideView || xPos >= minViewX() && xPos <= maxViewX() ) {
@@ -1621,6 +1918,21 @@ int QTableView::findRawCol( int xPos, int *cellMaxX, int *cellMinX ,
 	    if ( cellMinX )
 		*cellMinX = c*cellW + minViewX() - xCellDelta;
 	    c += xCellOffs;			// absolute cell index
+	} else if ( (idx = colIndex()) ) {	// indexed cell width
+	    int left = idx->pos( xCellOffs ) - minViewX() + xCellDelta;
+	    c = idx->find( xPos + left );
+	    if ( c >= nCols ) {			// right of the last column
+		c = nCols;
+		if ( cellMaxX )
+		    *cellMaxX = idx->pos( nCols ) - left - 1;
+		if ( cellMinX )
+		    *cellMinX = idx->pos( nCols - 1 ) - left;
+	    } else {
+		if ( cellMaxX )
+		    *cellMaxX = idx->pos( c + 1 ) - left - 1;
+		if ( cellMinX )
+		    *cellMinX = idx->pos( c ) - left;
+	    }
 	} else {				// variable cell width
 	    QTableView *tw = (QTableView *)this;
 	    c	     = xCellOffs;
@@ -1703,6 +2015,12 @@ bool QTableView::rowYPos( int row, int *yPos ) const
 	    if ( row > lastVisible || lastVisible == -1 )
 		return FALSE;
 	    y = (row - yCellOffs)*cellH + minViewY() - yCellDelta;
+	} else if ( row <= nRows && rowIndex() ) {
+	    QTableViewIndex *idx = rowIndex();
+	    y = idx->pos( row ) - idx->pos( yCellOffs )
+		+ minViewY() - yCellDelta;
+	    if ( y > maxViewY() )
+		return FALSE;
 	} else {
 	    //##arnt3
 	    y = minViewY() - yCellDelta;	// y of leftmost cell in view
@@ -1743,6 +2061,12 @@ bool QTableView::colXPos( int col, int *xPos ) const
 	    if ( col > lastVisible || lastVisible == -1 )
 		return FALSE;
 	    x = (col - xCellOffs)*cellW + minViewX() - xCellDelta;
+	} else if ( col <= nCols && colIndex() ) {
+	    QTableViewIndex *idx = colIndex();
+	    x = idx->pos( col ) - idx->pos( xCellOffs )
+		+ minViewX() - xCellDelta;
+	    if ( x > maxViewX() )
+		return FALSE;
 	} else {
 	    //##arnt3
 	    x = minViewX() - xCellDelta;	// x of uppermost cell in view
@@ -2251,8 +2575,11 @@ int QTableView::maxYOffset()
 int QTableView::maxColOffset()
 {
     int mx = maxXOffset();
+    QTableViewIndex *idx;
     if ( cellW )
 	return mx/cellW;
+    else if ( (idx = colIndex()) )
+	return idx->find( mx - 1 );
     else {
 	int xcd=0, col=0;
 	while ( col < nCols && mx > (xcd=cellWidth(col)) ) {
@@ -2277,8 +2604,11 @@ int QTableView::maxColOffset()
 int QTableView::maxRowOffset()
 {
     int my = maxYOffset();
+    QTableViewIndex *idx;
     if ( cellH )
 	return my/cellH;
+    else if ( (idx = rowIndex()) )
+	return idx->find( my - 1 );
     else {
 	int ycd=0, row=0;
 	while ( row < nRows && my > (ycd=cellHeight(row)) ) {
@@ -2330,6 +2660,8 @@ void QTableView::showOrHideScrollBars()
 
   Call this function when the table view's total size is changed;
   typically because the result of cellHeight() or cellWidth() have changed.
+  If \link setTableFlags() Tbl_cacheCells\endlink is set, call
+  cellHeightChanged() or cellWidthChanged() first.
 
   This function does not repaint the widget.
 */
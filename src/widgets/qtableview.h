@@ -30,6 +30,7 @@
 
 class QScrollBar;
 class CornerSquare;
+struct QTableViewIndex;
 
 
 class Q_EXPORT QTableView : public QFrame
@@ -75,6 +76,9 @@ protected:
     virtual int totalWidth();
     virtual int totalHeight();
 
+    void	cellWidthChanged( int col = -1 );
+    void	cellHeightChanged( int row = -1 );
+
     uint	tableFlags()	const;
     bool	testTableFlags( uint f ) const;
     void	setTableFlags( uint f );
@@ -145,6 +149,8 @@ private:
     int		findRawCol( int xPos, int *cellMaxX, int *cellMinX = 0,
 			    bool goOutsideView = FALSE ) const;
     int		maxColsVisible() const;
+    QTableViewIndex *colIndex() const;
+    QTableViewIndex *rowIndex() const;
 
     void	updateScrollBars( uint );
     void	updateFrameSize();
@@ -207,6 +213,10 @@ const uint Tbl_snapToHGrid	= 0x00008000;
 const uint Tbl_snapToVGrid	= 0x00010000;
 const uint Tbl_snapToGrid	= 0x00018000;
 
+const uint Tbl_cacheCellsH	= 0x00020000;
+const uint Tbl_cacheCellsV	= 0x00040000;
+const uint Tbl_cacheCells	= 0x00060000;
+
 
 inline int QTableView::numRows() const
 { return nRows; }
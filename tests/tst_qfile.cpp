@@ -0,0 +1,171 @@
+/****************************************************************************
+**
+** QFile regression tests
+**
+** This file is part of the regression tests for Qt.  It may be used,
+** distributed and modified without limitation.
+**
+*****************************************************************************/
+
+#include <qfile.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+
+static int failures = 0;
+
+static void check( bool ok, const char *what )
+{
+    if ( !ok ) {
+	fprintf( stderr, "FAIL: %s\n", what );
+	failures++;
+    }
+}
+
+static const char contents[] = "external handle contents\n";
+
+
+/*
+  IO_Mapped only applies to files opened by name.  For external handles
+  it must be ignored, and close() must leave the handle open.
+*/
+
+static void mappedExternalDescriptor( const char *name )
+{
+    int fd = open( name, O_RDONLY );
+    check( fd != -1, "open descriptor" );
+    QFile f;
+    check( f.open(IO_ReadOnly|IO_Mapped, fd), "QFile::open(int,int)" );
+    check( !f.isMapped(), "descriptor is not mapped" );
+    char buf[64];
+    int n = f.readBlock( buf, sizeof(buf) );
+    check( n == (int)strlen(contents) && memcmp(buf,contents,n) == 0,
+	   "read from descriptor" );
+    f.close();
+    check( fcntl(fd, F_GETFD) != -1, "descriptor still open after close" );
+    close( fd );
+}
+
+static void mappedExternalHandle( const char *name )
+{
+    FILE *fh = fopen( name, "r" );
+    check( fh != 0, "open handle" );
+    QFile f;
+    check( f.open(IO_ReadOnly|IO_Mapped, fh), "QFile::open(int,FILE*)" );
+    check( !f.isMapped(), "handle is not mapped" );
+    char buf[64];
+    int n = f.readBlock( buf, sizeof(buf) );
+    check( n == (int)strlen(contents) && memcmp(buf,contents,n) == 0,
+	   "read from handle" );
+    f.close();
+    check( fcntl(fileno(fh), F_GETFD) != -1, "handle still open after close" );
+    fclose( fh );
+}
+
+
+/*
+  A mapped file must read the same bytes at the same offsets as a plain
+  one.  Arrays from mappedData() become empty when the file is closed,
+  but copies keep their data.
+*/
+
+static void mappedRegularFile()
+{
+    char name[] = "/tmp/tst_qfileXXXXXX";
+    int fd = mkstemp( name );
+    check( fd != -1, "mkstemp for mapped file" );
+    QString data( 8192 );
+    int len = 0;
+    for ( int i=0; len < 5000; i++ )
+	len += sprintf( data.data()+len, "line %d\n", i );
+    write( fd, data.data(), len );
+    close( fd );
+
+    QFile f( name );
+    QFile g( name );
+    check( f.open(IO_ReadOnly|IO_Mapped), "open mapped" );
+    check( g.open(IO_ReadOnly), "open plain" );
+    check( f.isMapped(), "file is mapped" );
+    check( (int)f.size() == len, "size of mapped file" );
+    QByteArray view = f.mappedData();
+    check( (int)view.size() == len && memcmp(view.data(),data,len) == 0,
+	   "mappedData() contents" );
+
+    char a[64], b[64];
+    int n, m;
+    do {					// odd sized blocks
+	n = f.readBlock( a, 37 );
+	m = g.readBlock( b, 37 );
+	check( n == m && memcmp(a,b,QMAX(n,0)) == 0, "readBlock contents" );
+	check( f.at() == g.at(), "at() after readBlock" );
+    } while ( n > 0 && m > 0 );
+    check( f.atEnd() && (int)f.at() == len, "mapped file at end" );
+
+    check( f.at(100) && g.at(100), "seek" );
+    n = f.readLine( a, sizeof(a) );
+    m = g.readLine( b, sizeof(b) );
+    check( n == m && strcmp(a,b) == 0, "readLine after seek" );
+    check( f.at() == g.at(), "at() after readLine" );
+    check( f.getch() == g.getch() && f.at() == g.at(), "getch" );
+
+    QByteArray copy = view.copy();
+    f.close();
+    g.close();
+    check( view.isEmpty(), "mappedData() array empty after close" );
+    check( (int)copy.size() == len && memcmp(copy.data(),data,len) == 0,
+	   "copy survives close" );
+    unlink( name );
+}
+
+
+/*
+  Pipes and sockets must not be read ahead: a QSocketNotifier on the
+  descriptor would not fire again for data already in the buffer.
+*/
+
+static void sequentialDescriptor()
+{
+    int p[2];
+    check( pipe(p) == 0, "pipe" );
+    write( p[1], "one\ntwo\n", 8 );
+    QFile f;
+    check( f.open(IO_ReadOnly, p[0]), "QFile::open(int,int) on a pipe" );
+    check( f.isSequentialAccess(), "pipe is sequential" );
+    char buf[64];
+    int n = f.readLine( buf, sizeof(buf) );
+    check( n == 4 && strcmp(buf, "one\n") == 0, "readLine from pipe" );
+    n = read( p[0], buf, sizeof(buf) );
+    check( n == 4 && memcmp(buf, "two\n", 4) == 0, "pipe not read ahead" );
+    write( p[1], "x", 1 );
+    check( !f.atEnd(), "atEnd with data in pipe" );
+    check( f.getch() == 'x', "getch after atEnd" );
+    close( p[1] );
+    check( f.atEnd(), "atEnd on closed pipe" );
+    f.close();
+    close( p[0] );
+}
+
+int main()
+{
+    char name[] = "/tmp/tst_qfileXXXXXX";
+    int fd = mkstemp( name );
+    if ( fd == -1 ) {
+	perror( "tst_qfile: mkstemp" );
+	return 1;
+    }
+    write( fd, contents, strlen(contents) );
+    close( fd );
+
+    mappedExternalDescriptor( name );
+    mappedExternalHandle( name );
+    mappedRegularFile();
+    sequentialDescriptor();
+
+    unlink( name );
+    if ( failures == 0 )
+	printf( "tst_qfile: all tests passed\n" );
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,54 @@
+/****************************************************************************
+**
+** QObject regression tests
+**
+** This file is part of the regression tests for Qt.  It may be used,
+** distributed and modified without limitation.
+**
+*****************************************************************************/
+
+#include "tst_qobject.h"
+#include <stdio.h>
+
+
+static int failures = 0;
+
+static void check( bool ok, const char *what )
+{
+    if ( !ok ) {
+	fprintf( stderr, "FAIL: %s\n", what );
+	failures++;
+    }
+}
+
+
+/*
+  The base class constructor connects a signal while the object only
+  knows the base class meta object; signals declared by the subclass and
+  connected later must still be delivered.
+*/
+
+static void connectInBaseConstructor()
+{
+    Receiver r;
+    Derived d( &r );
+    d.emitBase();
+    check( r.hits == 1, "base signal connected in base constructor" );
+    QObject::connect( &d, SIGNAL(derivedSignal()), &r, SLOT(hit()) );
+    d.emitDerived();
+    check( r.hits == 2, "subclass signal connected after construction" );
+    d.emitBase();
+    check( r.hits == 3, "base signal after the signal table grew" );
+    QObject::disconnect( &d, SIGNAL(derivedSignal()), &r, SLOT(hit()) );
+    d.emitDerived();
+    check( r.hits == 3, "disconnected subclass signal" );
+}
+
+
+int main()
+{
+    connectInBaseConstructor();
+    if ( failures == 0 )
+	printf( "tst_qobject: all tests passed\n" );
+    return failures ? 1 : 0;
+}
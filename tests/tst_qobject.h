@@ -0,0 +1,50 @@
+/****************************************************************************
+**
+** Objects for the QObject regression tests
+**
+** This file is part of the regression tests for Qt.  It may be used,
+** distributed and modified without limitation.
+**
+*****************************************************************************/
+
+#ifndef TST_QOBJECT_H
+#define TST_QOBJECT_H
+
+#include <qobject.h>
+
+
+class Receiver : public QObject
+{
+    Q_OBJECT
+public:
+    Receiver() : hits(0) {}
+    int hits;
+public slots:
+    void hit() { hits++; }
+};
+
+
+class Base : public QObject
+{
+    Q_OBJECT
+public:
+    Base( Receiver *r )
+	{ connect( this, SIGNAL(baseSignal()), r, SLOT(hit()) ); }
+    void emitBase() { emit baseSignal(); }
+signals:
+    void baseSignal();
+};
+
+
+class Derived : public Base
+{
+    Q_OBJECT
+public:
+    Derived( Receiver *r ) : Base( r ) {}
+    void emitDerived() { emit derivedSignal(); }
+signals:
+    void derivedSignal();
+};
+
+
+#endif // TST_QOBJECT_H